@@ -0,0 +1,232 @@
+/** ---------------------------------------------------------------------------
+*
+* \file accuracy_ovalRasterizer.cpp
+* \description Compares the rasterizer, and the other ways of running it,
+*   against the supersampled reference on seeded random scenes.  For each
+*   engine it reports the coverage error and the run time side by side, so a
+*   faster kernel can be judged on how much error it adds.
+---------------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iso646.h>
+#include <vector>
+
+#include "ovalMaskCache.h"
+#include "ovalRasterizer.h"
+#include "ovalReference.h"
+#include "ovalScenes.h"
+
+/// An engine takes a scene and the size of the frame buffer and returns runs
+struct engineRecord
+ {
+  const char *name;
+  coverageMode coverage;
+  std::function< std::vector< pixelRun >( const std::vector< ovalRecord >&, int, int ) > raster;
+ };
+
+/** ----------------------------------------------------------------------------
+  \fn seconds_since
+---------------------------------------------------------------------------- */
+static double seconds_since( std::chrono::steady_clock::time_point start )
+{
+  std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count();
+}
+/** ----------------------------------------------------------------------------
+  \fn raster_with
+  \description An engine that calls the rasterizer with the given options
+---------------------------------------------------------------------------- */
+static engineRecord raster_with( const char *name, const rasterOptions& options )
+{
+  return engineRecord{ name, options.coverage,
+      [options]( const std::vector< ovalRecord >& ol, int width, int height )
+        {
+          return ovalListToRaster( ol, 0, 0, width, height, options );
+        } };
+}
+/** ----------------------------------------------------------------------------
+  \fn stream_raster
+  \description An engine that feeds the ovals to the stream rasterizer
+---------------------------------------------------------------------------- */
+static std::vector< pixelRun > stream_raster( const std::vector< ovalRecord >& ol, int width, int height )
+{
+  std::vector< ovalRecord > sorted( ol );
+
+  std::sort( sorted.begin(), sorted.end(), []( const ovalRecord& a, const ovalRecord& b )
+      { return ovalBounds( a ).top < ovalBounds( b ).top; } );
+
+  ovalStreamRasterizer sr( width, height );
+  std::vector< pixelRun > runs;
+
+  for( const auto& one : sorted )
+    {
+      sr.addOval( one );
+    }
+
+  sr.finish();
+  sr.takeRuns( & runs );
+
+  return runs;
+}
+
+/** ----------------------------------------------------------------------------
+  \fn mask_cache_raster
+  \description An engine that combines cached masks of the ovals.  The cache
+      is kept from one scene to the next, as it would be from frame to frame.
+---------------------------------------------------------------------------- */
+static std::vector< pixelRun > mask_cache_raster( const std::vector< ovalRecord >& ol, int width, int height )
+{
+  static ovalMaskCache cache;
+
+  return cache.rasterize( ol, 0, 0, width, height );
+}
+
+int main( int argc, char *argv[] )
+{
+  sceneOptions scene;
+  int scenes = 3;
+  int samples = 16;
+  float budget = -1.f;
+  const char *only = nullptr;
+
+  scene.count = 1000;
+  scene.width = 512.f;
+  scene.height = 512.f;
+
+  for( int ii = 1; ii < argc; ii += 1 )
+    {
+      bool has_value = ii + 1 < argc;
+
+      if( strcmp( argv[ ii ], "-n" ) == 0 and has_value )
+        scene.count = atoi( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-s" ) == 0 and has_value )
+        {
+          int width = 0;
+          int height = 0;
+
+          sscanf( argv[ ++ii ], "%dx%d", & width, & height );
+          scene.width = width;
+          scene.height = height;
+        }
+      else if( strcmp( argv[ ii ], "-S" ) == 0 and has_value )
+        scenes = std::max( 1, atoi( argv[ ++ii ] ) );
+      else if( strcmp( argv[ ii ], "-N" ) == 0 and has_value )
+        samples = atoi( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-r" ) == 0 and has_value )
+        scene.maxRadius = (float) atof( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-c" ) == 0 and has_value )
+        scene.clusters = atoi( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-b" ) == 0 and has_value )
+        budget = (float) atof( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-e" ) == 0 and has_value )
+        only = argv[ ++ii ];
+      else
+        {
+          fprintf( stderr, "usage: %s [-n OVALS] [-s WxH] [-S SCENES] [-N SAMPLES] [-r MAXRADIUS] [-c CLUSTERS]"
+                           " [-e ENGINE] [-b MEANBUDGET]\n", argv[ 0 ] );
+          return 2;
+        }
+    }
+
+  int width = (int) scene.width;
+  int height = (int) scene.height;
+
+  rasterOptions sum;
+  sum.coverage = coverageMode::accumulate;
+
+  rasterOptions binary;
+  binary.antialias = false;
+
+  rasterOptions splat;
+  splat.splatRadius = 1.f;
+
+  rasterOptions needle;
+  needle.needleRadius = 0.5f;
+
+  std::vector< engineRecord > engines = {
+      raster_with( "sweep", rasterOptions() ),
+      raster_with( "accumulate", sum ),
+      raster_with( "binary", binary ),
+      raster_with( "splat<1", splat ),
+      raster_with( "needle<.5", needle ),
+      engineRecord{ "stream", coverageMode::unite, stream_raster },
+      engineRecord{ "maskCache", coverageMode::unite, mask_cache_raster },
+    };
+
+  if( only )
+    {
+      engines.erase( std::remove_if( engines.begin(), engines.end(),
+                                     [only]( const engineRecord& one ) { return strcmp( one.name, only ) != 0; } ),
+                     engines.end() );
+
+      if( engines.empty() )
+        {
+          fprintf( stderr, "no engine named %s\n", only );
+          return 2;
+        }
+    }
+
+  printf( "%d scenes of %d ovals, %dx%d, %dx%d samples per pixel\n",
+          scenes, scene.count, width, height, samples, samples );
+  printf( "%-12s %10s %10s %10s %10s %10s\n", "engine", "max", "mean", "mass", "bad px", "ms" );
+
+  // With a budget, the exit status is 1 when the mean error of any engine
+  // is over it, so the harness can gate a change in a script
+
+  // The references take much longer than the engines, so each one is made
+  // once per scene and shared by the engines that use the same mode
+
+  std::vector< coverageError > worst( engines.size() );
+  std::vector< double > mean( engines.size(), 0. );
+  std::vector< double > seconds( engines.size(), 0. );
+
+  for( int ss = 0; ss < scenes; ss += 1 )
+    {
+      scene.seed = ss + 1;
+
+      auto ol = randomOvalScene( scene );
+      auto unite = referenceCoverage( ol, width, height, samples, coverageMode::unite );
+      auto accumulate = referenceCoverage( ol, width, height, samples, coverageMode::accumulate );
+
+      for( size_t ee = 0; ee < engines.size(); ee += 1 )
+        {
+          auto start = std::chrono::steady_clock::now();
+          auto runs = engines[ ee ].raster( ol, width, height );
+          seconds[ ee ] += seconds_since( start );
+
+          auto err = compareCoverage( runsToCoverage( runs, width, height ),
+                                      engines[ ee ].coverage == coverageMode::unite ? unite : accumulate );
+
+          worst[ ee ].maxError = std::max( worst[ ee ].maxError, err.maxError );
+          worst[ ee ].badPixelCount += err.badPixelCount;
+          worst[ ee ].pixelCount += err.pixelCount;
+          mean[ ee ] += err.meanError * err.pixelCount;
+
+          if( std::fabs( worst[ ee ].massError ) < std::fabs( err.massError ) )
+            worst[ ee ].massError = err.massError;
+        }
+    }
+
+  int failed = 0;
+
+  for( size_t ee = 0; ee < engines.size(); ee += 1 )
+    {
+      if( 0 < worst[ ee ].pixelCount )
+        mean[ ee ] /= worst[ ee ].pixelCount;
+
+      printf( "%-12s %10.5f %10.6f %+10.6f %10zu %10.3f\n", engines[ ee ].name, worst[ ee ].maxError, mean[ ee ],
+              worst[ ee ].massError, worst[ ee ].badPixelCount, 1e3 * seconds[ ee ] / scenes );
+
+      if( 0.f <= budget and budget < mean[ ee ] )
+        failed += 1;
+    }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,625 @@
+/** ---------------------------------------------------------------------------
+*
+* \file benchmark_ovalRasterizer.cpp
+* \description Measures how fast a random scene is rasterized and how fast
+*   the runs are composited into each of the pixel formats.
+---------------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iso646.h>
+#include <vector>
+
+#include "ovalArena.h"
+#include "ovalHitIndex.h"
+#include "ovalKernels.h"
+#include "ovalMaskCache.h"
+#include "ovalPipeline.h"
+#include "ovalRasterizer.h"
+#include "ovalScenes.h"
+#include "ovalStamp.h"
+#include "runCompositor.h"
+
+/** ----------------------------------------------------------------------------
+  \fn seconds_since
+---------------------------------------------------------------------------- */
+static double seconds_since( std::chrono::steady_clock::time_point start )
+{
+  std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count();
+}
+
+/** ----------------------------------------------------------------------------
+  \fn benchmark_kernels
+  \description Time the batched bounds and roots against calling the scalar
+      forms one oval at a time.  The roots are found for every oval on
+      every tenth scanline, which is more than the sweep would ask for but
+      keeps the batches the same size.
+---------------------------------------------------------------------------- */
+static void benchmark_kernels( const std::vector< ovalRecord >& ol, int height, int repeat )
+{
+  std::vector< floatBounds > bounds( ol.size() );
+  double scalar = 0.;
+  double batch = 0.;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      for( size_t ii = 0; ii < ol.size(); ii += 1 )
+        {
+          bounds[ ii ] = ovalBounds( ol[ ii ] );
+        }
+
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+      batchBounds( ol.data(), ol.size(), bounds.data() );
+      double two = seconds_since( start );
+
+      if( rr == 0 or one < scalar )
+        scalar = one;
+
+      if( rr == 0 or two < batch )
+        batch = two;
+    }
+
+  printf( "bounds:    %d wide, scalar %.3f ovals/ns, batch %.3f ovals/ns\n",
+          kernelWidth(), 1e-9 * ol.size() / scalar, 1e-9 * ol.size() / batch );
+
+  ovalArrays oa;
+  oa.assign( ol.data(), ol.size() );
+
+  std::vector< int > index( ol.size() );
+  std::vector< float > left( ol.size() );
+  std::vector< float > right( ol.size() );
+  std::vector< int > roots( ol.size() );
+  size_t solved = 0;
+
+  for( size_t ii = 0; ii < ol.size(); ii += 1 )
+    {
+      index[ ii ] = (int) ii;
+    }
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      solved = 0;
+
+      for( int yy = 0; yy < height; yy += 10 )
+        {
+          for( size_t ii = 0; ii < ol.size(); ii += 1 )
+            {
+              float xx[ 2 ];
+              roots[ ii ] = ovalRoots( xx, (float) yy, ol[ ii ] );
+            }
+
+          solved += ol.size();
+        }
+
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+
+      for( int yy = 0; yy < height; yy += 10 )
+        {
+          batchRoots( oa, index.data(), index.size(), (float) yy, left.data(), right.data(), roots.data() );
+        }
+
+      double two = seconds_since( start );
+
+      if( rr == 0 or one < scalar )
+        scalar = one;
+
+      if( rr == 0 or two < batch )
+        batch = two;
+    }
+
+  printf( "roots:     %d wide, scalar %.3f ovals/ns, batch %.3f ovals/ns\n",
+          kernelWidth(), 1e-9 * solved / scalar, 1e-9 * solved / batch );
+}
+
+/** ----------------------------------------------------------------------------
+  \fn benchmark_frames
+  \description Animate the scene for a number of frames and composite each
+      one, first one stage after the other and then through a pipeline.
+---------------------------------------------------------------------------- */
+static void benchmark_frames( const sceneOptions& scene, int frames )
+{
+  int width = (int) scene.width;
+  int height = (int) scene.height;
+
+  std::vector< uint8_t > buffer( (size_t) width * height * 4, 0 );
+  runCompositor comp( buffer.data(), width, height, (ptrdiff_t) width * 4, pixelFormat::argb32 );
+  comp.setColor( 0x20, 0x60, 0xFF, 0xFF );
+
+  auto ol = randomOvalScene( scene );
+  sceneAnimator serial_anim( ol, scene );
+
+  auto start = std::chrono::steady_clock::now();
+
+  for( int ff = 0; ff < frames; ff += 1 )
+    {
+      serial_anim.step( 1.f / 60.f );
+
+      auto runs = ovalListToRaster( serial_anim.ovals(), width, height );
+
+      std::fill( buffer.begin(), buffer.end(), 0 );
+      comp.apply( runs );
+    }
+
+  double serial = seconds_since( start );
+
+  sceneAnimator pipe_anim( ol, scene );
+  ovalPipeline pipe( 0, 0, width, height );
+
+  start = std::chrono::steady_clock::now();
+
+  pipe.run( [&]( size_t frame, std::vector< ovalRecord > *ovals )
+    {
+      if( (size_t) frames <= frame )
+        return false;
+
+      pipe_anim.step( 1.f / 60.f );
+      *ovals = pipe_anim.ovals();
+      return true;
+    },
+    [&]( size_t, std::vector< pixelRun >& runs, const rasterStats& )
+    {
+      std::fill( buffer.begin(), buffer.end(), 0 );
+      comp.apply( runs );
+    } );
+
+  double pipelined = seconds_since( start );
+
+  printf( "frames:    %d frames, serial %.2f frames/s, pipelined %.2f frames/s\n",
+          frames, frames / serial, frames / pipelined );
+}
+
+/** ----------------------------------------------------------------------------
+  \fn benchmark_masks
+  \description Move the ovals of the scene by whole pixels from frame to
+      frame, which is the best case of the mask cache, and rasterize each
+      frame directly and with the cache.
+---------------------------------------------------------------------------- */
+static void benchmark_masks( const std::vector< ovalRecord >& ol, int width, int height, int frames )
+{
+  std::vector< std::vector< ovalRecord > > moved( frames, ol );
+
+  for( int ff = 0; ff < frames; ff += 1 )
+    {
+      for( size_t ii = 0; ii < ol.size(); ii += 1 )
+        {
+          moved[ ff ][ ii ].centerx += (float)( ( ii + ff ) % 7 ) - 3.f;
+          moved[ ff ][ ii ].centery += (float)( ( ii * 3 + ff ) % 5 ) - 2.f;
+        }
+    }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for( const auto& one : moved )
+    {
+      ovalListToRaster( one, width, height );
+    }
+
+  double direct = seconds_since( start );
+
+  ovalMaskCache cache;
+
+  start = std::chrono::steady_clock::now();
+
+  for( const auto& one : moved )
+    {
+      cache.rasterize( one, 0, 0, width, height );
+    }
+
+  double cached = seconds_since( start );
+
+  printf( "masks:     %d frames, direct %.2f frames/s, cached %.2f frames/s, hit rate %.3f, speedup %.2fx\n",
+          frames, frames / direct, frames / cached, cache.stats().hitRate(), cache.stats().speedup() );
+}
+
+/** ----------------------------------------------------------------------------
+  \fn benchmark_stamps
+  \description Rasterize the same small oval at every center of the scene,
+      as separate ovals and as stamped copies of one shape.
+---------------------------------------------------------------------------- */
+static void benchmark_stamps( const std::vector< ovalRecord >& ol, int width, int height, int repeat )
+{
+  ovalRecord shape = { 0.f, 0.f, 3.f, 2.f, 0.5f };
+
+  std::vector< ovalRecord > markers;
+  std::vector< stampCenter > centers;
+
+  for( const auto& one : ol )
+    {
+      markers.push_back( { one.centerx, one.centery, shape.radiusx, shape.radiusy, shape.angle } );
+      centers.push_back( { one.centerx, one.centery } );
+    }
+
+  double separate = 0.;
+  double stamped = 0.;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+      ovalListToRaster( markers, width, height );
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+      ovalStampToRaster( shape, centers, 0, 0, width, height );
+      double two = seconds_since( start );
+
+      if( rr == 0 or one < separate )
+        separate = one;
+
+      if( rr == 0 or two < stamped )
+        stamped = two;
+    }
+
+  printf( "stamps:    %zu copies, separate %.3f ms, stamped %.3f ms, %.1f copies/us\n",
+          centers.size(), 1e3 * separate, 1e3 * stamped, 1e-6 * centers.size() / stamped );
+}
+
+/** ----------------------------------------------------------------------------
+  \fn benchmark_nested
+  \description Put a smaller oval inside each oval of the scene, like
+      detections inside of detections, and rasterize the scene as it is and
+      after removing the ovals that are contained in others.
+---------------------------------------------------------------------------- */
+static void benchmark_nested( const std::vector< ovalRecord >& ol, int width, int height, int repeat )
+{
+  std::vector< ovalRecord > nested( ol );
+
+  for( const auto& one : ol )
+    {
+      nested.push_back( { one.centerx, one.centery, 0.5f * one.radiusx, 0.4f * one.radiusy, one.angle + 0.3f } );
+    }
+
+  double plain = 0.;
+  double culled = 0.;
+  int removed = 0;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+      ovalListToRaster( nested, width, height );
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+      std::vector< ovalRecord > kept( nested );
+      removed = removeContainedOvals( kept );
+      ovalListToRaster( kept, width, height );
+      double two = seconds_since( start );
+
+      if( rr == 0 or one < plain )
+        plain = one;
+
+      if( rr == 0 or two < culled )
+        culled = two;
+    }
+
+  printf( "nested:    %zu ovals, %d contained, plain %.3f ms, culled %.3f ms\n",
+          nested.size(), removed, 1e3 * plain, 1e3 * culled );
+}
+/** ----------------------------------------------------------------------------
+  \fn benchmark_rects
+  \description Merge the runs that repeat on consecutive lines into
+      rectangles, and composite the runs and the rectangles.
+---------------------------------------------------------------------------- */
+static void benchmark_rects( const std::vector< pixelRun >& runs, int width, int height, int repeat )
+{
+  std::vector< uint8_t > buffer( (size_t) width * height * 4, 0 );
+  std::vector< pixelRect > rects;
+
+  double merge = 0.;
+  double byRuns = 0.;
+  double byRects = 0.;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      runCompositor comp( buffer.data(), width, height, (ptrdiff_t) width * 4, pixelFormat::argb32Premultiplied );
+
+      comp.setColor( 0x20, 0x60, 0xFF, 0xC0 );
+      comp.setBlendMode( blendMode::srcOver );
+
+      auto start = std::chrono::steady_clock::now();
+      rects = runsToRects( runs );
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+      comp.apply( runs );
+      double two = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+      comp.apply( rects );
+      double three = seconds_since( start );
+
+      if( rr == 0 or one < merge )
+        merge = one;
+
+      if( rr == 0 or two < byRuns )
+        byRuns = two;
+
+      if( rr == 0 or three < byRects )
+        byRects = three;
+    }
+
+  printf( "rects:     %zu runs into %zu rects in %.3f ms, composite runs %.3f ms, rects %.3f ms\n",
+          runs.size(), rects.size(), 1e3 * merge, 1e3 * byRuns, 1e3 * byRects );
+}
+/** ----------------------------------------------------------------------------
+  \fn benchmark_arena
+  \description Rasterize the scene with the heap, and with every allocation
+      taken from an arena that is reset after each frame.
+---------------------------------------------------------------------------- */
+static void benchmark_arena( const std::vector< ovalRecord >& ol, int width, int height, int repeat )
+{
+  rasterArena arena( 64 << 20 );
+  rasterOptions options;
+  options.memory = & arena;
+
+  double heap = 0.;
+  double pooled = 0.;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+      ovalListToRaster( ol, width, height );
+      double one = seconds_since( start );
+
+      start = std::chrono::steady_clock::now();
+
+      {
+        std::pmr::vector< pixelRun > runs( & arena );
+        ovalListToRaster( ol.data(), ol.size(), 0, 0, width, height, options, runs );
+      }
+
+      arena.reset();
+      double two = seconds_since( start );
+
+      if( rr == 0 or one < heap )
+        heap = one;
+
+      if( rr == 0 or two < pooled )
+        pooled = two;
+    }
+
+  printf( "arena:     heap %.3f ms, arena %.3f ms, %.1f KB used, %zu allocations past the end\n",
+          1e3 * heap, 1e3 * pooled, arena.highWater() / 1024., arena.overflowCount() );
+}
+/** ----------------------------------------------------------------------------
+  \fn benchmark_exact
+  \description Report how many of the ovals of the benchmark scene, and of
+      scenes of larger and thinner ovals, have their roots found in double
+      precision, and how long they take.
+---------------------------------------------------------------------------- */
+static void benchmark_exact( const sceneOptions& base, int repeat )
+{
+  struct exactCase { const char *name; float maxRadius; float eccentricity; int count; };
+
+  const exactCase cases[] = {
+      { "scene", base.maxRadius, base.eccentricity, base.count },
+      { "large", 400.f, base.eccentricity, 200 },
+      { "needles", 400.f, .98f, 200 },
+      { "huge", 4000.f, .9f, 50 },
+    };
+
+  for( const auto& one : cases )
+    {
+      sceneOptions scene = base;
+      scene.maxRadius = one.maxRadius;
+      scene.eccentricity = one.eccentricity;
+      scene.count = one.count;
+
+      auto ol = randomOvalScene( scene );
+
+      rasterStats stats;
+      rasterOptions options;
+      options.stats = & stats;
+
+      double best = 0.;
+
+      for( int rr = 0; rr < repeat; rr += 1 )
+        {
+          ovalListToRaster( ol, 0, 0, (int) scene.width, (int) scene.height, options );
+
+          if( rr == 0 or stats.sweepSeconds < best )
+            best = stats.sweepSeconds;
+        }
+
+      printf( "exact:     %-8s %zu of %zu ovals in double precision (%.1f%%), sweep %.3f ms\n", one.name,
+              stats.exactOvalCount, stats.ovalCount, 100. * stats.exactOvalCount / std::max( (size_t) 1, stats.ovalCount ),
+              1e3 * best );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn benchmark_needles
+  \description Thin the ovals of the scene into strokes that are less than a
+      pixel wide, and compare the sweep with drawing them as lines.
+---------------------------------------------------------------------------- */
+static void benchmark_needles( std::vector< ovalRecord > ol, int width, int height, int repeat )
+{
+  for( auto& one : ol )
+    {
+      one.radiusy = std::min( 0.45f, 0.05f + 0.01f * one.radiusx );
+    }
+
+  for( float needleRadius : { 0.f, 0.5f } )
+    {
+      rasterStats stats;
+      rasterOptions options;
+      options.needleRadius = needleRadius;
+      options.stats = & stats;
+
+      double best = 0.;
+
+      for( int rr = 0; rr < repeat; rr += 1 )
+        {
+          ovalListToRaster( ol, 0, 0, width, height, options );
+
+          if( rr == 0 or stats.totalSeconds < best )
+            best = stats.totalSeconds;
+        }
+
+      printf( "needles:   %-8s %8.3f ms, %zu pixels from distances, %zu ovals as lines\n",
+              needleRadius == 0.f ? "sweep" : "lines", 1e3 * best, stats.aaPixelCount, stats.needleCount );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn benchmark_composite
+  \description Time drawing the runs into each format with each blend mode,
+      and print the share of the pixels that are in runs of 3 or fewer.
+---------------------------------------------------------------------------- */
+static void benchmark_composite( const char *label, const std::vector< pixelRun >& runs, int width, int height, int repeat )
+{
+  uint64_t total = 0;
+  uint64_t short_runs = 0;
+
+  for( const auto& pr : runs )
+    {
+      total += pr.endX - pr.startX;
+
+      if( pr.endX - pr.startX <= 3 )
+        short_runs += pr.endX - pr.startX;
+    }
+
+  printf( "%s: %zu runs, %.0f%% of the pixels in runs of 3 or fewer\n", label, runs.size(),
+          100. * short_runs / std::max< uint64_t >( 1, total ) );
+
+  struct formatCase { pixelFormat format; const char *name; int bpp; };
+
+  const formatCase formats[] = {
+      { pixelFormat::argb32, "argb32", 4 },
+      { pixelFormat::argb32Premultiplied, "argb32p", 4 },
+      { pixelFormat::rgba8, "rgba8", 4 },
+      { pixelFormat::a8, "a8", 1 },
+      { pixelFormat::float32, "float32", 4 },
+    };
+
+  struct modeCase { blendMode mode; const char *name; };
+
+  const modeCase modes[] = {
+      { blendMode::replace, "replace" },
+      { blendMode::srcOver, "srcOver" },
+      { blendMode::max, "max" },
+    };
+
+  for( const auto& fc : formats )
+    {
+      std::vector< uint8_t > buffer( (size_t) width * height * fc.bpp, 0 );
+
+      for( const auto& mc : modes )
+        {
+          uint64_t pixels = 0;
+          double best = 0.;
+
+          for( int rr = 0; rr < repeat; rr += 1 )
+            {
+              runCompositor comp( buffer.data(), width, height, (ptrdiff_t) width * fc.bpp, fc.format );
+
+              comp.setColor( 0x20, 0x60, 0xFF, 0xC0 );
+              comp.setBlendMode( mc.mode );
+
+              auto start = std::chrono::steady_clock::now();
+
+              comp.apply( runs );
+
+              double elapsed = seconds_since( start );
+
+              if( rr == 0 or elapsed < best )
+                best = elapsed;
+
+              pixels = comp.pixelCount();
+            }
+
+          printf( "%s %-8s %-8s %.3f ms, %.1f Mpixel/s\n", label, fc.name, mc.name, 1e3 * best, 1e-6 * pixels / best );
+        }
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+  int count = 5000;
+  int width = 1024;
+  int height = 1024;
+  int repeat = 5;
+  int frames = 30;
+
+  for( int ii = 1; ii < argc; ii += 1 )
+    {
+      bool has_value = ii + 1 < argc;
+
+      if( strcmp( argv[ ii ], "-n" ) == 0 and has_value )
+        count = atoi( argv[ ++ii ] );
+      else if( strcmp( argv[ ii ], "-s" ) == 0 and has_value )
+        sscanf( argv[ ++ii ], "%dx%d", & width, & height );
+      else if( strcmp( argv[ ii ], "-r" ) == 0 and has_value )
+        repeat = std::max( 1, atoi( argv[ ++ii ] ) );
+      else if( strcmp( argv[ ii ], "-f" ) == 0 and has_value )
+        frames = std::max( 0, atoi( argv[ ++ii ] ) );
+      else
+        {
+          fprintf( stderr, "usage: %s [-n OVALS] [-s WxH] [-r REPEAT] [-f FRAMES]\n", argv[ 0 ] );
+          return 2;
+        }
+    }
+
+  sceneOptions scene;
+  scene.count = count;
+  scene.width = width;
+  scene.height = height;
+
+  auto ol = randomOvalScene( scene );
+
+  std::vector< pixelRun > runs;
+  double best = 0.;
+
+  for( int rr = 0; rr < repeat; rr += 1 )
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      runs = ovalListToRaster( ol, width, height );
+
+      double elapsed = seconds_since( start );
+
+      if( rr == 0 or elapsed < best )
+        best = elapsed;
+    }
+
+  printf( "rasterize: %d ovals, %zu runs, %dx%d, %.3f ms\n", count, runs.size(), width, height, 1e3 * best );
+
+  benchmark_kernels( ol, height, repeat );
+  benchmark_stamps( ol, width, height, repeat );
+  benchmark_nested( ol, width, height, repeat );
+  benchmark_arena( ol, width, height, repeat );
+  benchmark_exact( scene, repeat );
+  benchmark_needles( ol, width, height, repeat );
+
+  if( 0 < frames )
+    {
+      benchmark_frames( scene, frames );
+      benchmark_masks( ol, width, height, frames );
+    }
+
+  benchmark_composite( "composite", runs, width, height, repeat );
+
+  // Small ovals, whose runs are nearly all anti-aliased edges a few pixels
+  // long, which the compositor blends one pixel at a time
+
+  sceneOptions small = scene;
+  small.count = 8 * count;
+  small.minRadius = 0.75f;
+  small.maxRadius = 2.5f;
+
+  benchmark_composite( "composite aa", ovalListToRaster( randomOvalScene( small ), width, height ), width, height, repeat );
+
+  benchmark_rects( runs, width, height, repeat );
+
+  return 0;
+}
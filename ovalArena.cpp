@@ -0,0 +1,135 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalArena.cpp
+* \description This file contains a fixed-size arena that the rasterizer
+*   can take its memory from, so that a frame is rasterized without
+*   allocating from the heap
+---------------------------------------------------------------------------- */
+
+#include "ovalArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <iso646.h>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include <vector>
+#endif
+
+/** ----------------------------------------------------------------------------
+  \fn rasterArena::rasterArena
+---------------------------------------------------------------------------- */
+rasterArena::rasterArena( size_t bytes, bool strict ) :
+buffer_( new std::byte[ std::max( bytes, (size_t) 1 ) ] ), bytes_( bytes ), strict_( strict ),
+used_( 0 ), highWater_( 0 ), overflowCount_( 0 )
+{
+}
+/** ----------------------------------------------------------------------------
+  \fn rasterArena::do_allocate
+  \description Round the front up to the alignment and move it past the
+      allocation, or go to the heap when there is no room.
+---------------------------------------------------------------------------- */
+void *rasterArena::do_allocate( size_t bytes, size_t alignment )
+{
+  uintptr_t base = (uintptr_t) buffer_.get();
+  uintptr_t start = ( base + used_ + alignment - 1 ) & ~(uintptr_t)( alignment - 1 );
+
+  if( start - base <= bytes_ and bytes <= bytes_ - ( start - base ) )
+    {
+      used_ = start - base + bytes;
+      highWater_ = std::max( highWater_, used_ );
+
+      return (void *) start;
+    }
+
+  if( strict_ )
+    {
+      throw arenaExhausted();
+    }
+
+  overflowCount_ += 1;
+
+  return std::pmr::new_delete_resource()->allocate( bytes, alignment );
+}
+/** ----------------------------------------------------------------------------
+  \fn rasterArena::do_deallocate
+---------------------------------------------------------------------------- */
+void rasterArena::do_deallocate( void *pp, size_t bytes, size_t alignment )
+{
+  std::byte *one = (std::byte *) pp;
+
+  if( one < buffer_.get() or buffer_.get() + bytes_ < one + bytes )
+    {
+      std::pmr::new_delete_resource()->deallocate( pp, bytes, alignment );
+    }
+  else if( one + bytes == buffer_.get() + used_ )   // the last allocation
+    {
+      used_ = one - buffer_.get();
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn rasterArena::do_is_equal
+---------------------------------------------------------------------------- */
+bool rasterArena::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+  return this == & other;
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalArena_UnitTests");
+TEST_CASE( "Arena Allocations" )
+{
+  rasterArena arena( 4096 );
+
+  void *one = arena.allocate( 3, 1 );
+  void *two = arena.allocate( 8, 8 );
+
+  CHECK( (uintptr_t) two % 8 == 0 );
+  CHECK( (char *) one + 3 <= (char *) two );
+  CHECK( arena.used() == (size_t)( (char *) two - (char *) one ) + 8 );
+
+  // Freeing the last allocation takes it back, anything else waits for reset
+
+  arena.deallocate( one, 3, 1 );
+  size_t used = arena.used();
+  arena.deallocate( two, 8, 8 );
+
+  CHECK( arena.used() < used );
+
+  // A growing vector stays in the arena
+
+  {
+    std::pmr::vector< int > list( & arena );
+
+    for( int ii = 0; ii < 200; ii += 1 )
+      {
+        list.push_back( ii );
+      }
+
+    CHECK( arena.overflowCount() == 0 );
+    CHECK( 200 * sizeof( int ) <= arena.highWater() );
+  }
+
+  arena.reset();
+
+  CHECK( arena.used() == 0 );
+
+  // Past the end the allocations go to the heap, or throw when strict
+
+  void *big = arena.allocate( 8192, 16 );
+
+  CHECK( arena.overflowCount() == 1 );
+  CHECK( arena.used() == 0 );
+
+  arena.deallocate( big, 8192, 16 );
+
+  rasterArena strict( 64, true );
+
+  CHECK( strict.allocate( 48, 16 ) != nullptr );
+  CHECK_THROWS( strict.allocate( 32, 16 ) );
+  CHECK( strict.overflowCount() == 0 );
+}
+TEST_SUITE_END();
+#endif
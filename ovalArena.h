@@ -0,0 +1,83 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalArena.h
+ * \description This file contains a fixed-size arena that the rasterizer
+ *   can take its memory from, so that a frame is rasterized without
+ *   allocating from the heap
+---------------------------------------------------------------------------- */
+
+#ifndef OVALARENA_H
+#define OVALARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+/// Thrown by a strict arena that has no room left for an allocation
+class arenaExhausted : public std::bad_alloc
+  {
+    public:
+      const char *what() const noexcept override { return "raster arena exhausted"; }
+  };
+
+/** ----------------------------------------------------------------------------
+  \class rasterArena
+  \description A memory resource that hands out the space of one buffer, which
+      is allocated when the arena is made, from the front to the back.  Memory
+      that is freed is only taken back when it was the last allocation, which
+      is what a growing vector does, and everything is taken back by `reset`,
+      once per frame.
+
+      When the buffer is full, a strict arena throws `arenaExhausted`, and
+      otherwise the allocation is passed on to the heap and counted in
+      `overflowCount`, so that the arena can be made larger.  `highWater`
+      is the most of the buffer that was in use since the arena was made.
+
+      Pass the arena as `rasterOptions::memory`, and give it to the vector of
+      runs as well:
+
+          rasterArena arena( 16 << 20, true );
+          rasterOptions options;
+          options.memory = & arena;
+
+          for( each frame )
+            {
+              std::pmr::vector< pixelRun > runs( & arena );
+              ovalListToRaster( ol, count, x0, y0, x1, y1, options, runs );
+              ... use the runs ...
+              runs = std::pmr::vector< pixelRun >( & arena );   // or let it go out of scope
+              arena.reset();
+            }
+---------------------------------------------------------------------------- */
+class rasterArena : public std::pmr::memory_resource
+  {
+    public:
+      explicit rasterArena( size_t bytes, bool strict = false );
+
+      /// Take back all of the buffer.  Nothing that was allocated from the
+      /// arena can be used after this.
+      void reset() { used_ = 0; }
+
+      bool strict() const { return strict_; }
+      size_t capacity() const { return bytes_; }
+      size_t used() const { return used_; }
+      size_t highWater() const { return highWater_; }
+      size_t overflowCount() const { return overflowCount_; }
+
+    protected:
+      void *do_allocate( size_t bytes, size_t alignment ) override;
+      void do_deallocate( void *pp, size_t bytes, size_t alignment ) override;
+      bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override;
+
+    private:
+      std::unique_ptr< std::byte[] > buffer_;
+      size_t bytes_;
+      bool strict_;
+
+      size_t used_;
+      size_t highWater_;
+      size_t overflowCount_;
+  };
+
+#endif //OVALARENA_H
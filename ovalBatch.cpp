@@ -0,0 +1,411 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalBatch.cpp
+* \description A command line tool that rasterizes binary oval files without
+*   needing Qt.  Each input file is one frame; the runs can be written to a
+*   run file or to a PGM image, and the throughput is printed for each frame.
+*   With -p the frames go through an ovalPipeline, so that reading, rasterizing
+*   and writing overlap.
+---------------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iso646.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ovalFile.h"
+#include "ovalHitIndex.h"
+#include "ovalPipeline.h"
+#include "ovalRasterizer.h"
+#include "ovalTrace.h"
+
+enum class outputFormat { none, runs, pgm };
+
+/** ----------------------------------------------------------------------------
+  \fn usage
+---------------------------------------------------------------------------- */
+static void usage( const char *name )
+{
+  fprintf( stderr,
+    "usage: %s [options] file.oval ...\n"
+    "  -s WxH      size of the frame buffer (default: taken from the file)\n"
+    "  -f FORMAT   output format: runs, pgm or none (default: none)\n"
+    "  -o DIR      directory for the output files (default: next to the input)\n"
+    "  -r COUNT    rasterize each frame COUNT times and report the fastest\n"
+    "  -l RADIUS   splat the ovals whose radii are smaller than RADIUS\n"
+    "  -a          add up the coverage of overlapping ovals instead of uniting it\n"
+    "  -c          drop the ovals that are inside of another oval first, which\n"
+    "              doesn't change the output (ignored with -a)\n"
+    "  -p THREADS  read, rasterize and write the frames at the same time, with\n"
+    "              THREADS rasterizing (0 for the number of cores less two).\n"
+    "              All frames use the same size and the first error stops the run\n"
+    "  -t FILE     write a Chrome trace of the stages of the rasterizer to FILE,\n"
+    "              which needs a build with OVAL_TRACE\n",
+    name );
+}
+/** ----------------------------------------------------------------------------
+  \class traceFile
+  \description Records a trace from when it is made until it goes away at
+      the end of main, and then writes it to the file.
+---------------------------------------------------------------------------- */
+struct traceFile
+ {
+  const char *path;
+
+  explicit traceFile( const char *pp ) : path( pp )
+  {
+    if( path )
+      traceStart();
+  }
+
+  ~traceFile()
+  {
+    if( path )
+      {
+        traceStop();
+
+        try
+          {
+            writeTrace( path );
+            printf( "trace: %zu spans written to %s\n", traceEventCount(), path );
+          }
+        catch( const std::exception& ex )
+          {
+            fprintf( stderr, "%s\n", ex.what() );
+          }
+      }
+  }
+ };
+/** ----------------------------------------------------------------------------
+  \fn output_path
+  \description Build the name of the output file from the name of the input
+      file by replacing the extension and, if given, the directory.
+---------------------------------------------------------------------------- */
+static std::string output_path( const std::string& input, const std::string& dir, const char *ext )
+{
+  std::string name = input;
+
+  size_t slash = name.find_last_of( '/' );
+
+  if( not dir.empty() )
+    {
+      name = dir + "/" + ( slash == std::string::npos ? name : name.substr( slash + 1 ) );
+      slash = dir.size();
+    }
+
+  size_t dot = name.find_last_of( '.' );
+
+  if( dot != std::string::npos and ( slash == std::string::npos or slash < dot ) )
+    {
+      name.resize( dot );
+    }
+
+  return name + ext;
+}
+/** ----------------------------------------------------------------------------
+  \fn write_pgm
+  \description Write the runs as an 8-bit grayscale image, where a coverage
+      of 1 is white.  Larger values, from accumulating, are also white.
+---------------------------------------------------------------------------- */
+static void write_pgm( const char *path, const std::vector< pixelRun >& runs, int width, int height )
+{
+  std::vector< unsigned char > img( (size_t) width * height, 0 );
+
+  for( const auto& one : runs )
+    {
+      unsigned char *scan = img.data() + (size_t) one.lineY * width;
+      unsigned char pp = (unsigned char)( 255.f * std::min( 1.f, one.value ) + 0.5f );
+
+      memset( scan + one.startX, pp, one.endX - one.startX );
+    }
+
+  FILE *fp = fopen( path, "wb" );
+
+  if( not fp )
+    {
+      throw std::runtime_error( std::string( "unable to create file: " ) + path );
+    }
+
+  fprintf( fp, "P5\n%d %d\n255\n", width, height );
+  bool ok = fwrite( img.data(), 1, img.size(), fp ) == img.size();
+
+  if( fclose( fp ) != 0 or not ok )
+    {
+      throw std::runtime_error( std::string( "unable to write file: " ) + path );
+    }
+}
+
+/** ----------------------------------------------------------------------------
+  \fn write_output
+---------------------------------------------------------------------------- */
+static void write_output( outputFormat format, const std::string& input, const std::string& outdir,
+                          const std::vector< pixelRun >& runs, int width, int height )
+{
+  if( format == outputFormat::runs )
+    {
+      writeRunFile( output_path( input, outdir, ".runs" ).c_str(), runs, width, height );
+    }
+  else if( format == outputFormat::pgm )
+    {
+      write_pgm( output_path( input, outdir, ".pgm" ).c_str(), runs, width, height );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn run_pipelined
+  \description Read the next file, rasterize the one before it and write the
+      one before that at the same time, for exporting animations.  The
+      throughput is measured over the whole run rather than per frame.
+---------------------------------------------------------------------------- */
+static int run_pipelined( const std::vector< std::string >& inputs, int width, int height, int workers,
+                          const rasterOptions& options, bool cull, outputFormat format, const std::string& outdir )
+{
+  try
+    {
+      if( width <= 0 or height <= 0 )
+        {
+          mappedOvalFile first( inputs[ 0 ].c_str() );
+
+          width = first.width();
+          height = first.height();
+
+          if( width <= 0 or height <= 0 )
+            {
+              throw std::runtime_error( "no frame buffer size in " + inputs[ 0 ] + ", use -s" );
+            }
+        }
+
+      ovalPipeline pipe( 0, 0, width, height );
+      pipe.setOptions( options );
+
+      if( 0 < workers )
+        {
+          pipe.setWorkers( workers );
+        }
+
+      size_t total_ovals = 0;
+      size_t total_runs = 0;
+
+      auto source = [&]( size_t frame, std::vector< ovalRecord > *ovals )
+        {
+          if( inputs.size() <= frame )
+            return false;
+
+          mappedOvalFile file( inputs[ frame ].c_str() );
+
+          ovals->assign( file.ovals(), file.ovals() + file.size() );
+
+          if( cull )
+            {
+              removeContainedOvals( *ovals, options );
+            }
+
+          return true;
+        };
+
+      auto sink = [&]( size_t frame, std::vector< pixelRun >& runs, const rasterStats& stats )
+        {
+          printf( "%s: %zu ovals, %zu runs, %dx%d, %.3f ms\n", inputs[ frame ].c_str(),
+                  stats.ovalCount + stats.splatCount + stats.needleCount, runs.size(), width, height, 1e3 * stats.totalSeconds );
+
+          total_ovals += stats.ovalCount + stats.splatCount + stats.needleCount;
+          total_runs += runs.size();
+
+          write_output( format, inputs[ frame ], outdir, runs, width, height );
+        };
+
+      auto start = std::chrono::steady_clock::now();
+
+      size_t frames = pipe.run( source, sink );
+
+      std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+      printf( "total: %zu frames, %zu ovals, %zu runs, %.3f ms, %.2f frames/s, %.2f Movals/s\n",
+        frames, total_ovals, total_runs, 1e3 * elapsed.count(),
+        frames / elapsed.count(), 1e-6 * total_ovals / elapsed.count() );
+    }
+  catch( const std::exception& ex )
+    {
+      fprintf( stderr, "%s\n", ex.what() );
+      return 1;
+    }
+
+  return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+  int width = 0;
+  int height = 0;
+  int repeat = 1;
+  int workers = -1;
+  bool cull = false;
+  rasterOptions options;
+  outputFormat format = outputFormat::none;
+  std::string outdir;
+  const char *trace_path = nullptr;
+  std::vector< std::string > inputs;
+
+  for( int ii = 1; ii < argc; ii += 1 )
+    {
+      bool has_value = ii + 1 < argc;
+
+      if( strcmp( argv[ ii ], "-s" ) == 0 and has_value )
+        {
+          if( sscanf( argv[ ++ii ], "%dx%d", & width, & height ) != 2 )
+            {
+              usage( argv[ 0 ] );
+              return 2;
+            }
+        }
+      else if( strcmp( argv[ ii ], "-f" ) == 0 and has_value )
+        {
+          ii += 1;
+
+          if( strcmp( argv[ ii ], "runs" ) == 0 )
+            format = outputFormat::runs;
+          else if( strcmp( argv[ ii ], "pgm" ) == 0 )
+            format = outputFormat::pgm;
+          else if( strcmp( argv[ ii ], "none" ) == 0 )
+            format = outputFormat::none;
+          else
+            {
+              usage( argv[ 0 ] );
+              return 2;
+            }
+        }
+      else if( strcmp( argv[ ii ], "-o" ) == 0 and has_value )
+        {
+          outdir = argv[ ++ii ];
+        }
+      else if( strcmp( argv[ ii ], "-r" ) == 0 and has_value )
+        {
+          repeat = std::max( 1, atoi( argv[ ++ii ] ) );
+        }
+      else if( strcmp( argv[ ii ], "-l" ) == 0 and has_value )
+        {
+          options.splatRadius = (float) atof( argv[ ++ii ] );
+        }
+      else if( strcmp( argv[ ii ], "-a" ) == 0 )
+        {
+          options.coverage = coverageMode::accumulate;
+        }
+      else if( strcmp( argv[ ii ], "-c" ) == 0 )
+        {
+          cull = true;
+        }
+      else if( strcmp( argv[ ii ], "-p" ) == 0 and has_value )
+        {
+          workers = std::max( 0, atoi( argv[ ++ii ] ) );
+        }
+      else if( strcmp( argv[ ii ], "-t" ) == 0 and has_value )
+        {
+          trace_path = argv[ ++ii ];
+        }
+      else if( argv[ ii ][ 0 ] == '-' )
+        {
+          usage( argv[ 0 ] );
+          return 2;
+        }
+      else
+        {
+          inputs.push_back( argv[ ii ] );
+        }
+    }
+
+  if( inputs.empty() )
+    {
+      usage( argv[ 0 ] );
+      return 2;
+    }
+
+#ifndef OVAL_TRACE
+  if( trace_path )
+    {
+      fprintf( stderr, "built without OVAL_TRACE, the trace will be empty\n" );
+    }
+#endif
+
+  traceFile trace( trace_path );
+
+  if( 0 <= workers )
+    {
+      return run_pipelined( inputs, width, height, workers, options, cull, format, outdir );
+    }
+
+  int status = 0;
+  size_t total_ovals = 0;
+  size_t total_runs = 0;
+  double total_seconds = 0.;
+
+  for( const auto& input : inputs )
+    {
+      try
+        {
+          mappedOvalFile file( input.c_str() );
+
+          int ww = 0 < width ? width : file.width();
+          int hh = 0 < height ? height : file.height();
+
+          if( ww <= 0 or hh <= 0 )
+            {
+              throw std::runtime_error( "no frame buffer size in " + input + ", use -s" );
+            }
+
+          std::vector< pixelRun > runs;
+          double best = 0.;
+
+          for( int rr = 0; rr < repeat; rr += 1 )
+            {
+              auto start = std::chrono::steady_clock::now();
+
+              if( cull )  // the culling is part of the time
+                {
+                  std::vector< ovalRecord > ovals( file.ovals(), file.ovals() + file.size() );
+
+                  removeContainedOvals( ovals, options );
+                  runs = ovalListToRaster( ovals, 0, 0, ww, hh, options );
+                }
+              else
+                {
+                  runs = ovalListToRaster( file.ovals(), file.size(), 0, 0, ww, hh, options );
+                }
+
+              std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+              if( rr == 0 or elapsed.count() < best )
+                {
+                  best = elapsed.count();
+                }
+            }
+
+          printf( "%s: %zu ovals, %zu runs, %dx%d, %.3f ms, %.2f Movals/s, %.2f Mruns/s\n",
+            input.c_str(), file.size(), runs.size(), ww, hh, 1e3 * best,
+            1e-6 * file.size() / best, 1e-6 * runs.size() / best );
+
+          total_ovals += file.size();
+          total_runs += runs.size();
+          total_seconds += best;
+
+          write_output( format, input, outdir, runs, ww, hh );
+        }
+      catch( const std::exception& ex )
+        {
+          fprintf( stderr, "%s\n", ex.what() );
+          status = 1;
+        }
+    }
+
+  if( 1 < inputs.size() and 0. < total_seconds )
+    {
+      printf( "total: %zu frames, %zu ovals, %zu runs, %.3f ms, %.2f frames/s, %.2f Movals/s\n",
+        inputs.size(), total_ovals, total_runs, 1e3 * total_seconds,
+        inputs.size() / total_seconds, 1e-6 * total_ovals / total_seconds );
+    }
+
+  return status;
+}
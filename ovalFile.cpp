@@ -0,0 +1,261 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalFile.cpp
+* \description This file contains the code that reads and writes the binary
+*   oval and run file formats
+---------------------------------------------------------------------------- */
+
+#include "ovalFile.h"
+#include <cstdio>
+#include <cstring>
+#include <iso646.h>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#endif
+
+static const char ovalListMagic[ 8 ] = { 'O', 'V', 'A', 'L', 'L', 'I', 'S', 'T' };
+static const char ovalRunsMagic[ 8 ] = { 'O', 'V', 'A', 'L', 'R', 'U', 'N', 'S' };
+
+/** ---------------------------------------------------------------------------
+* \fn make_header
+* \description Fill in a header for a file with the given contents
+---------------------------------------------------------------------------- */
+static ovalFileHeader make_header( const char magic[ 8 ], uint32_t recordSize, size_t count, int width, int height )
+{
+  ovalFileHeader hdr;
+
+  memcpy( hdr.magic, magic, sizeof( hdr.magic ) );
+  hdr.version = ovalFileVersion;
+  hdr.byteOrder = ovalFileByteOrder;
+  hdr.recordSize = recordSize;
+  hdr.reserved = 0;
+  hdr.count = count;
+  hdr.width = width;
+  hdr.height = height;
+
+  return hdr;
+}
+/** ---------------------------------------------------------------------------
+* \fn check_header
+* \description Verify that a header describes a file that we can read.  The
+*     length is the number of bytes available after the header.  The routine
+*     will throw if the header is not valid.
+---------------------------------------------------------------------------- */
+static void check_header( const ovalFileHeader& hdr, const char magic[ 8 ], uint32_t recordSize,
+                          size_t length, const char *path )
+{
+  if( memcmp( hdr.magic, magic, sizeof( hdr.magic ) ) != 0 )
+    {
+      throw std::runtime_error( std::string( "not a valid file: " ) + path );
+    }
+
+  if( hdr.byteOrder != ovalFileByteOrder )
+    {
+      throw std::runtime_error( std::string( "file was written with a different byte order: " ) + path );
+    }
+
+  if( hdr.version != ovalFileVersion or hdr.recordSize != recordSize )
+    {
+      throw std::runtime_error( std::string( "unsupported file version: " ) + path );
+    }
+
+  if( length / recordSize < hdr.count )
+    {
+      throw std::runtime_error( std::string( "file is truncated: " ) + path );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn write_records
+* \description Write a header followed by an array of records.
+---------------------------------------------------------------------------- */
+static void write_records( const char *path, const ovalFileHeader& hdr, const void *records )
+{
+  FILE *fp = fopen( path, "wb" );
+
+  if( not fp )
+    {
+      throw std::runtime_error( std::string( "unable to create file: " ) + path );
+    }
+
+  bool ok = fwrite( & hdr, sizeof( hdr ), 1, fp ) == 1;
+
+  if( ok and 0 < hdr.count )
+    {
+      ok = fwrite( records, hdr.recordSize, hdr.count, fp ) == hdr.count;
+    }
+
+  if( fclose( fp ) != 0 )
+    {
+      ok = false;
+    }
+
+  if( not ok )
+    {
+      throw std::runtime_error( std::string( "unable to write file: " ) + path );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn mappedOvalFile::mappedOvalFile
+---------------------------------------------------------------------------- */
+mappedOvalFile::mappedOvalFile( const char *path ) :
+base_( nullptr ), length_( 0 ), ovals_( nullptr ), count_( 0 ), width_( 0 ), height_( 0 )
+{
+  int fd = open( path, O_RDONLY );
+
+  if( fd < 0 )
+    {
+      throw std::runtime_error( std::string( "unable to open file: " ) + path );
+    }
+
+  struct stat st;
+
+  if( fstat( fd, & st ) != 0 or st.st_size < (off_t) sizeof( ovalFileHeader ) )
+    {
+      close( fd );
+      throw std::runtime_error( std::string( "not a valid file: " ) + path );
+    }
+
+  length_ = st.st_size;
+  base_ = mmap( nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );    // the mapping keeps the file alive
+
+  if( base_ == MAP_FAILED )
+    {
+      base_ = nullptr;
+      throw std::runtime_error( std::string( "unable to map file: " ) + path );
+    }
+
+  const ovalFileHeader *hdr = (const ovalFileHeader *) base_;
+
+  try
+    {
+      check_header( *hdr, ovalListMagic, sizeof( ovalRecord ), length_ - sizeof( ovalFileHeader ), path );
+    }
+  catch( ... )
+    {
+      munmap( base_, length_ );
+      throw;
+    }
+
+  ovals_ = (const ovalRecord *)( (const char *) base_ + sizeof( ovalFileHeader ) );
+  count_ = hdr->count;
+  width_ = hdr->width;
+  height_ = hdr->height;
+
+  // The ovals are read front to back by the rasterizer
+
+  madvise( base_, length_, MADV_SEQUENTIAL );
+}
+/** ----------------------------------------------------------------------------
+  \fn mappedOvalFile::~mappedOvalFile
+---------------------------------------------------------------------------- */
+mappedOvalFile::~mappedOvalFile()
+{
+  if( base_ )
+    {
+      munmap( base_, length_ );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn writeOvalFile
+---------------------------------------------------------------------------- */
+void writeOvalFile( const char *path, const ovalRecord *ol, size_t count, int width, int height )
+{
+  write_records( path, make_header( ovalListMagic, sizeof( ovalRecord ), count, width, height ), ol );
+}
+
+void writeOvalFile( const char *path, const std::vector< ovalRecord >& ol, int width, int height )
+{
+  writeOvalFile( path, ol.data(), ol.size(), width, height );
+}
+/** ---------------------------------------------------------------------------
+* \fn writeRunFile
+---------------------------------------------------------------------------- */
+void writeRunFile( const char *path, const std::vector< pixelRun >& runs, int width, int height )
+{
+  write_records( path, make_header( ovalRunsMagic, sizeof( pixelRun ), runs.size(), width, height ), runs.data() );
+}
+/** ---------------------------------------------------------------------------
+* \fn readRunFile
+---------------------------------------------------------------------------- */
+std::vector< pixelRun > readRunFile( const char *path, int *width, int *height )
+{
+  FILE *fp = fopen( path, "rb" );
+
+  if( not fp )
+    {
+      throw std::runtime_error( std::string( "unable to open file: " ) + path );
+    }
+
+  ovalFileHeader hdr;
+  std::vector< pixelRun > runs;
+  bool ok = fread( & hdr, sizeof( hdr ), 1, fp ) == 1;
+
+  if( ok )
+    {
+      fseek( fp, 0, SEEK_END );
+      long length = ftell( fp ) - (long) sizeof( hdr );
+      fseek( fp, sizeof( hdr ), SEEK_SET );
+
+      try
+        {
+          check_header( hdr, ovalRunsMagic, sizeof( pixelRun ), length, path );
+        }
+      catch( ... )
+        {
+          fclose( fp );
+          throw;
+        }
+
+      runs.resize( hdr.count );
+
+      if( 0 < hdr.count )
+        {
+          ok = fread( runs.data(), sizeof( pixelRun ), hdr.count, fp ) == hdr.count;
+        }
+    }
+
+  fclose( fp );
+
+  if( not ok )
+    {
+      throw std::runtime_error( std::string( "unable to read file: " ) + path );
+    }
+
+  if( width ) *width = hdr.width;
+  if( height ) *height = hdr.height;
+
+  return runs;
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalFile_UnitTests");
+TEST_CASE( "Oval File Header" )
+{
+  ovalFileHeader hdr = make_header( ovalListMagic, sizeof( ovalRecord ), 10, 640, 480 );
+
+  CHECK( hdr.version == ovalFileVersion );
+  CHECK( hdr.count == 10 );
+  CHECK( hdr.width == 640 );
+  CHECK( hdr.height == 480 );
+
+  check_header( hdr, ovalListMagic, sizeof( ovalRecord ), 10 * sizeof( ovalRecord ), "test" );
+
+  CHECK_THROWS( check_header( hdr, ovalRunsMagic, sizeof( ovalRecord ), 10 * sizeof( ovalRecord ), "test" ) );
+  CHECK_THROWS( check_header( hdr, ovalListMagic, sizeof( ovalRecord ), 9 * sizeof( ovalRecord ), "test" ) );
+
+  hdr.byteOrder = 0x04030201;   // as read on a machine with the other byte order
+  CHECK_THROWS( check_header( hdr, ovalListMagic, sizeof( ovalRecord ), 10 * sizeof( ovalRecord ), "test" ) );
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,91 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalFile.h
+ * \description This file contains the binary file formats used to store
+ *   lists of ovals and the pixel runs that are generated from them.  An oval
+ *   file can be memory-mapped and handed to the rasterizer without copying.
+---------------------------------------------------------------------------- */
+
+#ifndef OVALFILE_H
+#define OVALFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// The layout of an oval file is a fixed size header followed by a packed
+/// array of `ovalRecord`.  Both are stored in the byte order of the machine
+/// that wrote the file; the `byteOrder` field is used to reject files that
+/// were written on a machine with a different byte order.
+
+constexpr uint32_t ovalFileVersion = 1;
+constexpr uint32_t ovalFileByteOrder = 0x01020304;
+
+struct ovalFileHeader
+ {
+  char magic[ 8 ];        /// Either "OVALLIST" or "OVALRUNS"
+  uint32_t version;       /// The version of the format, currently ovalFileVersion
+  uint32_t byteOrder;     /// Always ovalFileByteOrder when read on the writing machine
+  uint32_t recordSize;    /// The size of one record in bytes
+  uint32_t reserved;      /// Always zero
+  uint64_t count;         /// The number of records that follow the header
+  int32_t width;          /// The width of the frame buffer, zero if unknown
+  int32_t height;         /// The height of the frame buffer, zero if unknown
+ };
+
+static_assert( sizeof( ovalFileHeader ) == 40, "the oval file header must be packed" );
+static_assert( sizeof( ovalRecord ) == 20, "ovalRecord must be five packed floats" );
+
+/** ----------------------------------------------------------------------------
+  \class mappedOvalFile
+  \description Maps an oval file into memory.  The records can be passed
+      directly to `ovalListToRaster`.  The constructor will throw if the file
+      can not be opened or if it is not a valid oval file.
+---------------------------------------------------------------------------- */
+class mappedOvalFile
+  {
+    public:
+      explicit mappedOvalFile( const char *path );
+      ~mappedOvalFile();
+
+      mappedOvalFile( const mappedOvalFile& ) = delete;
+      mappedOvalFile& operator=( const mappedOvalFile& ) = delete;
+
+      const ovalRecord *ovals() const { return ovals_; }
+      size_t size() const { return count_; }
+
+      int width() const { return width_; }
+      int height() const { return height_; }
+
+    private:
+      void *base_;
+      size_t length_;
+
+      const ovalRecord *ovals_;
+      size_t count_;
+
+      int width_;
+      int height_;
+  };
+
+/// \fn writeOvalFile
+/// \description Writes a list of ovals in the binary oval format.  The width
+///     and height are stored in the header so that batch tools know the size
+///     of the frame buffer.  The method will throw if there is an error.
+void writeOvalFile( const char *path, const ovalRecord *ol, size_t count, int width = 0, int height = 0 );
+
+void writeOvalFile( const char *path, const std::vector< ovalRecord >& ol, int width = 0, int height = 0 );
+
+/// \fn writeRunFile
+/// \description Writes a list of pixel runs in the binary run format.  The
+///     method will throw if there is an error.
+void writeRunFile( const char *path, const std::vector< pixelRun >& runs, int width, int height );
+
+/// \fn readRunFile
+/// \description Reads a list of pixel runs that were written by `writeRunFile`.
+///     The method will throw if there is an error.
+std::vector< pixelRun > readRunFile( const char *path, int *width = nullptr, int *height = nullptr );
+
+#endif //OVALFILE_H
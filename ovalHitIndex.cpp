@@ -0,0 +1,877 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalHitIndex.cpp
+* \description This file contains a spatial index used to find the ovals
+*   under a point
+---------------------------------------------------------------------------- */
+
+#include "ovalHitIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <iso646.h>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#endif
+
+/// An oval that would be added to more cells than this goes on the list of
+/// large ovals instead, which is checked for every query
+static const int max_cells_per_oval = 64;
+
+/** ---------------------------------------------------------------------------
+* \fn prepare_hit
+* \description Keep the terms of the inside test that don't depend on the
+*     point, so that no trig is needed per query.  The math is the same as in
+*     ovalContainsPoint.
+---------------------------------------------------------------------------- */
+static ovalHitIndex::hitRecord prepare_hit( const ovalRecord& oval )
+{
+  float rx2 = oval.radiusx * oval.radiusx;
+  float ry2 = oval.radiusy * oval.radiusy;
+
+  return {
+      oval.centerx,
+      oval.centery,
+      std::cos( oval.angle ),
+      std::sin( oval.angle ),
+      rx2,
+      ry2,
+      std::max( std::fabs( oval.radiusx ), std::fabs( oval.radiusy ) )
+    };
+}
+/** ---------------------------------------------------------------------------
+* \fn contains_point
+---------------------------------------------------------------------------- */
+static bool contains_point( const ovalHitIndex::hitRecord& hit, float xx, float yy )
+{
+  float dx = xx - hit.centerx;
+  float dy = yy - hit.centery;
+
+  float uu = hit.cosT * dx + hit.sinT * dy;
+  float vv = hit.cosT * dy - hit.sinT * dx;
+
+  return uu * uu * hit.ry2 + vv * vv * hit.rx2 <= hit.rx2 * hit.ry2 and 0.f < hit.rx2 * hit.ry2;
+}
+/** ---------------------------------------------------------------------------
+* \fn ellipse_root
+* \description Find the root of the function used by distance_to_ellipse by
+*     bisection, see "Distance from a Point to an Ellipse, an Ellipsoid, or a
+*     Hyperellipsoid" by David Eberly.
+---------------------------------------------------------------------------- */
+static double ellipse_root( double r0, double z0, double z1, double gg )
+{
+  double n0 = r0 * z0;
+  double s0 = z1 - 1.;
+  double s1 = ( gg < 0. ? 0. : std::hypot( n0, z1 ) - 1. );
+  double ss = 0.;
+
+  for( int ii = 0; ii < 100; ii += 1 )
+    {
+      ss = 0.5 * ( s0 + s1 );
+
+      if( ss == s0 or ss == s1 ) break;
+
+      double ratio0 = n0 / ( ss + r0 );
+      double ratio1 = z1 / ( ss + 1. );
+
+      gg = ratio0 * ratio0 + ratio1 * ratio1 - 1.;
+
+      if( 0. < gg )
+        s0 = ss;
+      else if( gg < 0. )
+        s1 = ss;
+      else
+        break;
+    }
+
+  return ss;
+}
+/** ---------------------------------------------------------------------------
+* \fn distance_to_ellipse
+* \description The distance from a point in the first quadrant to an axis
+*     aligned ellipse with radii e0 >= e1 > 0.
+---------------------------------------------------------------------------- */
+static double distance_to_ellipse( double e0, double e1, double y0, double y1 )
+{
+  double distance;
+
+  if( 0. < y1 )
+    {
+      if( 0. < y0 )
+        {
+          double z0 = y0 / e0;
+          double z1 = y1 / e1;
+          double gg = z0 * z0 + z1 * z1 - 1.;
+
+          if( gg != 0. )
+            {
+              double r0 = ( e0 / e1 ) * ( e0 / e1 );
+              double sbar = ellipse_root( r0, z0, z1, gg );
+
+              double x0 = r0 * y0 / ( sbar + r0 );
+              double x1 = y1 / ( sbar + 1. );
+
+              distance = std::hypot( x0 - y0, x1 - y1 );
+            }
+          else distance = 0.;
+        }
+      else distance = std::fabs( y1 - e1 );
+    }
+  else  // the point is on the long axis
+    {
+      double numer0 = e0 * y0;
+      double denom0 = e0 * e0 - e1 * e1;
+
+      if( numer0 < denom0 )
+        {
+          double xde0 = numer0 / denom0;
+          double x0 = e0 * xde0;
+          double x1 = e1 * std::sqrt( 1. - xde0 * xde0 );
+
+          distance = std::hypot( x0 - y0, x1 );
+        }
+      else distance = std::fabs( y0 - e0 );
+    }
+
+  return distance;
+}
+/** ---------------------------------------------------------------------------
+* \fn distance_to_oval
+* \description The distance from a point to the closest point of an oval,
+*     which is zero when the point is inside.
+---------------------------------------------------------------------------- */
+static float distance_to_oval( const ovalRecord& oval, float xx, float yy )
+{
+  if( ovalContainsPoint( oval, xx, yy ) ) return 0.f;
+
+  double sinT = std::sin( (double) oval.angle );
+  double cosT = std::cos( (double) oval.angle );
+
+  double dx = xx - (double) oval.centerx;
+  double dy = yy - (double) oval.centery;
+
+  // In the frame of the oval, folded into the first quadrant with the long
+  // axis along u
+
+  double uu = std::fabs( cosT * dx + sinT * dy );
+  double vv = std::fabs( cosT * dy - sinT * dx );
+  double e0 = std::fabs( oval.radiusx );
+  double e1 = std::fabs( oval.radiusy );
+
+  if( e0 < e1 )
+    {
+      std::swap( e0, e1 );
+      std::swap( uu, vv );
+    }
+
+  double distance;
+
+  if( e1 == 0. )    // a flat oval is a line segment
+    {
+      distance = std::hypot( std::max( 0., uu - e0 ), vv );
+    }
+  else
+    {
+      distance = distance_to_ellipse( e0, e1, uu, vv );
+    }
+
+  return (float) distance;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::ovalHitIndex
+---------------------------------------------------------------------------- */
+ovalHitIndex::ovalHitIndex() :
+left_( 0.f ), top_( 0.f ), cellSize_( 1.f ), cols_( 0 ), rows_( 0 )
+{
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::build
+  \description The size of the cells is the average size of the ovals, but
+      never so small that there are many more cells than ovals.
+---------------------------------------------------------------------------- */
+void ovalHitIndex::build( const std::vector< ovalRecord >& ol )
+{
+  clear();
+
+  if( not ol.empty() )
+    {
+      ovals_ = ol;
+      blist_.reserve( ol.size() );
+      hits_.reserve( ol.size() );
+
+      floatBounds bounds = ovalBounds( ol[ 0 ] );
+      double extent = 0.;
+
+      for( const auto& one : ol )
+        {
+          floatBounds bb = ovalBounds( one );
+
+          bounds.add( bb );
+          blist_.push_back( bb );
+          hits_.push_back( prepare_hit( one ) );
+          extent += std::max( bb.right - bb.left, bb.bottom - bb.top );
+        }
+
+      float ww = std::max( 1.f, bounds.right - bounds.left );
+      float hh = std::max( 1.f, bounds.bottom - bounds.top );
+
+      cellSize_ = std::max( (float)( extent / ol.size() ), std::sqrt( ww * hh / ( 2.f * ol.size() ) ) );
+      cellSize_ = std::max( 1.f, cellSize_ );
+
+      left_ = bounds.left;
+      top_ = bounds.top;
+      cols_ = std::max( 1, (int) std::ceil( ww / cellSize_ ) );
+      rows_ = std::max( 1, (int) std::ceil( hh / cellSize_ ) );
+
+      cells_.resize( (size_t) cols_ * rows_ );
+
+      for( int ii = 0; ii < ovals_.size(); ii += 1 )
+        {
+          insert( ii );
+        }
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::add
+  \description Ovals that are added outside of the grid go into the cells on
+      its border.  The results stay correct, but if many ovals are added this
+      way it is better to call build again.
+---------------------------------------------------------------------------- */
+int ovalHitIndex::add( const ovalRecord& oval )
+{
+  if( cells_.empty() )
+    {
+      build( std::vector< ovalRecord >( 1, oval ) );
+    }
+  else
+    {
+      ovals_.push_back( oval );
+      blist_.push_back( ovalBounds( oval ) );
+      hits_.push_back( prepare_hit( oval ) );
+      insert( (int) ovals_.size() - 1 );
+    }
+
+  return (int) ovals_.size() - 1;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::update
+---------------------------------------------------------------------------- */
+void ovalHitIndex::update( int index, const ovalRecord& oval )
+{
+  remove( index );
+
+  ovals_[ index ] = oval;
+  blist_[ index ] = ovalBounds( oval );
+  hits_[ index ] = prepare_hit( oval );
+
+  insert( index );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::clear
+---------------------------------------------------------------------------- */
+void ovalHitIndex::clear()
+{
+  ovals_.clear();
+  blist_.clear();
+  hits_.clear();
+  cells_.clear();
+  large_.clear();
+
+  cols_ = 0;
+  rows_ = 0;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::topmost
+---------------------------------------------------------------------------- */
+int ovalHitIndex::topmost( float xx, float yy ) const
+{
+  int found = -1;
+
+  int col, row;
+
+  auto test = [&]( int index ) {
+    const floatBounds& bb = blist_[ index ];
+
+    if( found < index and
+        bb.left <= xx and xx <= bb.right and bb.top <= yy and yy <= bb.bottom and
+        contains_point( hits_[ index ], xx, yy ) )
+      {
+        found = index;
+      }
+  };
+
+  if( cell_range( { xx, yy, xx, yy }, & col, & row, & col, & row ) )
+    {
+      for( int index : cells_[ (size_t) row * cols_ + col ] )
+        {
+          test( index );
+        }
+
+      for( int index : large_ )
+        {
+          test( index );
+        }
+    }
+
+  return found;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::within
+  \description The exact distance is only computed for the ovals that are
+      neither clearly close nor clearly far.  The distance along the line to
+      the center is never less than the distance to the closest point, and
+      the distance to the center less the largest radius is never more.
+---------------------------------------------------------------------------- */
+void ovalHitIndex::within( float xx, float yy, float radius, std::vector< int > *found ) const
+{
+  found->clear();
+
+  int col0, row0, col1, row1;
+
+  if( cell_range( { xx - radius, yy - radius, xx + radius, yy + radius }, & col0, & row0, & col1, & row1 ) )
+    {
+      auto test = [&]( int index ) {
+        const floatBounds& bb = blist_[ index ];
+
+        if( bb.left <= xx + radius and xx - radius <= bb.right and
+            bb.top <= yy + radius and yy - radius <= bb.bottom )
+          {
+            const hitRecord& hit = hits_[ index ];
+
+            float dx = xx - hit.centerx;
+            float dy = yy - hit.centery;
+            float center_distance = std::hypot( dx, dy );
+
+            bool is_near;
+
+            if( radius < center_distance - hit.maxRadius )
+              {
+                is_near = false;
+              }
+            else if( contains_point( hit, xx, yy ) )
+              {
+                is_near = true;
+              }
+            else
+              {
+                // The radius of the oval in the direction of the point
+
+                float uu = hit.cosT * dx + hit.sinT * dy;
+                float vv = hit.cosT * dy - hit.sinT * dx;
+                float rr2 = uu * uu * hit.ry2 + vv * vv * hit.rx2;
+
+                float along = 0.f < rr2 ? center_distance * ( 1.f - std::sqrt( hit.rx2 * hit.ry2 / rr2 ) ) : center_distance;
+
+                is_near = along <= radius or distance_to_oval( ovals_[ index ], xx, yy ) <= radius;
+              }
+
+            if( is_near )
+              {
+                found->push_back( index );
+              }
+          }
+      };
+
+      for( int row = row0; row <= row1; row += 1 )
+        {
+          for( int col = col0; col <= col1; col += 1 )
+            {
+              for( int index : cells_[ (size_t) row * cols_ + col ] )
+                {
+                  test( index );
+                }
+            }
+        }
+
+      for( int index : large_ )
+        {
+          test( index );
+        }
+
+      // An oval is in every cell that it touches, so remove the repeats
+
+      std::sort( found->begin(), found->end() );
+      found->erase( std::unique( found->begin(), found->end() ), found->end() );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::cell_range
+  \description Find the cells that are covered by the given bounds.  Bounds
+      that are outside of the grid are clamped to the cells on its border.
+  \returns false if the index is empty
+---------------------------------------------------------------------------- */
+bool ovalHitIndex::cell_range( const floatBounds& bb, int *col0, int *row0, int *col1, int *row1 ) const
+{
+  if( cells_.empty() ) return false;
+
+  auto clamp_cell = []( float value, int count ) {
+    return (int) std::min( (float)( count - 1 ), std::max( 0.f, std::floor( value ) ) );
+  };
+
+  *col0 = clamp_cell( ( bb.left - left_ ) / cellSize_, cols_ );
+  *col1 = clamp_cell( ( bb.right - left_ ) / cellSize_, cols_ );
+  *row0 = clamp_cell( ( bb.top - top_ ) / cellSize_, rows_ );
+  *row1 = clamp_cell( ( bb.bottom - top_ ) / cellSize_, rows_ );
+
+  return true;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::insert
+---------------------------------------------------------------------------- */
+void ovalHitIndex::insert( int index )
+{
+  int col0, row0, col1, row1;
+
+  cell_range( blist_[ index ], & col0, & row0, & col1, & row1 );
+
+  if( max_cells_per_oval < ( col1 - col0 + 1 ) * ( row1 - row0 + 1 ) )
+    {
+      large_.push_back( index );
+    }
+  else
+    {
+      for( int row = row0; row <= row1; row += 1 )
+        {
+          for( int col = col0; col <= col1; col += 1 )
+            {
+              cells_[ (size_t) row * cols_ + col ].push_back( index );
+            }
+        }
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalHitIndex::remove
+---------------------------------------------------------------------------- */
+void ovalHitIndex::remove( int index )
+{
+  auto erase_from = [index]( std::vector< int >& list ) {
+    auto found = std::find( list.begin(), list.end(), index );
+
+    if( found != list.end() )
+      {
+        list.erase( found );
+      }
+  };
+
+  int col0, row0, col1, row1;
+
+  cell_range( blist_[ index ], & col0, & row0, & col1, & row1 );
+
+  if( max_cells_per_oval < ( col1 - col0 + 1 ) * ( row1 - row0 + 1 ) )
+    {
+      erase_from( large_ );
+    }
+  else
+    {
+      for( int row = row0; row <= row1; row += 1 )
+        {
+          for( int col = col0; col <= col1; col += 1 )
+            {
+              erase_from( cells_[ (size_t) row * cols_ + col ] );
+            }
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn max_on_circle
+* \description An upper bound on the largest value of
+*     u'Hu + 2g'u over the unit circle.  For any mu above the largest
+*     eigenvalue of H, mu + g'(mu - H)^-1 g is such a bound, and at its
+*     smallest it is the largest value itself, so mu is found by bisection.
+*     Stopping the bisection early still gives a bound, a little larger.
+---------------------------------------------------------------------------- */
+static double max_on_circle( double h00, double h01, double h11, double g0, double g1 )
+{
+  // The eigenvalues and the first eigenvector of H
+
+  double mean = 0.5 * ( h00 + h11 );
+  double half = std::hypot( 0.5 * ( h00 - h11 ), h01 );
+  double lambda1 = mean + half;
+  double lambda2 = mean - half;
+
+  double v0 = h01;
+  double v1 = lambda1 - h00;
+
+  if( std::hypot( v0, v1 ) < 1e-300 )
+    {
+      v0 = lambda1 - h11;
+      v1 = h01;
+    }
+
+  double vlen = std::hypot( v0, v1 );
+
+  if( vlen < 1e-300 )   // H is a multiple of the identity
+    {
+      v0 = 1.;
+      v1 = 0.;
+      vlen = 1.;
+    }
+
+  // g in the frame of the eigenvectors
+
+  double gamma1 = ( v0 * g0 + v1 * g1 ) / vlen;
+  double gamma2 = ( v0 * g1 - v1 * g0 ) / vlen;
+  double glen = std::hypot( g0, g1 );
+
+  auto bound = [&]( double mu )
+    {
+      double rr = mu + gamma1 * gamma1 / ( mu - lambda1 );
+
+      if( lambda2 < mu )
+        rr += gamma2 * gamma2 / ( mu - lambda2 );
+
+      return rr;
+    };
+
+  if( glen == 0. )
+    return lambda1;
+
+  // The derivative of the bound is 1 - phi( mu ), with phi decreasing from
+  // infinity down to at most 1 at lambda1 + |g|
+
+  double lo = lambda1;
+  double hi = lambda1 + glen;
+
+  for( int ii = 0; ii < 100 and lo < hi; ii += 1 )
+    {
+      double mid = 0.5 * ( lo + hi );
+
+      if( mid <= lo or hi <= mid )
+        break;
+
+      double t1 = gamma1 / ( mid - lambda1 );
+      double t2 = gamma2 / ( mid - lambda2 );
+
+      if( 1. < t1 * t1 + t2 * t2 )
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+  // When |g| is lost next to lambda1, the plain bound lambda1 + 2 |g| is as good
+
+  return hi == lambda1 ? lambda1 + 2. * glen : bound( hi );
+}
+/** ---------------------------------------------------------------------------
+* \fn oval_inside_oval
+* \description Whether the inner oval, with its radii grown by the factor
+*     grow, is inside of the outer oval with its radii shrunk by the factor
+*     shrink.  The inner oval is mapped into the frame where the outer one
+*     is the unit circle, and the largest squared distance of its boundary
+*     from the center is bounded by max_on_circle.
+---------------------------------------------------------------------------- */
+static bool oval_inside_oval( const ovalRecord& inner, double grow, const ovalRecord& outer, double shrink )
+{
+  double ax = outer.radiusx * shrink;
+  double ay = outer.radiusy * shrink;
+  double bx = inner.radiusx * grow;
+  double by = inner.radiusy * grow;
+
+  if( not ( 0. < ax and 0. < ay ) or not std::isfinite( bx ) or not std::isfinite( by ) )
+    return false;
+
+  double cosA = std::cos( (double) outer.angle );
+  double sinA = std::sin( (double) outer.angle );
+  double cosB = std::cos( (double) inner.angle );
+  double sinB = std::sin( (double) inner.angle );
+
+  // The center of the inner oval, and its axes, in the frame of the outer
+
+  double dx = (double) inner.centerx - outer.centerx;
+  double dy = (double) inner.centery - outer.centery;
+
+  double q0 = ( cosA * dx + sinA * dy ) / ax;
+  double q1 = ( cosA * dy - sinA * dx ) / ay;
+
+  double n00 = ( cosA * cosB + sinA * sinB ) * bx / ax;   // the image of the x axis of the inner oval
+  double n10 = ( cosA * sinB - sinA * cosB ) * bx / ay;
+  double n01 = ( -cosA * sinB + sinA * cosB ) * by / ax;  // the image of its y axis
+  double n11 = ( cosA * cosB + sinA * sinB ) * by / ay;
+
+  double h00 = n00 * n00 + n10 * n10;
+  double h01 = n00 * n01 + n10 * n11;
+  double h11 = n01 * n01 + n11 * n11;
+  double g0 = n00 * q0 + n10 * q1;
+  double g1 = n01 * q0 + n11 * q1;
+
+  return max_on_circle( h00, h01, h11, g0, g1 ) + q0 * q0 + q1 * q1 <= 1.;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalContainsOval
+* \description Whether the inner oval, grown by margin in every direction, is
+*     inside of the outer oval.  Since the ovals are convex and centered, the
+*     inner oval grown by margin is inside of it scaled by 1 + margin over its
+*     smaller radius, and the outer oval scaled by 1 - margin over its
+*     smaller radius is inside of it shrunk by margin.  The margin is taken
+*     from whichever oval it scales the least.
+---------------------------------------------------------------------------- */
+bool ovalContainsOval( const ovalRecord& outer, const ovalRecord& inner, float margin )
+{
+  double outer_min = std::min( std::fabs( outer.radiusx ), std::fabs( outer.radiusy ) );
+  double inner_min = std::min( std::fabs( inner.radiusx ), std::fabs( inner.radiusy ) );
+
+  if( not ( 0. < outer_min ) or not std::isfinite( inner.centerx ) or not std::isfinite( inner.centery ) )
+    return false;
+
+  if( margin <= 0.f )
+    return oval_inside_oval( inner, 1., outer, 1. );
+
+  if( outer_min <= inner_min )
+    return oval_inside_oval( inner, 1. + margin / inner_min, outer, 1. );
+
+  return margin < outer_min and oval_inside_oval( inner, 1., outer, 1. - margin / outer_min );
+}
+/** ---------------------------------------------------------------------------
+* \fn removeContainedOvals
+* \description The ovals are taken from the largest to the smallest, so
+*     that the ovals that could contain an oval have all been decided before
+*     it.  The candidates are the ovals of the index that hold its center,
+*     less the ones that were already removed.
+*
+*     The margin is what makes the output the same.  Every pixel that the
+*     edges of a removed oval touch is within 1.5 pixels of it, and so it
+*     is wholly inside of the containing oval, where that oval alone makes
+*     the pixel solid.  The rest of the margin covers the rounding of the
+*     roots, which grows with the size of the ovals, and the footprint of
+*     ovals that are splatted.
+*
+*     That only holds for an oval whose pixels are bounded by its shape.  An
+*     oval less than two pixels thick can fall between two scanlines, and
+*     then the sweep draws the whole of its bounding box, which for a long,
+*     rotated oval reaches well past its edges.  So an oval whose smaller
+*     radius is under one pixel is kept unless it is splatted or drawn as
+*     a needle instead.
+---------------------------------------------------------------------------- */
+int removeContainedOvals( std::vector< ovalRecord >& ol, const rasterOptions& options )
+{
+  if( options.coverage != coverageMode::unite or ol.size() < 2 )
+    return 0;
+
+  auto is_splat = [&options]( const ovalRecord& oval )
+    {
+      return oval.radiusx < options.splatRadius and oval.radiusy < options.splatRadius;
+    };
+
+  ovalHitIndex index;
+  index.build( ol );
+
+  std::vector< int > order( ol.size() );
+  std::vector< double > area( ol.size() );
+  std::vector< bool > removed( ol.size(), false );
+
+  for( size_t ii = 0; ii < ol.size(); ii += 1 )
+    {
+      order[ ii ] = (int) ii;
+      area[ ii ] = std::fabs( (double) ol[ ii ].radiusx * ol[ ii ].radiusy );
+    }
+
+  std::stable_sort( order.begin(), order.end(), [&area]( int one, int two ) { return area[ two ] < area[ one ]; } );
+
+  std::vector< int > found;
+  int num_removed = 0;
+
+  for( int ii : order )
+    {
+      const ovalRecord& inner = ol[ ii ];
+      float inner_max = std::max( std::fabs( inner.radiusx ), std::fabs( inner.radiusy ) );
+      float inner_min = std::min( std::fabs( inner.radiusx ), std::fabs( inner.radiusy ) );
+
+      if( inner_min < 1.f and not is_splat( inner ) and not ( inner_min < options.needleRadius ) )
+        continue;
+
+      index.within( inner.centerx, inner.centery, 0.f, & found );
+
+      for( int jj : found )
+        {
+          const ovalRecord& outer = ol[ jj ];
+
+          if( jj == ii or removed[ jj ] or area[ jj ] <= area[ ii ] or is_splat( outer ) )
+            continue;
+
+          float outer_max = std::max( std::fabs( outer.radiusx ), std::fabs( outer.radiusy ) );
+
+          float margin = 2.f + 2e-3f * ( outer_max + inner_max ) +
+                         1e-5f * ( std::fabs( outer.centerx ) + std::fabs( outer.centery ) );
+
+          if( is_splat( inner ) )
+            {
+              margin += 2.f * inner_max;
+            }
+
+          if( ovalContainsOval( outer, inner, margin ) )
+            {
+              removed[ ii ] = true;
+              num_removed += 1;
+              break;
+            }
+        }
+    }
+
+  if( 0 < num_removed )
+    {
+      size_t kept = 0;
+
+      for( size_t ii = 0; ii < ol.size(); ii += 1 )
+        {
+          if( not removed[ ii ] )
+            {
+              ol[ kept ] = ol[ ii ];
+              kept += 1;
+            }
+        }
+
+      ol.resize( kept );
+    }
+
+  return num_removed;
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalHitIndex_UnitTests");
+TEST_CASE( "Distance To Oval" )
+{
+  ovalRecord circle{ 10.f, 10.f, 5.f, 5.f, 0.f };
+
+  CHECK( distance_to_oval( circle, 10.f, 10.f ) == 0.f );
+  CHECK( distance_to_oval( circle, 20.f, 10.f ) == doctest::Approx( 5.f ) );
+  CHECK( distance_to_oval( circle, 13.f, 14.f ) == doctest::Approx( 0.f ) );
+  CHECK( distance_to_oval( circle, 16.f, 18.f ) == doctest::Approx( 5.f ) );
+
+  ovalRecord oval{ 0.f, 0.f, 2.f, 8.f, M_PI_2 };   // the long axis is along x
+
+  CHECK( distance_to_oval( oval, 10.f, 0.f ) == doctest::Approx( 2.f ) );
+  CHECK( distance_to_oval( oval, 0.f, -5.f ) == doctest::Approx( 3.f ) );
+
+  ovalRecord flat{ 0.f, 0.f, 4.f, 0.f, 0.f };
+
+  CHECK( distance_to_oval( flat, 2.f, 3.f ) == doctest::Approx( 3.f ) );
+  CHECK( distance_to_oval( flat, 7.f, 4.f ) == doctest::Approx( 5.f ) );
+}
+TEST_CASE( "Oval Contains Oval" )
+{
+  ovalRecord circle{ 0.f, 0.f, 10.f, 10.f, 0.f };
+
+  CHECK( ovalContainsOval( circle, { 5.9f, 0.f, 4.f, 4.f, 0.f } ) );
+  CHECK_FALSE( ovalContainsOval( circle, { 6.1f, 0.f, 4.f, 4.f, 0.f } ) );
+  CHECK( ovalContainsOval( circle, { 0.f, 5.4f, 4.f, 4.f, 0.f }, 0.5f ) );
+  CHECK_FALSE( ovalContainsOval( circle, { 0.f, 5.6f, 4.f, 4.f, 0.f }, 0.5f ) );
+
+  ovalRecord oval{ 20.f, 10.f, 10.f, 5.f, 0.6f };
+
+  CHECK( ovalContainsOval( oval, { 20.f, 10.f, 4.9f, 4.9f, 0.f } ) );
+  CHECK_FALSE( ovalContainsOval( oval, { 20.f, 10.f, 5.1f, 5.1f, 0.f } ) );
+  CHECK( ovalContainsOval( oval, { 20.f, 10.f, 9.9f, 4.95f, 0.6f } ) );
+  CHECK_FALSE( ovalContainsOval( oval, { 20.f, 10.f, 9.9f, 4.95f, 0.7f } ) );
+  CHECK_FALSE( ovalContainsOval( oval, { 20.f, 10.f, 5.f, 10.f, 0.6f } ) );
+  CHECK_FALSE( ovalContainsOval( oval, oval, 0.01f ) );
+
+  // Flat ovals contain nothing, but can be inside
+
+  CHECK_FALSE( ovalContainsOval( { 0.f, 0.f, 10.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f, 0.f } ) );
+  CHECK( ovalContainsOval( circle, { 1.f, 1.f, 5.f, 0.f, 1.f }, 1.f ) );
+}
+TEST_CASE( "Remove Contained Ovals" )
+{
+  // Detections inside of detections
+
+  std::vector< ovalRecord > ol;
+
+  for( int ii = 0; ii < 12; ii += 1 )
+    {
+      float cx = 20.f + ( ii % 4 ) * 45.f + 0.37f * ii;
+      float cy = 25.f + ( ii / 4 ) * 50.f - 0.21f * ii;
+
+      ol.push_back( { cx, cy, 18.f + ii % 3, 14.f, 0.2f * ii } );
+      ol.push_back( { cx + 2.f, cy - 1.f, 8.f, 5.f, 0.5f * ii } );       // well inside
+      ol.push_back( { cx + 12.f, cy + 3.f, 5.f, 4.f, 0.f } );            // near the edge or across it
+      ol.push_back( { cx - 5.f, cy + 4.f, 0.3f, 0.2f, 0.f } );           // tiny, for splatting
+    }
+
+  ol.push_back( { 95.f, 80.f, 120.f, 90.f, 0.1f } );   // holds some of the others
+
+  for( int mode = 0; mode < 4; mode += 1 )
+    {
+      rasterOptions options;
+
+      if( mode == 1 )
+        options.antialias = false;
+      else if( mode == 2 )
+        options.splatRadius = 1.f;
+      else if( mode == 3 )
+        options.coverage = coverageMode::accumulate;
+
+      std::vector< ovalRecord > culled( ol );
+
+      int removed = removeContainedOvals( culled, options );
+
+      CHECK( culled.size() + removed == ol.size() );
+
+      if( mode == 3 )
+        {
+          CHECK( removed == 0 );
+          continue;
+        }
+
+      CHECK( 24 < removed );
+
+      auto expected = ovalListToRaster( ol, 0, 0, 200, 180, options );
+      auto runs = ovalListToRaster( culled, 0, 0, 200, 180, options );
+
+      REQUIRE( runs.size() == expected.size() );
+
+      bool same = true;
+
+      for( size_t ii = 0; ii < runs.size(); ii += 1 )
+        {
+          same = same and runs[ ii ].lineY == expected[ ii ].lineY and runs[ ii ].startX == expected[ ii ].startX and
+                 runs[ ii ].endX == expected[ ii ].endX and runs[ ii ].value == expected[ ii ].value;
+        }
+
+      CHECK( same );
+    }
+}
+TEST_CASE( "Keep Thin Contained Ovals" )
+{
+  // The inner oval is too thin for the scanlines, so it is drawn as its
+  // bounding box, which reaches outside of the outer oval
+
+  std::vector< ovalRecord > ol = {
+    { 106.645485f, 124.217476f, 21.384409f, 17.1544876f, 1.33527684f },
+    { 107.648338f, 128.3965f, 13.33358f, 0.0719785169f, 2.53444815f }
+  };
+
+  for( int mode = 0; mode < 3; mode += 1 )
+    {
+      rasterOptions options;
+
+      if( mode == 1 )
+        options.needleRadius = 1.f;
+      else if( mode == 2 )
+        options.antialias = false;
+
+      std::vector< ovalRecord > culled( ol );
+
+      int removed = removeContainedOvals( culled, options );
+
+      CHECK( removed == ( mode == 1 ? 1 : 0 ) );
+
+      auto expected = ovalListToRaster( ol, 80, 100, 140, 150, options );
+      auto runs = ovalListToRaster( culled, 80, 100, 140, 150, options );
+
+      REQUIRE( runs.size() == expected.size() );
+
+      bool same = true;
+
+      for( size_t ii = 0; ii < runs.size(); ii += 1 )
+        {
+          same = same and runs[ ii ].lineY == expected[ ii ].lineY and runs[ ii ].startX == expected[ ii ].startX and
+                 runs[ ii ].endX == expected[ ii ].endX and runs[ ii ].value == expected[ ii ].value;
+        }
+
+      CHECK( same );
+    }
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,97 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalHitIndex.h
+ * \description This file contains a spatial index used to find the ovals
+ *   under a point, for example under the mouse.
+---------------------------------------------------------------------------- */
+
+#ifndef OVALHITINDEX_H
+#define OVALHITINDEX_H
+
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/** ----------------------------------------------------------------------------
+  \class ovalHitIndex
+  \description A uniform grid over the bounds of a list of ovals.  Each cell
+      holds the indices of the ovals whose bounds touch it, and ovals that
+      would span too many cells are kept on a short list of their own.  The
+      candidates from the grid are checked with an exact inside test.  The
+      indices are the positions of the ovals in the list given to `build`,
+      and ovals drawn later are considered to be on top.
+---------------------------------------------------------------------------- */
+class ovalHitIndex
+  {
+    public:
+      /// The terms of the inside test that don't depend on the point
+      struct hitRecord
+        {
+          float centerx;
+          float centery;
+          float cosT;
+          float sinT;
+          float rx2;
+          float ry2;
+          float maxRadius;
+        };
+
+      ovalHitIndex();
+
+      /// Replace the contents of the index with the given list of ovals
+      void build( const std::vector< ovalRecord >& ol );
+
+      /// Add an oval at the end of the list, it becomes the topmost oval
+      int add( const ovalRecord& oval );
+
+      /// Change the oval at the given index, for example after it was moved
+      void update( int index, const ovalRecord& oval );
+
+      void clear();
+
+      size_t size() const { return ovals_.size(); }
+
+      /// The bounds of the oval at the given index, as last added or updated
+      const floatBounds& bounds( int index ) const { return blist_[ index ]; }
+
+      /// \returns the index of the last oval that contains the point, or -1
+      int topmost( float xx, float yy ) const;
+
+      /// Find all the ovals that are at most the given distance away from
+      /// the point, in the order in which they were added
+      void within( float xx, float yy, float radius, std::vector< int > *found ) const;
+
+    private:
+      bool cell_range( const floatBounds& bb, int *col0, int *row0, int *col1, int *row1 ) const;
+      void insert( int index );
+      void remove( int index );
+
+      std::vector< ovalRecord > ovals_;
+      std::vector< floatBounds > blist_;
+      std::vector< hitRecord > hits_;
+
+      float left_;
+      float top_;
+      float cellSize_;
+      int cols_;
+      int rows_;
+
+      std::vector< std::vector< int > > cells_;
+      std::vector< int > large_;    /// The ovals that cover too many cells
+  };
+
+/// \fn ovalContainsOval
+/// \description Exact test of whether one oval, grown by the margin in every
+///     direction, is inside of another.
+bool ovalContainsOval( const ovalRecord& outer, const ovalRecord& inner, float margin = 0.f );
+
+/// \fn removeContainedOvals
+/// \description Remove the ovals that are inside of another oval, far enough
+///     from its edge that rasterizing the list with the given options gives
+///     the same runs with or without them.  Only the union of the coverage
+///     allows this, so nothing is removed when accumulating.  The ovals that
+///     remain keep their order.
+/// \returns The number of ovals that were removed
+int removeContainedOvals( std::vector< ovalRecord >& ol, const rasterOptions& options = rasterOptions() );
+
+#endif //OVALHITINDEX_H
@@ -0,0 +1,763 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalKernels.cpp
+* \description This file contains the batched kernels that compute the
+*   bounds of many ovals, and where many ovals cross a scanline, at once.
+*   Each kernel has a scalar form that is used for the ovals left over at the
+*   end of a batch, and the vector forms do the same operations in the same
+*   order so that the results are the same bit for bit.  This is also why
+*   the file is built without contracting multiplies and adds into FMAs.
+---------------------------------------------------------------------------- */
+
+#include "ovalKernels.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iso646.h>
+
+#if defined( __AVX2__ )
+#define KERNELS_AVX2
+#include <immintrin.h>
+#elif defined( __SSE2__ ) or defined( _M_X64 )
+#define KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include <random>
+#endif
+
+/// The number of ovals whose trigonometry is done before the vector part of
+/// `batchBounds`, small enough for the scratch arrays to stay in the cache
+static const size_t bounds_chunk = 64;
+
+/// The terms of the quadratic for one oval, the same as one entry of the
+/// prepared arrays in `ovalArrays`
+struct rootTerms
+ {
+  float centerx;
+  float centery;
+  float sinT;
+  float cosT;
+  float spread;
+  float slope;
+  float area2;
+  float twoA;
+  float fourA;
+ };
+
+/** ---------------------------------------------------------------------------
+* \fn prepare_terms
+* \description The terms that don't depend on the line.  The trigonometry is
+*     done in double precision, and everything else in the same order as
+*     the per line part would, so that the roots come out as they would
+*     from the full expressions.
+---------------------------------------------------------------------------- */
+static inline rootTerms prepare_terms( const ovalRecord& oval )
+{
+  float sinT = (float) std::sin( (double) oval.angle );
+  float cosT = (float) std::cos( (double) oval.angle );
+
+  float sin2T = sinT * sinT;
+  float cos2T = cosT * cosT;
+
+  float rx2 = oval.radiusx * oval.radiusx;
+  float ry2 = oval.radiusy * oval.radiusy;
+
+  float aa = rx2 * sin2T + ry2 * cos2T;
+
+  return rootTerms{
+      oval.centerx,
+      oval.centery,
+      sinT,
+      cosT,
+      ry2 - rx2,
+      rx2 * cos2T + ry2 * sin2T,
+      rx2 * ry2,
+      2.f * aa,
+      4.f * aa
+    };
+}
+/** ---------------------------------------------------------------------------
+* \fn solve_terms
+* \description The roots of one oval on the line at yy.
+---------------------------------------------------------------------------- */
+static inline int solve_terms( const rootTerms& tt, float yy, float *left, float *right )
+{
+  float dy = yy - tt.centery;
+
+  float bb = 2.f * dy * tt.sinT * tt.cosT * tt.spread;
+  float cc = dy * dy * tt.slope - tt.area2;
+
+  float radical = bb * bb - tt.fourA * cc;
+
+  int num_roots;
+
+  // If the radical is positive, then there are two roots
+
+  if( 0.f < radical )
+    {
+      num_roots = 2;
+
+      float sr = std::sqrt( radical );   // This is always positive
+
+      *left = tt.centerx + ( ( 0.f - sr - bb ) / tt.twoA );
+      *right = tt.centerx + ( ( sr - bb ) / tt.twoA );
+    }
+  else if( 0.f == radical )   // There is only one root
+    {
+      num_roots = 1;
+
+      *left = tt.centerx + ( bb / -tt.twoA );
+      *right = *left;
+    }
+  else
+    {
+      num_roots = 0;
+    }
+
+  return num_roots;
+}
+/** ---------------------------------------------------------------------------
+* \fn prepare_exact
+* \description The terms of the quadratic in double precision, and whether
+*     the oval needs them: whether its roots can be off by more than
+*     `exact_limit` pixels in single precision.  The error of a root comes
+*     from rounding the terms of the radical, which is about epsilon times
+*     their size over the width of the chord.  With the chords at least one
+*     pixel wide this is bounded by epsilon times the square of the largest
+*     offset of the middle of a chord, plus the sizes of the c term over a,
+*     which are known from the coefficients without looking at any line.
+---------------------------------------------------------------------------- */
+static const double exact_limit = 1. / 256.;
+
+static inline bool prepare_exact( const ovalRecord& oval, exactTerms *et )
+{
+  double sinT = std::sin( (double) oval.angle );
+  double cosT = std::cos( (double) oval.angle );
+
+  double rx2 = (double) oval.radiusx * oval.radiusx;
+  double ry2 = (double) oval.radiusy * oval.radiusy;
+
+  et->centerx = oval.centerx;
+  et->centery = oval.centery;
+  et->aa = rx2 * sinT * sinT + ry2 * cosT * cosT;
+  et->mid = sinT * cosT * ( ry2 - rx2 );
+  et->slope = rx2 * cosT * cosT + ry2 * sinT * sinT;
+  et->area2 = rx2 * ry2;
+
+  if( not ( 0. < et->aa ) )   // flat, there is nothing to be gained
+    return false;
+
+  double size = ( et->mid * et->mid + et->area2 ) / et->aa + et->slope;
+
+  return exact_limit < 0.5 * FLT_EPSILON * size;
+}
+/** ---------------------------------------------------------------------------
+* \fn solve_exact
+* \description The roots of one oval on the line at yy, in double precision
+*     and with the form of the quadratic formula that does not subtract
+*     nearly equal numbers: q = -( b + sign( b ) sqrt( b^2 - 4ac ) ) / 2,
+*     and the roots are q / a and c / q.
+---------------------------------------------------------------------------- */
+static int solve_exact( const exactTerms& et, float yy, float *left, float *right )
+{
+  double dy = (double) yy - et.centery;
+
+  double bb = 2. * dy * et.mid;
+  double cc = dy * dy * et.slope - et.area2;
+
+  double radical = bb * bb - 4. * et.aa * cc;
+
+  if( radical < 0. )
+    return 0;
+
+  int num_roots = radical == 0. ? 1 : 2;
+  double qq = -0.5 * ( bb + std::copysign( std::sqrt( radical ), bb ) );
+
+  if( qq == 0. )    // b and c are both zero, the line goes through the center of a needle
+    {
+      *left = *right = (float) et.centerx;
+      return num_roots;
+    }
+
+  double one = qq / et.aa;
+  double two = cc / qq;
+
+  *left = (float)( et.centerx + std::min( one, two ) );
+  *right = (float)( et.centerx + std::max( one, two ) );
+
+  return num_roots;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalArrays::ovalArrays
+---------------------------------------------------------------------------- */
+ovalArrays::ovalArrays( std::pmr::memory_resource *memory ) :
+centerx( memory ), centery( memory ), radiusx( memory ), radiusy( memory ), angle( memory ),
+sinT( memory ), cosT( memory ), spread( memory ), slope( memory ), area2( memory ), twoA( memory ), fourA( memory ),
+exact( memory ), exactTerms( memory )
+{
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalArrays::assign
+---------------------------------------------------------------------------- */
+void ovalArrays::assign( const ovalRecord *ol, size_t count )
+{
+  std::pmr::vector< float > *all[] = { & centerx, & centery, & radiusx, & radiusy, & angle,
+                                  & sinT, & cosT, & spread, & slope, & area2, & twoA, & fourA };
+
+  for( auto *one : all )
+    {
+      one->resize( count );
+    }
+
+  exact.resize( count );
+  exactTerms.clear();
+
+  for( size_t ii = 0; ii < count; ii += 1 )
+    {
+      rootTerms tt = prepare_terms( ol[ ii ] );
+
+      centerx[ ii ] = ol[ ii ].centerx;
+      centery[ ii ] = ol[ ii ].centery;
+      radiusx[ ii ] = ol[ ii ].radiusx;
+      radiusy[ ii ] = ol[ ii ].radiusy;
+      angle[ ii ] = ol[ ii ].angle;
+
+      sinT[ ii ] = tt.sinT;
+      cosT[ ii ] = tt.cosT;
+      spread[ ii ] = tt.spread;
+      slope[ ii ] = tt.slope;
+      area2[ ii ] = tt.area2;
+      twoA[ ii ] = tt.twoA;
+      fourA[ ii ] = tt.fourA;
+
+      struct exactTerms et;
+
+      if( prepare_exact( ol[ ii ], & et ) )
+        {
+          exact[ ii ] = (int) exactTerms.size();
+          exactTerms.push_back( et );
+        }
+      else
+        {
+          exact[ ii ] = -1;
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalRoots
+---------------------------------------------------------------------------- */
+int ovalRoots( float xx[ 2 ], float yy, const ovalRecord& oval )
+{
+  exactTerms et;
+
+  if( prepare_exact( oval, & et ) )
+    {
+      return solve_exact( et, yy, & xx[ 0 ], & xx[ 1 ] );
+    }
+
+  return solve_terms( prepare_terms( oval ), yy, & xx[ 0 ], & xx[ 1 ] );
+}
+/** ---------------------------------------------------------------------------
+* \fn batchRoots
+* \description The vector forms gather the terms of the ovals in the batch,
+*   solve for both roots in every lane, and then pick the results by the
+*   sign of the radical.  When the radical is zero the two root formula
+*   gives the same value as the one root formula, so it is used for both.
+---------------------------------------------------------------------------- */
+void batchRoots( const ovalArrays& oa, const int *index, size_t count, float yy,
+                 float *left, float *right, int *roots )
+{
+  size_t ii = 0;
+
+#if defined( KERNELS_AVX2 )
+  const __m256 vy = _mm256_set1_ps( yy );
+  const __m256 two = _mm256_set1_ps( 2.f );
+  const __m256 zero = _mm256_setzero_ps();
+
+  for( ; ii + 8 <= count; ii += 8 )
+    {
+      __m256i idx = _mm256_loadu_si256( (const __m256i *) ( index + ii ) );
+
+      __m256 cx = _mm256_i32gather_ps( oa.centerx.data(), idx, 4 );
+      __m256 cy = _mm256_i32gather_ps( oa.centery.data(), idx, 4 );
+      __m256 st = _mm256_i32gather_ps( oa.sinT.data(), idx, 4 );
+      __m256 ct = _mm256_i32gather_ps( oa.cosT.data(), idx, 4 );
+      __m256 sp = _mm256_i32gather_ps( oa.spread.data(), idx, 4 );
+      __m256 sl = _mm256_i32gather_ps( oa.slope.data(), idx, 4 );
+      __m256 a2 = _mm256_i32gather_ps( oa.area2.data(), idx, 4 );
+      __m256 ta = _mm256_i32gather_ps( oa.twoA.data(), idx, 4 );
+      __m256 fa = _mm256_i32gather_ps( oa.fourA.data(), idx, 4 );
+
+      __m256 dy = _mm256_sub_ps( vy, cy );
+      __m256 bb = _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( two, dy ), st ), ct ), sp );
+      __m256 cc = _mm256_sub_ps( _mm256_mul_ps( _mm256_mul_ps( dy, dy ), sl ), a2 );
+      __m256 radical = _mm256_sub_ps( _mm256_mul_ps( bb, bb ), _mm256_mul_ps( fa, cc ) );
+
+      __m256 sr = _mm256_sqrt_ps( _mm256_max_ps( radical, zero ) );
+
+      __m256 x0 = _mm256_add_ps( cx, _mm256_div_ps( _mm256_sub_ps( _mm256_sub_ps( zero, sr ), bb ), ta ) );
+      __m256 x1 = _mm256_add_ps( cx, _mm256_div_ps( _mm256_sub_ps( sr, bb ), ta ) );
+
+      int positive = _mm256_movemask_ps( _mm256_cmp_ps( zero, radical, _CMP_LT_OQ ) );
+      int single = _mm256_movemask_ps( _mm256_cmp_ps( zero, radical, _CMP_EQ_OQ ) );
+
+      alignas( 32 ) float lo[ 8 ];
+      alignas( 32 ) float hi[ 8 ];
+
+      _mm256_store_ps( lo, x0 );
+      _mm256_store_ps( hi, x1 );
+
+      for( int jj = 0; jj < 8; jj += 1 )
+        {
+          if( positive & ( 1 << jj ) )
+            {
+              roots[ ii + jj ] = 2;
+              left[ ii + jj ] = lo[ jj ];
+              right[ ii + jj ] = hi[ jj ];
+            }
+          else if( single & ( 1 << jj ) )
+            {
+              roots[ ii + jj ] = 1;
+              left[ ii + jj ] = lo[ jj ];
+              right[ ii + jj ] = lo[ jj ];
+            }
+          else
+            {
+              roots[ ii + jj ] = 0;
+            }
+        }
+    }
+#elif defined( KERNELS_SSE2 )
+  const __m128 vy = _mm_set1_ps( yy );
+  const __m128 two = _mm_set1_ps( 2.f );
+  const __m128 zero = _mm_setzero_ps();
+
+  for( ; ii + 4 <= count; ii += 4 )
+    {
+      const int *ix = index + ii;
+
+      auto gather = [ix]( const std::pmr::vector< float >& vv )
+        {
+          return _mm_setr_ps( vv[ ix[ 0 ] ], vv[ ix[ 1 ] ], vv[ ix[ 2 ] ], vv[ ix[ 3 ] ] );
+        };
+
+      __m128 cx = gather( oa.centerx );
+      __m128 cy = gather( oa.centery );
+      __m128 st = gather( oa.sinT );
+      __m128 ct = gather( oa.cosT );
+      __m128 sp = gather( oa.spread );
+      __m128 sl = gather( oa.slope );
+      __m128 a2 = gather( oa.area2 );
+      __m128 ta = gather( oa.twoA );
+      __m128 fa = gather( oa.fourA );
+
+      __m128 dy = _mm_sub_ps( vy, cy );
+      __m128 bb = _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( two, dy ), st ), ct ), sp );
+      __m128 cc = _mm_sub_ps( _mm_mul_ps( _mm_mul_ps( dy, dy ), sl ), a2 );
+      __m128 radical = _mm_sub_ps( _mm_mul_ps( bb, bb ), _mm_mul_ps( fa, cc ) );
+
+      __m128 sr = _mm_sqrt_ps( _mm_max_ps( radical, zero ) );
+
+      __m128 x0 = _mm_add_ps( cx, _mm_div_ps( _mm_sub_ps( _mm_sub_ps( zero, sr ), bb ), ta ) );
+      __m128 x1 = _mm_add_ps( cx, _mm_div_ps( _mm_sub_ps( sr, bb ), ta ) );
+
+      int positive = _mm_movemask_ps( _mm_cmplt_ps( zero, radical ) );
+      int single = _mm_movemask_ps( _mm_cmpeq_ps( zero, radical ) );
+
+      alignas( 16 ) float lo[ 4 ];
+      alignas( 16 ) float hi[ 4 ];
+
+      _mm_store_ps( lo, x0 );
+      _mm_store_ps( hi, x1 );
+
+      for( int jj = 0; jj < 4; jj += 1 )
+        {
+          if( positive & ( 1 << jj ) )
+            {
+              roots[ ii + jj ] = 2;
+              left[ ii + jj ] = lo[ jj ];
+              right[ ii + jj ] = hi[ jj ];
+            }
+          else if( single & ( 1 << jj ) )
+            {
+              roots[ ii + jj ] = 1;
+              left[ ii + jj ] = lo[ jj ];
+              right[ ii + jj ] = lo[ jj ];
+            }
+          else
+            {
+              roots[ ii + jj ] = 0;
+            }
+        }
+    }
+#endif
+
+  for( ; ii < count; ii += 1 )
+    {
+      int jj = index[ ii ];
+
+      rootTerms tt = { oa.centerx[ jj ], oa.centery[ jj ], oa.sinT[ jj ], oa.cosT[ jj ], oa.spread[ jj ],
+                       oa.slope[ jj ], oa.area2[ jj ], oa.twoA[ jj ], oa.fourA[ jj ] };
+
+      roots[ ii ] = solve_terms( tt, yy, & left[ ii ], & right[ ii ] );
+    }
+
+  // Solve the ovals that single precision can't again
+
+  for( ii = 0; not oa.exactTerms.empty() and ii < count; ii += 1 )
+    {
+      int slot = oa.exact[ index[ ii ] ];
+
+      if( 0 <= slot )
+        {
+          roots[ ii ] = solve_exact( oa.exactTerms[ slot ], yy, & left[ ii ], & right[ ii ] );
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn half_extent
+* \description The distance from the center to the side of the bounds, which
+*     is the length of ( one, two ).  The sum is done in double precision,
+*     which is how hypotf is computed for floats, and keeps the scalar and
+*     vector forms the same.
+---------------------------------------------------------------------------- */
+static inline float half_extent( float one, float two )
+{
+  return (float) std::sqrt( (double) one * one + (double) two * two );
+}
+/** ---------------------------------------------------------------------------
+* \fn batchBounds
+* \description The trigonometry is done one oval at a time into a small
+*   chunk of scratch arrays, and the rest of the bounds for the chunk is
+*   done in the vector registers.
+---------------------------------------------------------------------------- */
+void batchBounds( const ovalRecord *ol, size_t count, floatBounds *bounds )
+{
+  alignas( 32 ) float cx[ bounds_chunk ];
+  alignas( 32 ) float cy[ bounds_chunk ];
+  alignas( 32 ) float rx[ bounds_chunk ];
+  alignas( 32 ) float ry[ bounds_chunk ];
+  alignas( 32 ) float st[ bounds_chunk ];
+  alignas( 32 ) float ct[ bounds_chunk ];
+  alignas( 32 ) float hx[ bounds_chunk ];
+  alignas( 32 ) float hy[ bounds_chunk ];
+
+  for( size_t base = 0; base < count; base += bounds_chunk )
+    {
+      size_t nn = std::min( bounds_chunk, count - base );
+
+      for( size_t ii = 0; ii < nn; ii += 1 )
+        {
+          const ovalRecord& oval = ol[ base + ii ];
+
+          cx[ ii ] = oval.centerx;
+          cy[ ii ] = oval.centery;
+          rx[ ii ] = oval.radiusx;
+          ry[ ii ] = oval.radiusy;
+          st[ ii ] = std::sin( oval.angle );
+          ct[ ii ] = std::cos( oval.angle );
+        }
+
+      size_t ii = 0;
+
+#if defined( KERNELS_AVX2 )
+      for( ; ii + 8 <= nn; ii += 8 )
+        {
+          __m256 vrx = _mm256_load_ps( rx + ii );
+          __m256 vry = _mm256_load_ps( ry + ii );
+          __m256 vst = _mm256_load_ps( st + ii );
+          __m256 vct = _mm256_load_ps( ct + ii );
+
+          __m256 cosrx = _mm256_mul_ps( vct, vrx );
+          __m256 sinrx = _mm256_mul_ps( vst, vrx );
+          __m256 cosry = _mm256_mul_ps( vct, vry );
+          __m256 sinry = _mm256_mul_ps( vst, vry );
+
+          auto extent = []( __m256 one, __m256 two )
+            {
+              __m256d lo1 = _mm256_cvtps_pd( _mm256_castps256_ps128( one ) );
+              __m256d hi1 = _mm256_cvtps_pd( _mm256_extractf128_ps( one, 1 ) );
+              __m256d lo2 = _mm256_cvtps_pd( _mm256_castps256_ps128( two ) );
+              __m256d hi2 = _mm256_cvtps_pd( _mm256_extractf128_ps( two, 1 ) );
+
+              __m128 lo = _mm256_cvtpd_ps( _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( lo1, lo1 ),
+                                                                          _mm256_mul_pd( lo2, lo2 ) ) ) );
+              __m128 hi = _mm256_cvtpd_ps( _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( hi1, hi1 ),
+                                                                          _mm256_mul_pd( hi2, hi2 ) ) ) );
+
+              return _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+            };
+
+          _mm256_store_ps( hx + ii, extent( cosrx, sinry ) );
+          _mm256_store_ps( hy + ii, extent( cosry, sinrx ) );
+        }
+#elif defined( KERNELS_SSE2 )
+      for( ; ii + 4 <= nn; ii += 4 )
+        {
+          __m128 vrx = _mm_load_ps( rx + ii );
+          __m128 vry = _mm_load_ps( ry + ii );
+          __m128 vst = _mm_load_ps( st + ii );
+          __m128 vct = _mm_load_ps( ct + ii );
+
+          __m128 cosrx = _mm_mul_ps( vct, vrx );
+          __m128 sinrx = _mm_mul_ps( vst, vrx );
+          __m128 cosry = _mm_mul_ps( vct, vry );
+          __m128 sinry = _mm_mul_ps( vst, vry );
+
+          auto extent = []( __m128 one, __m128 two )
+            {
+              __m128d lo1 = _mm_cvtps_pd( one );
+              __m128d hi1 = _mm_cvtps_pd( _mm_movehl_ps( one, one ) );
+              __m128d lo2 = _mm_cvtps_pd( two );
+              __m128d hi2 = _mm_cvtps_pd( _mm_movehl_ps( two, two ) );
+
+              __m128 lo = _mm_cvtpd_ps( _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( lo1, lo1 ), _mm_mul_pd( lo2, lo2 ) ) ) );
+              __m128 hi = _mm_cvtpd_ps( _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( hi1, hi1 ), _mm_mul_pd( hi2, hi2 ) ) ) );
+
+              return _mm_movelh_ps( lo, hi );
+            };
+
+          _mm_store_ps( hx + ii, extent( cosrx, sinry ) );
+          _mm_store_ps( hy + ii, extent( cosry, sinrx ) );
+        }
+#endif
+
+      for( ; ii < nn; ii += 1 )
+        {
+          hx[ ii ] = half_extent( ct[ ii ] * rx[ ii ], st[ ii ] * ry[ ii ] );
+          hy[ ii ] = half_extent( ct[ ii ] * ry[ ii ], st[ ii ] * rx[ ii ] );
+        }
+
+      for( ii = 0; ii < nn; ii += 1 )
+        {
+          bounds[ base + ii ] = floatBounds{
+              cx[ ii ] - hx[ ii ],
+              cy[ ii ] - hy[ ii ],
+              cx[ ii ] + hx[ ii ],
+              cy[ ii ] + hy[ ii ]
+            };
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn kernelWidth
+---------------------------------------------------------------------------- */
+int kernelWidth()
+{
+#if defined( KERNELS_AVX2 )
+  return 8;
+#elif defined( KERNELS_SSE2 )
+  return 4;
+#else
+  return 1;
+#endif
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalKernels_UnitTests");
+TEST_CASE( "Compute Roots" )
+{
+  ovalRecord oval = {
+    .centerx = 10.f,
+    .centery = 5.f,
+    .radiusx = 3.f,
+    .radiusy = 4.f,
+    .angle = M_PI_4
+  };
+
+  float xx[ 2 ];
+
+  int num_roots = ovalRoots( xx, 6.f, oval );    // above the center
+  CHECK( num_roots == 2 );
+  CHECK( xx[ 0 ] == doctest::Approx(  6.464482f ) );
+  CHECK( xx[ 1 ] == doctest::Approx( 12.975518f ) );
+
+  float dx_above = xx[ 1 ] - xx[ 0 ];
+
+  num_roots = ovalRoots( xx, 4.f, oval );        // below the center
+  CHECK( num_roots == 2 );
+  CHECK( xx[ 0 ] < xx[ 1 ] );
+  CHECK( xx[ 0 ] == doctest::Approx(  7.024482f ) );
+  CHECK( xx[ 1 ] == doctest::Approx( 13.535518f ) );
+
+  float dx_below = xx[ 1 ] - xx[ 0 ];
+
+  // Since we test one line line above and one line below the center of the
+  // oval, we expect the distance between the roots to be the same
+
+  CHECK( ( dx_above - dx_below ) == doctest::Approx( 0.f ) );
+
+  oval.angle = 0.f;   // rest the angle to check for one root
+  num_roots = ovalRoots( xx, 1., oval );
+  CHECK( num_roots == 1 );
+  CHECK( xx[ 0 ] == doctest::Approx( 10.f ) );
+
+  // Test above and below the oval to confirm that no roots can be found there
+
+  num_roots = ovalRoots( xx, 0.f, oval );  // below
+  CHECK( num_roots == 0 );
+
+  num_roots = ovalRoots( xx, 10.f, oval );   // above
+  CHECK( num_roots == 0 );
+}
+TEST_CASE( "Batch Roots Match Scalar" )
+{
+  std::mt19937 gen( 5 );
+  std::uniform_real_distribution< float > pos( 0.f, 100.f );
+  std::uniform_real_distribution< float > radius( 0.f, 30.f );
+  std::uniform_real_distribution< float > angle( -4.f, 4.f );
+
+  std::vector< ovalRecord > ol;
+
+  for( int ii = 0; ii < 1003; ii += 1 )
+    {
+      ol.push_back( { pos( gen ), pos( gen ), radius( gen ), radius( gen ), angle( gen ) } );
+    }
+
+  ol[ 7 ] = { 50.f, 50.f, 5.f, 5.f, 0.f };    // one root at y = 45
+  ol[ 8 ] = { 50.f, 50.f, 5.f, 0.f, 0.f };    // flat
+
+  ovalArrays oa;
+  oa.assign( ol.data(), ol.size() );
+
+  // Every other oval, backwards, so the gathers don't see a simple order
+
+  std::vector< int > index;
+
+  for( int ii = (int) ol.size() - 1; 0 <= ii; ii -= 2 )
+    {
+      index.push_back( ii );
+    }
+
+  index.push_back( 7 );
+
+  std::vector< float > left( index.size() );
+  std::vector< float > right( index.size() );
+  std::vector< int > roots( index.size() );
+
+  int single = 0;
+
+  for( float yy : { 45.f, 50.f, 12.25f, 77.5f } )
+    {
+      batchRoots( oa, index.data(), index.size(), yy, left.data(), right.data(), roots.data() );
+
+      for( size_t ii = 0; ii < index.size(); ii += 1 )
+        {
+          float xx[ 2 ];
+          int nn = ovalRoots( xx, yy, ol[ index[ ii ] ] );
+
+          REQUIRE( roots[ ii ] == nn );
+
+          // The flat oval has a single root of 0 / 0 on every line
+
+          if( 0 < nn and std::isnan( xx[ 0 ] ) )
+            CHECK( std::isnan( left[ ii ] ) );
+          else if( 0 < nn )
+            CHECK( left[ ii ] == xx[ 0 ] );
+
+          if( nn == 2 )
+            CHECK( right[ ii ] == xx[ 1 ] );
+
+          if( nn == 1 and not std::isnan( xx[ 0 ] ) )
+            single += 1;
+        }
+    }
+
+  CHECK( 0 < single );
+}
+TEST_CASE( "Exact Roots" )
+{
+  // A long thin oval at an angle, where the roots in single precision are
+  // off by a good part of a pixel, and a small one that is left alone
+
+  std::vector< ovalRecord > ol = { { 5000.f, 3000.f, 3000.f, 4.f, 0.7f }, { 50.f, 50.f, 20.f, 10.f, 0.3f } };
+
+  ovalArrays oa;
+  oa.assign( ol.data(), ol.size() );
+
+  REQUIRE( oa.exactTerms.size() == 1 );
+  CHECK( oa.exact[ 0 ] == 0 );
+  CHECK( oa.exact[ 1 ] == -1 );
+
+  const ovalRecord& oval = ol[ 0 ];
+
+  long double sinT = std::sin( (long double) oval.angle );
+  long double cosT = std::cos( (long double) oval.angle );
+  long double rx2 = (long double) oval.radiusx * oval.radiusx;
+  long double ry2 = (long double) oval.radiusy * oval.radiusy;
+  long double aa = rx2 * sinT * sinT + ry2 * cosT * cosT;
+
+  int index[ 2 ] = { 0, 1 };
+  double worst = 0.;
+
+  for( float yy = 1200.f; yy < 4800.f; yy += 7.f )
+    {
+      float left[ 2 ], right[ 2 ];
+      int roots[ 2 ];
+
+      batchRoots( oa, index, 2, yy, left, right, roots );
+
+      float xx[ 2 ];
+      REQUIRE( ovalRoots( xx, yy, oval ) == roots[ 0 ] );
+
+      if( roots[ 0 ] < 2 )
+        continue;
+
+      CHECK( xx[ 0 ] == left[ 0 ] );
+      CHECK( xx[ 1 ] == right[ 0 ] );
+
+      long double dy = yy - oval.centery;
+      long double bb = 2 * dy * sinT * cosT * ( ry2 - rx2 );
+      long double cc = dy * dy * ( rx2 * cosT * cosT + ry2 * sinT * sinT ) - rx2 * ry2;
+      long double sr = std::sqrt( bb * bb - 4 * aa * cc );
+
+      long double lo = oval.centerx + ( -bb - sr ) / ( 2 * aa );
+      long double hi = oval.centerx + ( -bb + sr ) / ( 2 * aa );
+
+      worst = std::max( worst, (double) std::max( std::fabs( lo - left[ 0 ] ), std::fabs( hi - right[ 0 ] ) ) );
+    }
+
+  CHECK( worst < 1e-3 );
+}
+TEST_CASE( "Batch Bounds Match Scalar" )
+{
+  std::mt19937 gen( 9 );
+  std::uniform_real_distribution< float > pos( -1000.f, 1000.f );
+  std::uniform_real_distribution< float > radius( 0.f, 300.f );
+  std::uniform_real_distribution< float > angle( -7.f, 7.f );
+
+  std::vector< ovalRecord > ol;
+
+  for( int ii = 0; ii < 531; ii += 1 )
+    {
+      ol.push_back( { pos( gen ), pos( gen ), radius( gen ), radius( gen ), angle( gen ) } );
+    }
+
+  std::vector< floatBounds > bounds( ol.size() );
+
+  batchBounds( ol.data(), ol.size(), bounds.data() );
+
+  for( size_t ii = 0; ii < ol.size(); ii += 1 )
+    {
+      float dx = std::hypot( std::cos( ol[ ii ].angle ) * ol[ ii ].radiusx, std::sin( ol[ ii ].angle ) * ol[ ii ].radiusy );
+      float dy = std::hypot( std::cos( ol[ ii ].angle ) * ol[ ii ].radiusy, std::sin( ol[ ii ].angle ) * ol[ ii ].radiusx );
+
+      floatBounds one;
+      batchBounds( & ol[ ii ], 1, & one );    // the scalar form
+
+      CHECK( bounds[ ii ].left == one.left );
+      CHECK( bounds[ ii ].top == one.top );
+      CHECK( bounds[ ii ].right == one.right );
+      CHECK( bounds[ ii ].bottom == one.bottom );
+
+      CHECK( one.left == doctest::Approx( ol[ ii ].centerx - dx ) );
+      CHECK( one.bottom == doctest::Approx( ol[ ii ].centery + dy ) );
+    }
+}
+TEST_SUITE_END();
+#endif
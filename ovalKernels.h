@@ -0,0 +1,94 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalKernels.h
+ * \description This file contains the batched kernels that compute the
+ *   bounds of many ovals, and where many ovals cross a scanline, at once.
+ *   They are used inside of the rasterizer and are not part of its API.
+---------------------------------------------------------------------------- */
+
+#ifndef OVALKERNELS_H
+#define OVALKERNELS_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// The terms of the quadratic for one oval in double precision
+struct exactTerms
+ {
+  double centerx;
+  double centery;
+  double aa;      /// The x^2 term
+  double mid;     /// sin cos ( ry^2 - rx^2 ), the x^1 term per 2 dy
+  double slope;
+  double area2;
+ };
+
+/** ----------------------------------------------------------------------------
+  \class ovalArrays
+  \description The ovals as a structure of arrays, with the terms of the
+      quadratic that gives the roots of each oval on a line prepared ahead of
+      time.  The trigonometry is done once per oval when the arrays are
+      filled, rather than for every scanline.  The arrays are allocated from
+      the given memory resource.
+---------------------------------------------------------------------------- */
+class ovalArrays
+  {
+    public:
+      explicit ovalArrays( std::pmr::memory_resource *memory = std::pmr::get_default_resource() );
+
+      void assign( const ovalRecord *ol, size_t count );
+
+      size_t size() const { return centerx.size(); }
+
+      std::pmr::vector< float > centerx;
+      std::pmr::vector< float > centery;
+      std::pmr::vector< float > radiusx;
+      std::pmr::vector< float > radiusy;
+      std::pmr::vector< float > angle;
+
+      std::pmr::vector< float > sinT;
+      std::pmr::vector< float > cosT;
+      std::pmr::vector< float > spread;    /// ry^2 - rx^2
+      std::pmr::vector< float > slope;     /// rx^2 cos^2 + ry^2 sin^2, the x^0 term per dy^2
+      std::pmr::vector< float > area2;     /// rx^2 ry^2
+      std::pmr::vector< float > twoA;      /// Twice the x^2 term
+      std::pmr::vector< float > fourA;     /// Four times the x^2 term
+
+      /// The ovals whose roots are found in double precision, since in
+      /// single precision they could be off by more than a small fraction
+      /// of a pixel.  These are large ovals, and large thin ones at an angle.
+      /// For each oval, where its terms are in `exactTerms`, or -1.
+      std::pmr::vector< int > exact;
+      std::pmr::vector< struct exactTerms > exactTerms;
+  };
+
+/// \fn ovalRoots
+/// \description Find where one oval crosses the line at yy.  This is the
+///     scalar form of `batchRoots`, and the two give the same results,
+///     including for the ovals that are solved in double precision.
+/// \returns The number of roots, which are stored in xx from left to right.
+int ovalRoots( float xx[ 2 ], float yy, const ovalRecord& oval );
+
+/// \fn batchRoots
+/// \description Find where each of the given ovals crosses the line at yy.
+/// \param index The positions in the arrays of the ovals to solve for
+/// \param left, right Where the roots are stored.  With one root both are set
+///     to it, with none they are left alone.
+/// \param roots Where the number of roots of each oval is stored
+void batchRoots( const ovalArrays& oa, const int *index, size_t count, float yy,
+                 float *left, float *right, int *roots );
+
+/// \fn batchBounds
+/// \description Compute the bounds of a list of ovals, with the same results
+///     as calling `ovalBounds` on each one.
+void batchBounds( const ovalRecord *ol, size_t count, floatBounds *bounds );
+
+/// \fn kernelWidth
+/// \description The number of ovals that the kernels handle at once: 8 with
+///     AVX2, 4 with SSE2 and 1 without either.
+int kernelWidth();
+
+#endif //OVALKERNELS_H
@@ -0,0 +1,423 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalMaskCache.cpp
+* \description This file contains a cache of the rasterized coverage of
+*   single ovals, so that ovals that only move from one frame to the next
+*   don't have to be rasterized again
+---------------------------------------------------------------------------- */
+
+#include "ovalMaskCache.h"
+#include "ovalStamp.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iso646.h>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include "ovalReference.h"
+#endif
+
+/// What a mask costs besides its runs: the list node, the index entry and
+/// the key, roughly
+static const size_t mask_overhead = 128;
+
+/** ---------------------------------------------------------------------------
+* \fn float_bits
+* \description The bits of a float for hashing, with -0 the same as 0 since
+*     the two compare equal.
+---------------------------------------------------------------------------- */
+static uint32_t float_bits( float value )
+{
+  uint32_t bits = 0;
+
+  if( value != 0.f )
+    {
+      memcpy( & bits, & value, sizeof( bits ) );
+    }
+
+  return bits;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalMaskCache::keyHash::operator()
+---------------------------------------------------------------------------- */
+size_t ovalMaskCache::keyHash::operator()( const maskKey& key ) const
+{
+  uint64_t hh = 1469598103934665603ull;
+
+  for( uint32_t part : { float_bits( key.radiusx ), float_bits( key.radiusy ), float_bits( key.angle ),
+                         (uint32_t) key.phasex, (uint32_t) key.phasey } )
+    {
+      hh = ( hh ^ part ) * 1099511628211ull;
+    }
+
+  return (size_t) hh;
+}
+/** ---------------------------------------------------------------------------
+* \fn push_or_merge
+* \description Add a run to the list, or extend the last run if it has the
+*     same value and ends where this one starts.
+---------------------------------------------------------------------------- */
+static void push_or_merge( std::vector< pixelRun >& rr, const pixelRun& pr )
+{
+  if( 0.f < pr.value )
+    {
+      if( rr.empty() or
+          rr.back().value != pr.value or
+          rr.back().lineY != pr.lineY or
+          rr.back().endX != pr.startX )
+        {
+          rr.push_back( pr );
+        }
+      else
+        {
+          rr.back().endX = pr.endX;
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn combine_line
+* \description Combine the runs of one line, which can overlap, into runs
+*     that don't.  The starts and ends of the runs are swept from left to
+*     right, keeping the values of the runs that cover the current position.
+* \param first, last The runs of the line, sorted by their start
+---------------------------------------------------------------------------- */
+static void combine_line( const pixelRun *first, const pixelRun *last, bool accumulate,
+                          std::vector< std::pair< int, int > >& events, std::vector< float >& active,
+                          std::vector< pixelRun >& rr )
+{
+  // Each run gives a start event with its index + 1 and an end event with
+  // minus that, and at the same x the ends come first
+
+  events.clear();
+
+  for( const pixelRun *pr = first; pr != last; pr += 1 )
+    {
+      int index = (int)( pr - first ) + 1;
+
+      events.push_back( { pr->startX, index } );
+      events.push_back( { pr->endX, -index } );
+    }
+
+  std::sort( events.begin(), events.end() );
+
+  active.clear();
+
+  pixelRun out;
+  out.lineY = first->lineY;
+
+  for( size_t ii = 0; ii < events.size(); )
+    {
+      int xx = events[ ii ].first;
+
+      for( ; ii < events.size() and events[ ii ].first == xx; ii += 1 )
+        {
+          int index = events[ ii ].second;
+          float value = first[ std::abs( index ) - 1 ].value;
+
+          if( 0 < index )
+            active.push_back( value );
+          else
+            active.erase( std::find( active.begin(), active.end(), value ) );
+        }
+
+      if( ii < events.size() and not active.empty() )
+        {
+          float value = 0.f;
+
+          if( accumulate )
+            {
+              for( float one : active )
+                value += one;
+            }
+          else
+            {
+              for( float one : active )
+                value = uniteCoverage( value, std::min( 1.f, one ) );
+            }
+
+          out.startX = xx;
+          out.endX = events[ ii ].first;
+          out.value = value;
+
+          push_or_merge( rr, out );
+        }
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalMaskCache::ovalMaskCache
+---------------------------------------------------------------------------- */
+ovalMaskCache::ovalMaskCache( size_t maxBytes, int phases ) :
+maxBytes_( maxBytes ), phases_( std::max( 1, phases ) ), bytes_( 0 )
+{
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalMaskCache::clear
+---------------------------------------------------------------------------- */
+void ovalMaskCache::clear()
+{
+  lru_.clear();
+  index_.clear();
+  bytes_ = 0;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalMaskCache::evict
+  \description Drop the least recently used masks until the cache is under
+      its limit, always keeping the newest one.
+---------------------------------------------------------------------------- */
+void ovalMaskCache::evict()
+{
+  while( maxBytes_ < bytes_ and 1 < lru_.size() )
+    {
+      const maskRecord& last = lru_.back();
+
+      bytes_ -= last.runs.size() * sizeof( pixelRun ) + mask_overhead;
+      index_.erase( last.key );
+      lru_.pop_back();
+
+      stats_.evictions += 1;
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalMaskCache::find_mask
+  \description Look up a mask, or make it by rasterizing the oval around the
+      center that the key stands for.
+---------------------------------------------------------------------------- */
+const ovalMaskCache::maskRecord& ovalMaskCache::find_mask( const maskKey& key )
+{
+  auto found = index_.find( key );
+
+  if( found != index_.end() )
+    {
+      lru_.splice( lru_.begin(), lru_, found->second );
+
+      stats_.hits += 1;
+      stats_.savedSeconds += found->second->seconds;
+
+      return *found->second;
+    }
+
+  auto start = std::chrono::steady_clock::now();
+
+  ovalRecord shape = { 0.f, 0.f, key.radiusx, key.radiusy, key.angle };
+
+  maskRecord mask;
+  mask.key = key;
+  mask.runs = rasterizeAtPhase( shape, key.phasex, key.phasey, phases_ );
+
+  std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+  mask.seconds = elapsed.count();
+
+  stats_.misses += 1;
+  stats_.maskSeconds += mask.seconds;
+
+  bytes_ += mask.runs.size() * sizeof( pixelRun ) + mask_overhead;
+
+  lru_.push_front( std::move( mask ) );
+  index_[ key ] = lru_.begin();
+
+  evict();
+
+  return lru_.front();
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalMaskCache::rasterize
+  \description Place the mask of each oval at the whole pixel of its center,
+      cut to the rectangle, and then combine the runs that overlap.
+---------------------------------------------------------------------------- */
+std::vector< pixelRun > ovalMaskCache::rasterize( const std::vector< ovalRecord >& ol,
+                                                  int x0, int y0, int x1, int y1, coverageMode coverage )
+{
+  std::vector< pixelRun > placed;
+
+  for( const auto& oval : ol )
+    {
+      floatBounds bb = ovalBounds( oval );
+
+      if( bb.right < x0 or x1 < bb.left or bb.bottom < y0 or y1 < bb.top )
+        continue;
+
+      stampPhase sp = roundToPhase( oval.centerx, oval.centery, phases_ );
+
+      int ix = sp.ix;
+      int iy = sp.iy;
+
+      maskKey key = { oval.radiusx, oval.radiusy, oval.angle, sp.phasex, sp.phasey };
+
+      const maskRecord& mask = find_mask( key );
+
+      auto start = std::chrono::steady_clock::now();
+
+      for( const auto& one : mask.runs )
+        {
+          pixelRun pr = { one.lineY + iy, std::max( one.startX + ix, x0 ), std::min( one.endX + ix, x1 ), one.value };
+
+          if( y0 <= pr.lineY and pr.lineY < y1 and pr.startX < pr.endX )
+            {
+              placed.push_back( pr );
+            }
+        }
+
+      std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+      stats_.combineSeconds += elapsed.count();
+    }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::sort( placed.begin(), placed.end(), []( const pixelRun& one, const pixelRun& two )
+    {
+      return one.lineY < two.lineY or ( one.lineY == two.lineY and one.startX < two.startX );
+    } );
+
+  std::vector< pixelRun > rr;
+  std::vector< std::pair< int, int > > events;
+  std::vector< float > active;
+
+  for( size_t ii = 0; ii < placed.size(); )
+    {
+      size_t jj = ii + 1;
+
+      while( jj < placed.size() and placed[ jj ].lineY == placed[ ii ].lineY )
+        {
+          jj += 1;
+        }
+
+      combine_line( & placed[ ii ], placed.data() + jj, coverage == coverageMode::accumulate, events, active, rr );
+
+      ii = jj;
+    }
+
+  std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+  stats_.combineSeconds += elapsed.count();
+
+  return rr;
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalMaskCache_UnitTests");
+TEST_CASE( "Mask Cache Translation" )
+{
+  std::vector< ovalRecord > ol = { { 20.5f, 15.25f, 7.f, 3.5f, 0.4f } };
+
+  ovalMaskCache cache;
+
+  auto first = cache.rasterize( ol, 0, 0, 100, 100 );
+
+  CHECK( cache.stats().misses == 1 );
+  CHECK( cache.stats().hits == 0 );
+
+  // The center is on a phase, so the mask is the oval itself
+
+  auto expected = ovalListToRaster( ol, 100, 100 );
+  auto err = compareCoverage( runsToCoverage( first, 100, 100 ), runsToCoverage( expected, 100, 100 ) );
+
+  CHECK( err.maxError < 1e-4f );
+
+  // Moving by whole pixels finds the same mask and moves the runs
+
+  ol[ 0 ].centerx += 31.f;
+  ol[ 0 ].centery += 12.f;
+
+  auto moved = cache.rasterize( ol, 0, 0, 100, 100 );
+
+  CHECK( cache.stats().hits == 1 );
+  CHECK( cache.stats().hitRate() == doctest::Approx( 0.5 ) );
+  REQUIRE( moved.size() == first.size() );
+
+  for( size_t ii = 0; ii < moved.size(); ii += 1 )
+    {
+      CHECK( moved[ ii ].lineY == first[ ii ].lineY + 12 );
+      CHECK( moved[ ii ].startX == first[ ii ].startX + 31 );
+      CHECK( moved[ ii ].value == first[ ii ].value );
+    }
+
+  // A center that rounds to the next whole pixel uses the phase 0 mask
+
+  ol[ 0 ].centerx = 40.99f;
+  cache.rasterize( ol, 0, 0, 100, 100 );
+
+  ol[ 0 ].centerx = 41.f;
+  cache.rasterize( ol, 0, 0, 100, 100 );
+
+  CHECK( cache.stats().hits == 2 );
+  CHECK( cache.stats().misses == 2 );
+
+  // Clipped to the rectangle
+
+  for( const auto& one : cache.rasterize( ol, 35, 20, 45, 25 ) )
+    {
+      CHECK( 35 <= one.startX );
+      CHECK( one.endX <= 45 );
+      CHECK( 20 <= one.lineY );
+      CHECK( one.lineY < 25 );
+    }
+}
+TEST_CASE( "Mask Cache Eviction" )
+{
+  ovalMaskCache cache( 4096 );
+
+  for( int ii = 0; ii < 50; ii += 1 )
+    {
+      std::vector< ovalRecord > ol = { { 50.f, 50.f, 5.f + ii, 4.f, 0.f } };
+
+      cache.rasterize( ol, 0, 0, 200, 200 );
+
+      CHECK( cache.bytes() <= 4096 );
+    }
+
+  CHECK( 0 < cache.stats().evictions );
+  CHECK( cache.size() + cache.stats().evictions == 50 );
+
+  // The newest mask is still there, the oldest is gone
+
+  cache.resetStats();
+  cache.rasterize( { { 50.f, 50.f, 54.f, 4.f, 0.f } }, 0, 0, 200, 200 );
+  cache.rasterize( { { 50.f, 50.f, 5.f, 4.f, 0.f } }, 0, 0, 200, 200 );
+
+  CHECK( cache.stats().hits == 1 );
+  CHECK( cache.stats().misses == 1 );
+
+  cache.clear();
+  CHECK( cache.size() == 0 );
+  CHECK( cache.bytes() == 0 );
+}
+TEST_CASE( "Mask Cache Combine" )
+{
+  std::vector< ovalRecord > ol = {
+      { 30.f, 30.f, 12.f, 8.f, 0.3f },
+      { 38.f, 33.f, 10.f, 10.f, 0.f },
+      { 24.f, 45.f, 10.f, 10.f, 0.f },
+    };
+
+  ovalMaskCache cache;
+
+  auto unite = cache.rasterize( ol, 0, 0, 64, 64 );
+  auto sum = cache.rasterize( ol, 0, 0, 64, 64, coverageMode::accumulate );
+
+  CHECK( cache.stats().hits == 4 );   // the moved copy of the second oval and the whole second call
+
+  for( size_t ii = 1; ii < unite.size(); ii += 1 )
+    {
+      CHECK( unite[ ii ].value <= 1.f );
+
+      // The runs don't overlap and are in order
+
+      CHECK( ( unite[ ii - 1 ].lineY < unite[ ii ].lineY or unite[ ii - 1 ].endX <= unite[ ii ].startX ) );
+    }
+
+  auto err = compareCoverage( runsToCoverage( unite, 64, 64 ), referenceCoverage( ol, 64, 64, 8 ) );
+
+  CHECK( err.meanError < 0.01 );
+  CHECK( std::fabs( err.massError ) < 0.01 );
+
+  err = compareCoverage( runsToCoverage( sum, 64, 64 ), referenceCoverage( ol, 64, 64, 8, coverageMode::accumulate ) );
+
+  CHECK( err.meanError < 0.02 );
+  CHECK( std::fabs( err.massError ) < 0.01 );
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,121 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalMaskCache.h
+ * \description This file contains a cache of the rasterized coverage of
+ *   single ovals, so that ovals that only move from one frame to the next
+ *   don't have to be rasterized again
+---------------------------------------------------------------------------- */
+
+#ifndef OVALMASKCACHE_H
+#define OVALMASKCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// What the cache did since it was made or since `resetStats`.  The time a
+/// hit saves is the time it took to make the mask in the first place.
+
+struct maskCacheStats
+ {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+
+  double maskSeconds = 0.;      /// Rasterizing the masks that missed
+  double combineSeconds = 0.;   /// Placing the masks and combining them into runs
+  double savedSeconds = 0.;     /// The time the hits would have taken to rasterize
+
+  double hitRate() const { return 0 < hits + misses ? (double) hits / ( hits + misses ) : 0.; }
+
+  /// How much longer the calls would have taken with every mask rasterized
+  double speedup() const
+  {
+    double spent = maskSeconds + combineSeconds;
+
+    return 0. < spent ? ( spent + savedSeconds ) / spent : 1.;
+  }
+ };
+
+/** ----------------------------------------------------------------------------
+  \class ovalMaskCache
+  \description Rasterizes lists of ovals one oval at a time, keeping the runs
+      of each oval as a mask that is looked up by its radii, its angle and
+      the fraction of a pixel of its center, rounded to 1 / `phases`.  An
+      oval that has moved by whole pixels finds its mask and it is only
+      moved, not rasterized.  Rounding the center moves an oval by at most
+      half of 1 / `phases` of a pixel, which is the price of the hits.
+
+      The masks of overlapping ovals are combined pixel by pixel.  With
+      `unite` this is 1 - ( 1 - a ) * ( 1 - b ), the same approximation of
+      the union that is used for splatted ovals, so pixels on the edges of
+      two ovals differ a little from `ovalListToRaster`, which unites the
+      shapes exactly.  With `accumulate` the values are simply added.
+
+      The least recently used masks are dropped when the masks take more
+      than `maxBytes`.
+---------------------------------------------------------------------------- */
+class ovalMaskCache
+  {
+    public:
+      explicit ovalMaskCache( size_t maxBytes = 64 << 20, int phases = 16 );
+
+      /// Rasterize the ovals into the rectangle ( x0, y0, x1, y1 ).
+      std::vector< pixelRun > rasterize( const std::vector< ovalRecord >& ol, int x0, int y0, int x1, int y1,
+                                         coverageMode coverage = coverageMode::unite );
+
+      const maskCacheStats& stats() const { return stats_; }
+      void resetStats() { stats_ = maskCacheStats(); }
+
+      /// Drop all the masks
+      void clear();
+
+      size_t size() const { return lru_.size(); }
+      size_t bytes() const { return bytes_; }
+
+    private:
+      struct maskKey
+        {
+          float radiusx;
+          float radiusy;
+          float angle;
+          int phasex;
+          int phasey;
+
+          bool operator==( const maskKey& other ) const
+          {
+            return radiusx == other.radiusx and radiusy == other.radiusy and angle == other.angle and
+                   phasex == other.phasex and phasey == other.phasey;
+          }
+        };
+
+      struct keyHash
+        {
+          size_t operator()( const maskKey& key ) const;
+        };
+
+      struct maskRecord
+        {
+          maskKey key;
+          std::vector< pixelRun > runs;   /// Relative to the whole pixel of the center
+          double seconds;                 /// How long the mask took to make
+        };
+
+      const maskRecord& find_mask( const maskKey& key );
+      void evict();
+
+      size_t maxBytes_;
+      int phases_;
+      size_t bytes_;
+
+      std::list< maskRecord > lru_;     /// The most recently used first
+      std::unordered_map< maskKey, std::list< maskRecord >::iterator, keyHash > index_;
+
+      maskCacheStats stats_;
+  };
+
+#endif //OVALMASKCACHE_H
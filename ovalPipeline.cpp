@@ -0,0 +1,392 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalPipeline.cpp
+* \description This file contains the code that rasterizes a sequence of
+*   frames with the preparing, rasterizing and delivering of the frames
+*   overlapped on separate threads
+---------------------------------------------------------------------------- */
+
+#include "ovalPipeline.h"
+#include "ovalTrace.h"
+#include <algorithm>
+#include <iso646.h>
+#include <thread>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include <chrono>
+#include <stdexcept>
+#endif
+
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::ovalPipeline
+---------------------------------------------------------------------------- */
+ovalPipeline::ovalPipeline( int x0, int y0, int x1, int y1 ) :
+x0_( x0 ), y0_( y0 ), x1_( x1 ), y1_( y1 ), maxFrames_( 4 ), stop_( false ),
+produced_( 0 ), delivered_( 0 ), sourceDone_( false )
+{
+  setWorkers( (int) std::thread::hardware_concurrency() - 2 );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::setWorkers
+---------------------------------------------------------------------------- */
+void ovalPipeline::setWorkers( int workers )
+{
+  workers_ = std::max( 1, workers );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::setMaxFrames
+---------------------------------------------------------------------------- */
+void ovalPipeline::setMaxFrames( size_t frames )
+{
+  maxFrames_ = std::max( (size_t) 3, frames );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::cancel
+---------------------------------------------------------------------------- */
+void ovalPipeline::cancel()
+{
+  std::lock_guard< std::mutex > lock( mutex_ );
+
+  stop_ = true;
+  changed_.notify_all();
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::fail
+  \description Keep the first error and stop the other stages.
+---------------------------------------------------------------------------- */
+void ovalPipeline::fail( std::exception_ptr error )
+{
+  std::lock_guard< std::mutex > lock( mutex_ );
+
+  if( not error_ )
+    {
+      error_ = error;
+    }
+
+  stop_ = true;
+  changed_.notify_all();
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::source_loop
+  \description Prepare the frames one after the other.  Before each frame the
+      source waits until there is room for it, which is what holds back the
+      whole pipeline when the sink is slow.
+---------------------------------------------------------------------------- */
+void ovalPipeline::source_loop( const frameSource& source )
+{
+  OVAL_TRACE_THREAD( "pipeline source" );
+
+  for( size_t frame = 0; ; frame += 1 )
+    {
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+
+        changed_.wait( lock, [this] { return stop_ or produced_ - delivered_ < maxFrames_; } );
+
+        if( stop_ )
+          break;
+      }
+
+      frameRecord fr;
+      fr.frame = frame;
+
+      bool more;
+
+      try
+        {
+          OVAL_TRACE_SPAN( span, "source", "pipeline" );
+          OVAL_TRACE_ARG( span, "frame", frame );
+
+          more = source( frame, & fr.ovals );
+        }
+      catch( ... )
+        {
+          fail( std::current_exception() );
+          break;
+        }
+
+      std::lock_guard< std::mutex > lock( mutex_ );
+
+      if( not more )
+        {
+          sourceDone_ = true;
+          changed_.notify_all();
+          break;
+        }
+
+      waiting_.push_back( std::move( fr ) );
+      produced_ += 1;
+      changed_.notify_all();
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::worker_loop
+---------------------------------------------------------------------------- */
+void ovalPipeline::worker_loop()
+{
+  OVAL_TRACE_THREAD( "pipeline worker" );
+
+  rasterOptions options = options_;
+  options.cancel = & stop_;
+  options.rows = nullptr;     // the workers would share one index
+  options.memory = nullptr;   // and one arena
+
+  for(;;)
+    {
+      frameRecord fr;
+
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+
+        changed_.wait( lock, [this] { return stop_ or not waiting_.empty() or sourceDone_; } );
+
+        if( stop_ or waiting_.empty() )
+          break;
+
+        fr = std::move( waiting_.front() );
+        waiting_.pop_front();
+      }
+
+      options.stats = & fr.stats;
+
+      try
+        {
+          OVAL_TRACE_SPAN( span, "frame", "pipeline" );
+          OVAL_TRACE_ARG( span, "frame", fr.frame );
+
+          fr.runs = ovalListToRaster( fr.ovals, x0_, y0_, x1_, y1_, options );
+        }
+      catch( ... )
+        {
+          fail( std::current_exception() );
+          break;
+        }
+
+      fr.ovals = std::vector< ovalRecord >();    // the ovals are not needed any more
+
+      std::lock_guard< std::mutex > lock( mutex_ );
+
+      finished_.push_back( std::move( fr ) );
+      changed_.notify_all();
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::run
+  \description Start the source and the workers, and deliver the frames on
+      this thread as they are finished in order.
+---------------------------------------------------------------------------- */
+size_t ovalPipeline::run( const frameSource& source, const frameSink& sink )
+{
+  stop_ = false;
+  waiting_.clear();
+  finished_.clear();
+  produced_ = 0;
+  delivered_ = 0;
+  sourceDone_ = false;
+  error_ = nullptr;
+
+  std::vector< std::thread > threads;
+
+  threads.emplace_back( [this, &source] { source_loop( source ); } );
+
+  for( int ii = 0; ii < workers_; ii += 1 )
+    {
+      threads.emplace_back( [this] { worker_loop(); } );
+    }
+
+  for(;;)
+    {
+      frameRecord fr;
+
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+
+        auto next = finished_.end();
+
+        changed_.wait( lock, [this, &next]
+          {
+            next = std::find_if( finished_.begin(), finished_.end(),
+                                 [this]( const frameRecord& one ) { return one.frame == delivered_; } );
+
+            return stop_ or next != finished_.end() or ( sourceDone_ and delivered_ == produced_ );
+          } );
+
+        if( stop_ or next == finished_.end() )
+          break;
+
+        fr = std::move( *next );
+        finished_.erase( next );
+      }
+
+      try
+        {
+          OVAL_TRACE_SPAN( span, "sink", "pipeline" );
+          OVAL_TRACE_ARG( span, "frame", fr.frame );
+
+          sink( fr.frame, fr.runs, fr.stats );
+        }
+      catch( ... )
+        {
+          fail( std::current_exception() );
+          break;
+        }
+
+      std::lock_guard< std::mutex > lock( mutex_ );
+
+      delivered_ += 1;
+      changed_.notify_all();
+    }
+
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+
+    stop_ = true;
+    changed_.notify_all();
+  }
+
+  for( auto& one : threads )
+    {
+      one.join();
+    }
+
+  waiting_.clear();
+  finished_.clear();
+
+  if( error_ )
+    {
+      std::rethrow_exception( error_ );
+    }
+
+  return delivered_;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalPipeline::run
+---------------------------------------------------------------------------- */
+size_t ovalPipeline::run( const std::vector< std::vector< ovalRecord > >& frames, const frameSink& sink )
+{
+  return run( [&frames]( size_t frame, std::vector< ovalRecord > *ovals )
+    {
+      if( frames.size() <= frame )
+        return false;
+
+      *ovals = frames[ frame ];
+      return true;
+    }, sink );
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalPipeline_UnitTests");
+TEST_CASE( "Pipeline Order And Results" )
+{
+  std::vector< std::vector< ovalRecord > > frames;
+
+  for( int ii = 0; ii < 20; ii += 1 )
+    {
+      frames.push_back( { { 10.f + ii, 20.f, 8.f + ( ii % 5 ), 4.f, 0.1f * ii } } );
+    }
+
+  ovalPipeline pipe( 0, 0, 64, 40 );
+  pipe.setWorkers( 3 );
+
+  std::vector< size_t > order;
+  bool same = true;
+
+  size_t count = pipe.run( frames, [&]( size_t frame, std::vector< pixelRun >& runs, const rasterStats& stats )
+    {
+      auto expected = ovalListToRaster( frames[ frame ], 64, 40 );
+
+      order.push_back( frame );
+      same = same and runs.size() == expected.size() and stats.runCount == runs.size();
+
+      for( size_t ii = 0; same and ii < runs.size(); ii += 1 )
+        {
+          same = runs[ ii ].lineY == expected[ ii ].lineY and runs[ ii ].startX == expected[ ii ].startX and
+                 runs[ ii ].endX == expected[ ii ].endX and runs[ ii ].value == expected[ ii ].value;
+        }
+    } );
+
+  CHECK( count == 20 );
+  CHECK( same );
+
+  REQUIRE( order.size() == 20 );
+
+  for( size_t ii = 0; ii < order.size(); ii += 1 )
+    {
+      CHECK( order[ ii ] == ii );
+    }
+}
+TEST_CASE( "Pipeline Back Pressure" )
+{
+  ovalPipeline pipe( 0, 0, 32, 32 );
+  pipe.setWorkers( 2 );
+  pipe.setMaxFrames( 3 );
+
+  std::atomic< int > made( 0 );
+  int most = 0;
+
+  auto source = [&]( size_t frame, std::vector< ovalRecord > *ovals )
+    {
+      if( 30 <= frame )
+        return false;
+
+      made += 1;
+      ovals->push_back( { 16.f, 16.f, 10.f, 5.f, 0.f } );
+      return true;
+    };
+
+  size_t count = pipe.run( source, [&]( size_t frame, std::vector< pixelRun >&, const rasterStats& )
+    {
+      // The frames that were made and not yet delivered, including this one
+
+      most = std::max( most, made - (int) frame );
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    } );
+
+  CHECK( count == 30 );
+  CHECK( most <= 3 );
+}
+TEST_CASE( "Pipeline Errors And Cancel" )
+{
+  ovalPipeline pipe( 0, 0, 32, 32 );
+
+  auto source = []( size_t frame, std::vector< ovalRecord > *ovals )
+    {
+      if( frame == 5 )
+        throw std::runtime_error( "bad frame" );
+
+      ovals->push_back( { 16.f, 16.f, 10.f, 5.f, 0.f } );
+      return true;
+    };
+
+  size_t seen = 0;
+
+  CHECK_THROWS( pipe.run( source, [&]( size_t, std::vector< pixelRun >&, const rasterStats& ) { seen += 1; } ) );
+
+  CHECK( seen <= 5 );
+
+  // A sink that cancels the pipeline gets no more frames
+
+  auto endless = []( size_t, std::vector< ovalRecord > *ovals )
+    {
+      ovals->push_back( { 16.f, 16.f, 10.f, 5.f, 0.f } );
+      return true;
+    };
+
+  seen = 0;
+
+  size_t count = pipe.run( endless, [&]( size_t frame, std::vector< pixelRun >&, const rasterStats& )
+    {
+      seen += 1;
+
+      if( frame == 9 )
+        pipe.cancel();
+    } );
+
+  CHECK( seen == 10 );
+  CHECK( count == 10 );
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,111 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalPipeline.h
+ * \description This file contains the code that rasterizes a sequence of
+ *   frames with the preparing, rasterizing and delivering of the frames
+ *   overlapped on separate threads
+---------------------------------------------------------------------------- */
+
+#ifndef OVALPIPELINE_H
+#define OVALPIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/** ----------------------------------------------------------------------------
+  \class ovalPipeline
+  \description Rasterizes frames in three stages that run at the same time:
+      the source prepares frame k+1 on its own thread, the workers
+      rasterize frame k, and the sink is given the runs of frame k-1 on the
+      thread that called `run`.  Frames are delivered in order.  At most
+      `maxFrames` frames are held at once, counting the ones being prepared,
+      waiting, rasterized and not yet delivered, so the source waits when
+      the sink falls behind and the memory used stays bounded.
+
+      If the source or the sink throws, the pipeline stops and `run`
+      throws the same exception once all its threads are done.
+---------------------------------------------------------------------------- */
+class ovalPipeline
+  {
+    public:
+      /// Fill in the ovals of the given frame.  Return false when there are
+      /// no more frames.  This is called on the source thread, one frame
+      /// after the other.
+      using frameSource = std::function< bool( size_t frame, std::vector< ovalRecord > *ovals ) >;
+
+      /// Take the runs of the given frame.  This is called on the thread
+      /// that called `run`, in the order of the frames.
+      using frameSink = std::function< void( size_t frame, std::vector< pixelRun >& runs, const rasterStats& stats ) >;
+
+      /// The frames are rasterized into the rectangle ( x0, y0, x1, y1 ).
+      ovalPipeline( int x0, int y0, int x1, int y1 );
+
+      /// The options for every frame.  The `stats`, `cancel`, `rows` and
+      /// `memory` members are ignored, each frame gets its own stats and
+      /// `cancel` stops a frame.  The workers can't share one arena, so
+      /// each frame allocates for itself.  The sink can index its runs with
+      /// `indexRows`.
+      void setOptions( const rasterOptions& options ) { options_ = options; }
+
+      /// The number of threads that rasterize, at least 1.  The default is
+      /// the number of cores less the source and the sink.
+      void setWorkers( int workers );
+
+      /// The number of frames held at once, at least 3 so that each stage
+      /// can have one.
+      void setMaxFrames( size_t frames );
+
+      /// Rasterize the frames from the source until it has no more, or the
+      /// pipeline is cancelled.
+      /// \returns The number of frames given to the sink
+      size_t run( const frameSource& source, const frameSink& sink );
+
+      /// Rasterize a list of frames.
+      size_t run( const std::vector< std::vector< ovalRecord > >& frames, const frameSink& sink );
+
+      /// Stop a call to `run` from another thread, including the sink.  The
+      /// frames in progress are dropped.
+      void cancel();
+
+    private:
+      struct frameRecord
+        {
+          size_t frame;
+          std::vector< ovalRecord > ovals;
+          std::vector< pixelRun > runs;
+          rasterStats stats;
+        };
+
+      void source_loop( const frameSource& source );
+      void worker_loop();
+      void fail( std::exception_ptr error );
+
+      int x0_;
+      int y0_;
+      int x1_;
+      int y1_;
+      rasterOptions options_;
+      int workers_;
+      size_t maxFrames_;
+
+      std::mutex mutex_;
+      std::condition_variable changed_;
+      std::atomic< bool > stop_;
+
+      std::deque< frameRecord > waiting_;     /// Prepared, in the order they were made
+      std::vector< frameRecord > finished_;   /// Rasterized, in any order
+      size_t produced_;
+      size_t delivered_;
+      bool sourceDone_;
+      std::exception_ptr error_;
+  };
+
+#endif //OVALPIPELINE_H
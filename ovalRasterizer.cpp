@@ -6,32 +6,22 @@
 ---------------------------------------------------------------------------- */
 
 #include "ovalRasterizer.h"
+#include "ovalKernels.h"
+#include "ovalTrace.h"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <iso646.h>
+#include <map>
+#include <memory_resource>
 #include <set>
+#include <stdexcept>
 
 #ifdef TESTING
 #include <doctest/doctest.h>
 #endif
 
-struct floatBounds
-  {
-    float left;
-    float top;
-    float right;
-    float bottom;
-
-    void add( const floatBounds& other )
-    {
-      left = std::min( left, other.left );
-      top = std::min( top, other.top );
-      right = std::max( right, other.right );
-      bottom = std::max( bottom, other.bottom );
-    }
-  };
-
 struct edgeRecord
   {
     int startx;   /// The leftmost position for this edge for the given scanline
@@ -43,7 +33,11 @@ struct edgeRecord
 
     bool operator<( const struct edgeRecord& other ) const
     {
-      return this->startx < other.startx;
+      // When two edges start at the same place, the leading edge goes first so
+      // that a trailing edge is never seen before the leading edge of its oval
+
+      return this->startx < other.startx or
+             ( this->startx == other.startx and edgeType < other.edgeType );
     }
 
     void set_span( float x1, float x2 )
@@ -61,6 +55,74 @@ struct edgeRecord
     }
   };
 
+/// The ovals under the pixels that are being walked.  There are only a few
+/// of them, so they are kept sorted in a vector rather than in a tree, in
+/// the same order as a std::set so that sums over them come out the same.
+/// The vector keeps its room from one scanline to the next.
+
+class ovalSet
+  {
+    public:
+      explicit ovalSet( std::pmr::memory_resource *memory ) : list_( memory ) {}
+
+      void insert( const ovalRecord *oval )
+      {
+        auto at = std::lower_bound( list_.begin(), list_.end(), oval );
+
+        if( at == list_.end() or *at != oval )
+          {
+            list_.insert( at, oval );
+          }
+      }
+
+      void erase( const ovalRecord *oval )
+      {
+        auto at = std::lower_bound( list_.begin(), list_.end(), oval );
+
+        if( at != list_.end() and *at == oval )
+          {
+            list_.erase( at );
+          }
+      }
+
+      void clear() { list_.clear(); }
+      bool empty() const { return list_.empty(); }
+      size_t size() const { return list_.size(); }
+
+      std::pmr::vector< const ovalRecord * >::const_iterator begin() const { return list_.begin(); }
+      std::pmr::vector< const ovalRecord * >::const_iterator end() const { return list_.end(); }
+
+    private:
+      std::pmr::vector< const ovalRecord * > list_;
+  };
+
+struct rootScratch
+  {
+    std::pmr::vector< int > index;         /// The ovals that touch the scanline
+    std::pmr::vector< float > topLeft;     /// Their roots at the top of the scanline
+    std::pmr::vector< float > topRight;
+    std::pmr::vector< int > topCount;
+    std::pmr::vector< float > bottomLeft;  /// Their roots at the bottom of the scanline
+    std::pmr::vector< float > bottomRight;
+    std::pmr::vector< int > bottomCount;
+
+    explicit rootScratch( std::pmr::memory_resource *memory = std::pmr::get_default_resource() ) :
+    index( memory ), topLeft( memory ), topRight( memory ), topCount( memory ),
+    bottomLeft( memory ), bottomRight( memory ), bottomCount( memory )
+    {
+    }
+
+    void resize( size_t count )
+    {
+      topLeft.resize( count );
+      topRight.resize( count );
+      topCount.resize( count );
+      bottomLeft.resize( count );
+      bottomRight.resize( count );
+      bottomCount.resize( count );
+    }
+  };
+
 struct overlapRecord
   {
     int index;
@@ -86,27 +148,23 @@ struct overlapRecord
 
 /** ---------------------------------------------------------------------------
 * \fn computeBounds
-* \description This function compute the bounds of a rotated oval.
+* \description This function compute the bounds of a rotated oval, with the
+*     scalar form of the batched kernel.
 ---------------------------------------------------------------------------- */
 static floatBounds computeBounds( const ovalRecord& oval )
 {
-  float sinT = std::sin( oval.angle );
-  float cosT = std::cos( oval.angle );
-
-  float cosrx = cosT * oval.radiusx;
-  float sinrx = sinT * oval.radiusx;
-  float cosry = cosT * oval.radiusy;
-  float sinry = sinT * oval.radiusy;
+  floatBounds bb;
 
-  float dx = std::hypot( cosrx, sinry );
-  float dy = std::hypot( cosry, sinrx );
+  batchBounds( & oval, 1, & bb );
 
-  return floatBounds{
-      oval.centerx - dx,
-      oval.centery - dy,
-      oval.centerx + dx,
-      oval.centery + dy
-    };
+  return bb;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalBounds
+---------------------------------------------------------------------------- */
+floatBounds ovalBounds( const ovalRecord& oval )
+{
+  return computeBounds( oval );
 }
 /** ---------------------------------------------------------------------------
 * \fn intervals_intersect
@@ -143,55 +201,6 @@ bool computeOverlap( const floatBounds& one, const floatBounds& two, float *area
   return overlap;
 }
 /** ---------------------------------------------------------------------------
-* \fn compute_oval_roots
-* \description Given a value y, this routine will find the places (if any) where
-*     the oval intersects.
----------------------------------------------------------------------------- */
-static int compute_oval_roots( float xx[2], float yy, const ovalRecord& oval )
-{
-  float sinT = sin( oval.angle );
-  float cosT = cos( oval.angle );
-
-  float sin2T = sinT * sinT;
-  float cos2T = cosT * cosT;
-
-  float rx2 = oval.radiusx * oval.radiusx;
-  float ry2 = oval.radiusy * oval.radiusy;
-  float dy = yy - oval.centery;
-
-  float aa = rx2 * sin2T + ry2 * cos2T;
-  float bb = 2.f * dy * sinT * cosT * ( ry2 - rx2 );
-  float cc = dy * dy * ( rx2 * cos2T + ry2 * sin2T ) - rx2 * ry2;
-
-  float radical = bb * bb - 4.f * aa * cc;
-
-  int num_roots;
-
-  // If the radical is positive, then there are two roots
-
-  if( 0.f < radical )
-    {
-      num_roots = 2;
-
-      float sr = sqrt( radical );   // This is always positive
-
-      xx[ 0 ] = oval.centerx + ( ( 0.f - sr - bb ) / ( 2.f * aa ) );
-      xx[ 1 ] = oval.centerx + ( ( sr - bb ) / ( 2.f * aa ) );
-    }
-  else if( 0.f == radical )   // There is only one root
-    {
-      num_roots = 1;
-
-      xx[ 0 ] = oval.centerx + ( bb / ( -2.f * aa ) );
-    }
-  else
-    {
-      num_roots = 0;
-    }
-
-  return num_roots;
-}
-/** ---------------------------------------------------------------------------
 * \fn compute_sdf
 * \description compute the signed distance to an oval.  The distance is positive
 *     if outside, negative if inside
@@ -224,6 +233,29 @@ static float compute_sdf( const ovalRecord *oval, float xx, float yy )
   return rr;
 }
 /** ---------------------------------------------------------------------------
+* \fn ovalContainsPoint
+* \description Rotate the point into the frame of the oval and use the
+*     implicit equation of the ellipse.
+---------------------------------------------------------------------------- */
+bool ovalContainsPoint( const ovalRecord& oval, float xx, float yy )
+{
+  float sinT = std::sin( oval.angle );
+  float cosT = std::cos( oval.angle );
+
+  float dx = xx - oval.centerx;
+  float dy = yy - oval.centery;
+
+  float uu = cosT * dx + sinT * dy;
+  float vv = cosT * dy - sinT * dx;
+
+  // Written without dividing so that flat ovals contain nothing
+
+  float rx2 = oval.radiusx * oval.radiusx;
+  float ry2 = oval.radiusy * oval.radiusy;
+
+  return uu * uu * ry2 + vv * vv * rx2 <= rx2 * ry2 and 0.f < rx2 * ry2;
+}
+/** ---------------------------------------------------------------------------
 * \fn aa_case_1
 ---------------------------------------------------------------------------- */
 static float aa_case_1( float p0, float p1, float p2 )
@@ -308,22 +340,75 @@ static float aa_case_4( float p0, float p1, float p2, float p3, float p4 )
   return rr;
 }
 /** ---------------------------------------------------------------------------
+* \fn aa_from_corners
+* \description Compute the coverage of a pixel from the signed distances at
+*   its corners.  The distance at the center of the pixel (p4) is only used
+*   when all the corners are on the same side of the edge.
+---------------------------------------------------------------------------- */
+static float aa_from_corners( float p0, float p1, float p2, float p3, float p4 )
+{
+  //    p0 --- p2
+  //    |   p4  |
+  //    p1 --- p3
+
+  int which = 0x0;
+
+  if( p0 < 0.f ) which |= 0x01;
+  if( p1 < 0.f ) which |= 0x02;
+  if( p2 < 0.f ) which |= 0x04;
+  if( p3 < 0.f ) which |= 0x08;
+
+  // There are 16 possibilities that map to four distinct cases
+
+  float rr = 0.f;
+
+  switch( which )
+    {
+      case 0x0:  rr = aa_case_4( p0, p1, p2, p3, p4 );  break;
+      case 0x1:  rr = aa_case_1( p0, p1, p2 );  break;
+      case 0x2:  rr = aa_case_1( p1, p3, p0 );  break;
+      case 0x3:  rr = aa_case_2( p0, p1, p2, p3 );  break;
+      case 0x4:  rr = aa_case_1( p2, p0, p3 );  break;
+      case 0x5:  rr = aa_case_2( p2, p0, p3, p1 );  break;
+      case 0x6:  rr = aa_case_3( p0, p1, p2, p3 );  break;
+      case 0x7:  rr = 1.f - aa_case_1( -p3, -p2, -p1 ); break;
+      case 0x8:  rr = aa_case_1( p3, p2, p1 );  break;
+      case 0x9:  rr = aa_case_3( p1, p3, p0, p2 );  break;
+      case 0xA:  rr = aa_case_2( p1, p3, p0, p2 );  break;
+      case 0xB:  rr = 1.f - aa_case_1( -p2, -p0, -p3 ); break;
+      case 0xC:  rr = aa_case_2( p3, p2, p1, p0 );  break;
+      case 0xD:  rr = 1.f - aa_case_1( -p1, -p3, -p0 ); break;
+      case 0xE:  rr = 1.f - aa_case_1( -p0, -p1, -p2 ); break;
+      case 0xF:  rr = 1.f - aa_case_4( -p0, -p1, -p2, -p3, -p4 );  break;
+    }
+
+  return rr;
+}
+/** ---------------------------------------------------------------------------
+* \fn corners_agree
+* \description Whether all the corners are on the same side of the edge, in
+*   which case the distance at the center of the pixel is needed.
+---------------------------------------------------------------------------- */
+static bool corners_agree( float p0, float p1, float p2, float p3 )
+{
+  bool inside = p0 < 0.f;
+
+  return ( p1 < 0.f ) == inside and ( p2 < 0.f ) == inside and ( p3 < 0.f ) == inside;
+}
+/** ---------------------------------------------------------------------------
 * \fn compute_aa_pixel
 * \description Given one or more ovals, compute the contribution.  The approach
 *   here is to compute the signed distance for each oval at each corner and
 *   then handle each case.
 ---------------------------------------------------------------------------- */
-static float compute_aa_pixel( const std::set< const ovalRecord*>& aalist, float xx, float yy )
+static float compute_aa_pixel( const ovalSet& aalist, float xx, float yy )
 {
   float farr = hypot( (*aalist.begin())->radiusx, (*aalist.begin())->radiusy );
   float p0 = farr;
   float p1 = farr;
   float p2 = farr;
   float p3 = farr;
-
-  //    p0 --- p2
-  //    |   p4  |
-  //    p1 --- p3
+  float p4 = farr;    // only if needed
 
   for( const auto& one : aalist )
     {
@@ -333,377 +418,1498 @@ static float compute_aa_pixel( const std::set< const ovalRecord*>& aalist, float
       p3 = std::min( p3, compute_sdf( one, xx + 1.f, yy + 1.f ) );
     }
 
-  int which = 0x0;
-
-  if( p0 < 0.f ) which |= 0x01;
-  if( p1 < 0.f ) which |= 0x02;
-  if( p2 < 0.f ) which |= 0x04;
-  if( p3 < 0.f ) which |= 0x08;
-
-  // There are 16 possibilities that map to four distinct cases
-
-  float rr = 0.f;
-
-  if( which == 0x0 or which == 0xF )
+  if( corners_agree( p0, p1, p2, p3 ) )
     {
-      float p4 = farr;    // only if needed
-
       for( const auto& one : aalist )
         {
           p4 = std::min( p4, compute_sdf( one, xx + 0.5f, yy + 0.5f ) );
         }
+    }
 
-      if( which == 0x0 )
-        {
-          rr = aa_case_4( p0, p1, p2, p3, p4 );
-        }
-      else
-        {
-          rr = 1.f - aa_case_4( -p0, -p1, -p2, -p3, -p4 );
-        }
+  return aa_from_corners( p0, p1, p2, p3, p4 );
+}
+/** ---------------------------------------------------------------------------
+* \fn compute_aa_pixel
+* \description Same as above for a single oval, with the same results as a
+*   list that holds only this oval.
+---------------------------------------------------------------------------- */
+static float compute_aa_pixel( const ovalRecord *oval, float xx, float yy )
+{
+  float farr = hypot( oval->radiusx, oval->radiusy );
+  float p0 = std::min( farr, compute_sdf( oval, xx, yy ) );
+  float p1 = std::min( farr, compute_sdf( oval, xx, yy + 1.f ) );
+  float p2 = std::min( farr, compute_sdf( oval, xx + 1.f, yy ) );
+  float p3 = std::min( farr, compute_sdf( oval, xx + 1.f, yy + 1.f ) );
+  float p4 = farr;
+
+  if( corners_agree( p0, p1, p2, p3 ) )
+    {
+      p4 = std::min( farr, compute_sdf( oval, xx + 0.5f, yy + 0.5f ) );
     }
-  else
+
+  return aa_from_corners( p0, p1, p2, p3, p4 );
+}
+/** ---------------------------------------------------------------------------
+* \fn count_centers_inside
+* \description Count the ovals that contain the center of the pixel, which is
+*   the coverage of the pixel when there is no anti-aliasing.
+---------------------------------------------------------------------------- */
+static int count_centers_inside( const ovalSet& aalist, float xx, float yy )
+{
+  int count = 0;
+
+  for( const auto& one : aalist )
     {
-      switch( which )
+      if( compute_sdf( one, xx + 0.5f, yy + 0.5f ) < 0.f )
         {
-          case 0x1:  rr = aa_case_1( p0, p1, p2 );  break;
-          case 0x2:  rr = aa_case_1( p1, p3, p0 );  break;
-          case 0x3:  rr = aa_case_2( p0, p1, p2, p3 );  break;
-          case 0x4:  rr = aa_case_1( p2, p0, p3 );  break;
-          case 0x5:  rr = aa_case_2( p2, p0, p3, p1 );  break;
-          case 0x6:  rr = aa_case_3( p0, p1, p2, p3 );  break;
-          case 0x7:  rr = 1.f - aa_case_1( -p3, -p2, -p1 ); break;
-          case 0x8:  rr = aa_case_1( p3, p2, p1 );  break;
-          case 0x9:  rr = aa_case_3( p1, p3, p0, p2 );  break;
-          case 0xA:  rr = aa_case_2( p1, p3, p0, p2 );  break;
-          case 0xB:  rr = 1.f - aa_case_1( -p2, -p0, -p3 ); break;
-          case 0xC:  rr = aa_case_2( p3, p2, p1, p0 );  break;
-          case 0xD:  rr = 1.f - aa_case_1( -p1, -p3, -p0 ); break;
-          case 0xE:  rr = 1.f - aa_case_1( -p0, -p1, -p2 ); break;
+          count += 1;
         }
     }
 
-
-  return rr;
+  return count;
 }
 /** ---------------------------------------------------------------------------
 * \fn computeEdgeList
 * \description For a given scan line value (scanY) find all intersecting ovals
 *     and create an edgelist that can be scanned.
+*     The ovals that touch the scanline are collected first, and the roots
+*     at the top and bottom of the scanline are found for all of them at once.
 * \param scanY The vertical position of the scanline for which to return
 *     the edge list.
 * \param ol The list of oval that are being rasterized
+* \param oa The same ovals, prepared for the batched root kernel
 * \param blist The list of bounding boxes for the corresponding list of ovals
 * \param bounds The union of all the bounds for all the ovals in the list
+* \param scratch Space for the roots, kept from one scanline to the next
 * \param edgeList A place to return the edges that intersect the given Y coordinate
 * \returns An integer that specifies the next scanline that will contain
 *   an edge.
 ---------------------------------------------------------------------------- */
-static int computeEdgeList( int scanY,
-                            const std::vector<ovalRecord>& ol,
-                            const std::vector<floatBounds>& blist,
-                            const floatBounds& bounds,
-                            std::vector<edgeRecord> *edgeList )
+static int computeEdgeList( int scanY,
+                            const ovalRecord *ol,
+                            const ovalArrays& oa,
+                            const std::pmr::vector<floatBounds>& blist,
+                            const floatBounds& bounds,
+                            rootScratch& scratch,
+                            std::pmr::vector<edgeRecord> *edgeList )
+{
+  float topY = scanY;
+  float bottomY = topY + 1.f;
+
+  float nextY = bounds.bottom;
+
+  scratch.index.clear();
+
+  for( int ii = 0; ii < blist.size(); ii += 1 )
+    {
+      if( intervals_intersect( blist[ ii ].top, blist[ ii ].bottom, topY, bottomY ) )
+        {
+          scratch.index.push_back( ii );
+        }
+      else  // this interval does not intersect the current line
+        {
+          if( topY <= blist[ ii ].top and blist[ ii ].top < nextY )
+            {
+              nextY = blist[ ii ].top;
+            }
+        }
+    }
+
+  size_t count = scratch.index.size();
+
+  scratch.resize( count );
+
+  batchRoots( oa, scratch.index.data(), count, topY,
+              scratch.topLeft.data(), scratch.topRight.data(), scratch.topCount.data() );
+  batchRoots( oa, scratch.index.data(), count, bottomY,
+              scratch.bottomLeft.data(), scratch.bottomRight.data(), scratch.bottomCount.data() );
+
+  for( size_t kk = 0; kk < count; kk += 1 )
+    {
+      int ii = scratch.index[ kk ];
+
+      float topx[ 2 ] = { scratch.topLeft[ kk ], scratch.topRight[ kk ] };
+      float botx[ 2 ] = { scratch.bottomLeft[ kk ], scratch.bottomRight[ kk ] };
+
+      int num_top = scratch.topCount[ kk ];
+      int num_bottom = scratch.bottomCount[ kk ];
+
+      if( num_top == 2 and num_bottom == 2 )   // the most common case
+        {
+          edgeRecord er1, er2;
+
+          er1.set_span( topx[ 0 ], botx[ 0 ] );
+          er2.set_span( topx[ 1 ], botx[ 1 ] );
+
+          er1.edgeType = edgeRecord::leading;
+          er2.edgeType = edgeRecord::trailing;
+          er1.oval = & ol[ ii ];
+          er2.oval = & ol[ ii ];
+
+          edgeList->push_back( er1 );
+          edgeList->push_back( er2 );
+        }
+      else if( num_top == 2 )   // num_bottom is either zero or one
+        {
+          float lowx;
+
+          if( num_bottom == 1 )
+            lowx = botx[ 0 ];
+          else
+            lowx = 0.5f * ( topx[ 0 ] + topx[ 1 ] );
+
+          edgeList->push_back( {
+            (int) std::floor( topx[ 0 ] ),
+            (int) std::ceil( lowx ),
+            edgeRecord::leading,
+            & ol[ ii ]
+          });
+
+          edgeList->push_back( {
+            (int) std::floor( lowx ),
+            (int) std::ceil( topx[ 1 ] ),
+            edgeRecord::trailing,
+            & ol[ ii ]
+          });
+        }
+      else if( num_bottom == 2 )   // then num_top is either zero or one
+        {
+          float hix;
+
+          if( num_top == 1 )
+            hix = topx[ 0 ];
+          else
+            hix = 0.5f * ( botx[ 0 ] + botx[ 1 ] );
+
+          edgeList->push_back( {
+            (int) std::floor( botx[ 0 ] ),
+            (int) std::ceil( hix ),
+            edgeRecord::leading,
+            & ol[ ii ]
+          });
+
+          edgeList->push_back( {
+            (int) std::floor( hix ),
+            (int) std::ceil( botx[ 1 ] ),
+            edgeRecord::trailing,
+            & ol[ ii ]
+          });
+        }
+      else  // The remaining cases are all pathological - we use the bounds
+        {
+          if( topY < blist[ ii ].bottom and blist[ ii ].top < bottomY )
+            {
+              float midx;
+
+              if( num_top == 1 )
+                midx = topx[ 0 ];
+              else
+                midx = 0.5f * (blist[ ii ].left + blist[ ii ].right);
+
+              edgeList->push_back( {
+                  (int) std::floor( blist[ ii ].left ),
+                  (int) std::ceil( midx ),
+                  edgeRecord::leading,
+                  &ol[ ii ]
+                } );
+
+              if( num_bottom == 1 )
+                midx = botx[ 0 ];
+              else
+                midx = 0.5f * (blist[ ii ].left + blist[ ii ].right);
+
+              edgeList->push_back( {
+                  (int) std::floor( midx ),
+                  (int) std::ceil( blist[ ii ].right ),
+                  edgeRecord::trailing,
+                  &ol[ ii ]
+                } );
+            }
+          else
+            {
+              nextY = bottomY;
+            }
+        }
+    }
+
+  int next_scanY;
+
+  if( not edgeList->empty() )
+    {
+      next_scanY = scanY + 1;
+    }
+  else  // the edgelist is empty, nothing intersected our span
+    {
+      next_scanY = std::max( (int) std::floor( nextY ), scanY + 1 );;
+    }
+
+  return next_scanY;
+}
+/** ---------------------------------------------------------------------------
+* \fn extend_or_push
+---------------------------------------------------------------------------- */
+template< class runList >
+static void push_or_merge_run( runList& rr, const pixelRun& pr )
+{
+  if( 0.f < pr.value )
+    {
+      if( rr.empty() or
+          rr.back().value != pr.value or
+          rr.back().lineY != pr.lineY or
+          rr.back().endX != pr.startX )
+        {
+          rr.push_back( pr );
+        }
+      else
+        {
+          rr.back().endX = pr.endX;
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn rasterizeScanline
+* \description Walk the edges for one scanline from left to right and emit
+*     the solid and anti-aliased runs.
+* \param scanY The scanline that the edge list was computed for
+* \param edgeList The edges that intersect the scanline, sorted
+* \param left_edge The left side of the frame buffer
+* \param right_edge The right side of the frame buffer
+* \param accumulate Sum the coverage of the ovals rather than unite it
+* \param antialias Compute the coverage of the edge pixels, rather than
+*     only testing their center
+* \param aalist, xxlist Empty sets for the ovals of the anti-aliased pixels
+*     and the ovals that we're inside of, which are left empty
+* \param rr The list where the runs are added
+* \returns The number of pixels whose coverage was computed
+---------------------------------------------------------------------------- */
+template< class runList >
+static int rasterizeScanline( int scanY,
+                              std::pmr::vector<edgeRecord>& edgeList,
+                              int left_edge,
+                              int right_edge,
+                              bool accumulate,
+                              bool antialias,
+                              ovalSet& aalist,
+                              ovalSet& xxlist,
+                              runList& rr )
+{
+  pixelRun pr;
+  pr.lineY = scanY;
+
+  int aa_count = 0;
+
+  pr.startX = std::max( left_edge, edgeList[ 0 ].startx );
+
+  if( pr.startX < right_edge )
+    {
+      do
+        {
+          pr.endX = right_edge;  // assume that we're going to the edge
+
+          int aa_end = right_edge;   // where the first active section ends
+
+          // For each value of x, we need to go through the list of edges
+          // and collect the oval edges that would need to be evaluated there
+
+          for( const auto& edge : edgeList )
+            {
+              if( edge.startx <= pr.startX ) // the edge is to left or at us
+                {
+                  if( edge.edgeType == edgeRecord::leading )
+                    {
+                      if( pr.startX < edge.endx ) // we're inside the edge
+                        {
+                          aalist.insert( edge.oval );
+                          aa_end = std::min( aa_end, edge.endx );
+                        }
+                      else  // we're completely to the right of this edge
+                        {
+                          xxlist.insert( edge.oval );
+                        }
+                    }
+                  else //  edge.Type == edgeRecord::trailing
+                    {
+                      xxlist.erase( edge.oval );    // this ends the solid run
+
+                      if( pr.startX < edge.endx )   // we're in the active section
+                        {
+                          aalist.insert( edge.oval );
+                          aa_end = std::min( aa_end, edge.endx );
+                        }
+                    }
+                }
+              else  // this edge starts is beyond our current scan point - done with this run
+                {
+                  // signal for the next run to begin at the start of the next edge
+
+                  pr.endX = std::min( edge.startx, right_edge );
+                  break;
+                }
+            }
+
+          if( aalist.empty() )
+            {
+              if( not xxlist.empty() )
+                {
+                  pr.value = accumulate ? (float) xxlist.size() : 1.f;   // a solid run
+                  push_or_merge_run( rr, pr );
+                }
+            }
+          else // we might need to anti-alias an edge
+            {
+              // The lists stay the same up to the next edge or the end of
+              // an active section, so the pixels up to there are done at once
+
+              pr.endX = std::min( pr.endX, aa_end );
+
+              int span_end = pr.endX;
+
+              if( not antialias )
+                {
+                  for( ; pr.startX < span_end; pr.startX += 1 )
+                    {
+                      int count = (int) xxlist.size();
+
+                      if( accumulate or count == 0 )
+                        {
+                          count += count_centers_inside( aalist, pr.startX, pr.lineY );
+                        }
+
+                      pr.endX = pr.startX + 1;
+                      pr.value = accumulate ? (float) count : ( 0 < count ? 1.f : 0.f );
+                      push_or_merge_run( rr, pr );
+                      aa_count += 1;
+                    }
+                }
+              else if( accumulate )  // every oval adds its own coverage to the ones we're inside of
+                {
+                  for( ; pr.startX < span_end; pr.startX += 1 )
+                    {
+                      pr.endX = pr.startX + 1;
+                      pr.value = (float) xxlist.size();
+
+                      for( const auto& one : aalist )
+                        {
+                          pr.value += compute_aa_pixel( one, pr.startX, pr.lineY );
+                        }
+
+                      push_or_merge_run( rr, pr );
+                      aa_count += 1;
+                    }
+                }
+              else if( xxlist.empty() )
+                {
+                  for( ; pr.startX < span_end; pr.startX += 1 )
+                    {
+                      pr.endX = pr.startX + 1;
+                      pr.value = compute_aa_pixel( aalist, pr.startX, pr.lineY );
+                      push_or_merge_run( rr, pr );
+                      aa_count += 1;
+                    }
+                }
+              else  // we're a partial edge that is completely inside of another oval
+                {
+                  pr.value = 1.f;
+                  push_or_merge_run( rr, pr );
+                }
+
+              pr.endX = span_end;
+              aalist.clear();
+            }
+
+          xxlist.clear();
+          pr.startX = pr.endX;
+
+        }  while( pr.startX < right_edge );
+    }
+
+  return aa_count;
+}
+/** ---------------------------------------------------------------------------
+* \class sweepTrace
+* \description Records the sweep as one span per band of `trace_band`
+*     scanlines, with the time that went into the edge lists, sorting them
+*     and making the runs added up over the band.  A span per scanline would
+*     cost more than most scanlines.  Without OVAL_TRACE it does nothing.
+---------------------------------------------------------------------------- */
+#ifdef OVAL_TRACE
+static const int trace_band = 64;
+
+struct sweepTrace
+ {
+  enum phase { edges, sorting, runs };
+
+  bool recording = traceEnabled();
+  int firstY = 0;
+  int lines = 0;
+  size_t edgeCount = 0;
+  size_t aaPixelCount = 0;
+  double seconds[ 3 ] = { 0., 0., 0. };
+  traceClock::time_point begin;
+  traceClock::time_point last;
+
+  ~sweepTrace() { flush(); }
+
+  void start( int scanY )
+  {
+    if( recording )
+      {
+        last = traceClock::now();
+
+        if( lines == 0 )
+          {
+            begin = last;
+            firstY = scanY;
+          }
+      }
+  }
+
+  void lap( phase pp )
+  {
+    if( recording )
+      {
+        auto now = traceClock::now();
+        seconds[ pp ] += std::chrono::duration< double >( now - last ).count();
+        last = now;
+      }
+  }
+
+  void line( int scanY, size_t edges, int aa_count )
+  {
+    if( recording )
+      {
+        lines += 1;
+        edgeCount += edges;
+        aaPixelCount += aa_count;
+
+        if( firstY + trace_band <= scanY + 1 )
+          flush();
+      }
+  }
+
+  void flush()
+  {
+    if( recording and 0 < lines )
+      {
+        traceArg args[] = {
+          { "firstY", (double) firstY }, { "lines", (double) lines },
+          { "edges", (double) edgeCount }, { "aaPixels", (double) aaPixelCount },
+          { "edgeListMs", 1e3 * seconds[ edges ] }, { "sortMs", 1e3 * seconds[ sorting ] },
+          { "runsMs", 1e3 * seconds[ runs ] } };
+
+        traceComplete( "band", "sweep", begin, last, args, sizeof( args ) / sizeof( args[ 0 ] ) );
+
+        lines = 0;
+        edgeCount = 0;
+        aaPixelCount = 0;
+        seconds[ 0 ] = seconds[ 1 ] = seconds[ 2 ] = 0.;
+      }
+  }
+ };
+#else
+struct sweepTrace
+ {
+  enum phase { edges, sorting, runs };
+
+  void start( int ) {}
+  void lap( phase ) {}
+  void line( int, size_t, int ) {}
+ };
+#endif
+/** ---------------------------------------------------------------------------
+* \fn rasterizeRows
+* \description Rasterize the scanlines from topY up to (but not including)
+*     endY.  Scanlines that no oval touches are skipped.
+* \param ol The list of ovals that are being rasterized
+* \param blist The list of bounding boxes for the corresponding list of ovals
+* \param bounds The union of all the bounds for all the ovals in the list
+* \param options How the ovals are combined, whether to stop early and where
+*     the memory comes from
+* \param rr The list where the runs are added
+---------------------------------------------------------------------------- */
+template< class runList >
+static void rasterizeRows( const ovalRecord *ol,
+                           const std::pmr::vector<floatBounds>& blist,
+                           const floatBounds& bounds,
+                           int topY,
+                           int endY,
+                           int left_edge,
+                           int right_edge,
+                           const rasterOptions& options,
+                           runList& rr )
+{
+  int scanY = topY;
+  bool accumulate = options.coverage == coverageMode::accumulate;
+  rasterStats *stats = options.stats;
+  rowIndex *rows = options.rows;
+  std::pmr::memory_resource *memory = options.memory ? options.memory : std::pmr::get_default_resource();
+
+  std::pmr::vector<edgeRecord> edgeList( memory );
+  rootScratch scratch( memory );
+  ovalArrays oa( memory );
+  ovalSet aalist( memory );    // for anti-aliased pixels
+  ovalSet xxlist( memory );    // to track inside/outside
+
+  if( scanY < endY )
+    {
+      oa.assign( ol, blist.size() );
+
+      if( stats )
+        {
+          stats->exactOvalCount += oa.exactTerms.size();
+        }
+
+      sweepTrace trace;
+
+      for(;;)
+        {
+          trace.start( scanY );
+
+          // For the given scanline find all the edges that are relevant
+          int nextY = computeEdgeList( scanY, ol, oa, blist, bounds, scratch, &edgeList );
+
+          trace.lap( sweepTrace::edges );
+
+          if( rows )    // the lines up to this one start where the list ends now
+            {
+              rows->rowStart.resize( scanY - rows->firstY + 1, rr.size() );
+            }
+
+          if( not edgeList.empty() )
+            {
+              std::sort( edgeList.begin(), edgeList.end() );
+
+              trace.lap( sweepTrace::sorting );
+
+              int aa_count = rasterizeScanline( scanY, edgeList, left_edge, right_edge, accumulate, options.antialias,
+                                                aalist, xxlist, rr );
+
+              trace.lap( sweepTrace::runs );
+              trace.line( scanY, edgeList.size(), aa_count );
+
+              if( stats )
+                {
+                  stats->scanlineCount += 1;
+                  stats->edgeCount += edgeList.size();
+                  stats->aaPixelCount += aa_count;
+                }
+            }
+
+          if( options.cancel and options.cancel->load( std::memory_order_relaxed ) )
+            {
+              break;
+            }
+
+          if( nextY < endY )
+            {
+              scanY = nextY;
+              edgeList.resize( 0 );
+            }
+          else break;
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn combine_coverage
+* \description Combine the coverage of a splatted oval with a pixel.  The
+*     union is approximated with uniteCoverage, since splatted ovals don't
+*     take part in the sweep.
+---------------------------------------------------------------------------- */
+static float combine_coverage( float one, float two, bool accumulate )
+{
+  return accumulate ? one + two : uniteCoverage( one, two );
+}
+/** ---------------------------------------------------------------------------
+* \fn splat_oval
+* \description Spread the area of a tiny oval over the pixels that it
+*     touches.  The footprint is a box with the aspect ratio of the bounds of
+*     the oval, scaled so that its area is the area of the oval, and each
+*     pixel gets the area of the box that falls inside of it.
+* \param samples The list where one single pixel run is added per pixel
+---------------------------------------------------------------------------- */
+template< class pixelList >
+static void splat_oval( const ovalRecord& oval, const floatBounds& bb,
+                        int x0, int y0, int x1, int y1,
+                        pixelList& samples )
+{
+  float bw = bb.right - bb.left;
+  float bh = bb.bottom - bb.top;
+  float area = (float) M_PI * oval.radiusx * oval.radiusy;
+
+  if( 0.f < area and 0.f < bw * bh )
+    {
+      float kk = std::sqrt( area / ( bw * bh ) );
+
+      float left = oval.centerx - 0.5f * kk * bw;
+      float right = oval.centerx + 0.5f * kk * bw;
+      float top = oval.centery - 0.5f * kk * bh;
+      float bottom = oval.centery + 0.5f * kk * bh;
+
+      int ybeg = std::max( y0, (int) std::floor( top ) );
+      int yend = std::min( y1, (int) std::ceil( bottom ) );
+      int xbeg = std::max( x0, (int) std::floor( left ) );
+      int xend = std::min( x1, (int) std::ceil( right ) );
+
+      for( int yy = ybeg; yy < yend; yy += 1 )
+        {
+          float cover_y = std::min( bottom, yy + 1.f ) - std::max( top, (float) yy );
+
+          for( int xx = xbeg; xx < xend; xx += 1 )
+            {
+              float cover_x = std::min( right, xx + 1.f ) - std::max( left, (float) xx );
+
+              if( 0.f < cover_x * cover_y )
+                {
+                  samples.push_back( { yy, xx, xx + 1, std::min( 1.f, cover_x * cover_y ) } );
+                }
+            }
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn clip_segment
+* \description Narrow the range [ *t0, *t1 ] of the segment a + t d to where
+*     it is between lo and hi.
+* \returns Whether any of the segment is left
+---------------------------------------------------------------------------- */
+static bool clip_segment( double aa, double dd, int lo, int hi, double *t0, double *t1 )
+{
+  if( dd == 0. )
+    return lo <= aa and aa <= hi;
+
+  double s0 = ( lo - aa ) / dd;
+  double s1 = ( hi - aa ) / dd;
+
+  if( s1 < s0 )
+    std::swap( s0, s1 );
+
+  *t0 = std::max( *t0, s0 );
+  *t1 = std::min( *t1, s1 );
+
+  return *t0 < *t1;
+}
+/** ---------------------------------------------------------------------------
+* \fn walk_segment
+* \description Give each pixel that the segment from ( ax, ay ) to ( bx, by )
+*     crosses the length of the segment inside of it times the density.  The
+*     segment is first cut to the clip rectangle, then where it crosses the
+*     lines of the pixel grid, and each piece belongs to the pixel under its
+*     middle.  The places are in double and the grid lines are counted with
+*     integers, so that ovals far from the origin are walked the same.
+* \param cuts Space for the places where the segment is cut
+---------------------------------------------------------------------------- */
+template< class pixelList >
+static void walk_segment( double ax, double ay, double bx, double by, float density,
+                          int x0, int y0, int x1, int y1,
+                          std::pmr::vector< double >& cuts, pixelList& samples )
+{
+  double dx = bx - ax;
+  double dy = by - ay;
+  double length = std::hypot( dx, dy );
+
+  if( not ( 0. < length and std::isfinite( length ) ) )
+    return;
+
+  double tlo = 0.;
+  double thi = 1.;
+
+  if( not clip_segment( ax, dx, x0, x1, & tlo, & thi ) or not clip_segment( ay, dy, y0, y1, & tlo, & thi ) )
+    return;
+
+  cuts.clear();
+  cuts.push_back( tlo );
+  cuts.push_back( thi );
+
+  if( dx != 0. )
+    {
+      double xa = ax + tlo * dx;
+      double xb = ax + thi * dx;
+      int last = (int) std::floor( std::max( xa, xb ) );
+
+      for( int xx = (int) std::ceil( std::min( xa, xb ) ); xx <= last; xx += 1 )
+        {
+          cuts.push_back( ( xx - ax ) / dx );
+        }
+    }
+
+  if( dy != 0. )
+    {
+      double ya = ay + tlo * dy;
+      double yb = ay + thi * dy;
+      int last = (int) std::floor( std::max( ya, yb ) );
+
+      for( int yy = (int) std::ceil( std::min( ya, yb ) ); yy <= last; yy += 1 )
+        {
+          cuts.push_back( ( yy - ay ) / dy );
+        }
+    }
+
+  std::sort( cuts.begin(), cuts.end() );
+
+  for( size_t ii = 1; ii < cuts.size(); ii += 1 )
+    {
+      double t0 = std::max( tlo, cuts[ ii - 1 ] );
+      double t1 = std::min( thi, cuts[ ii ] );
+
+      if( t1 <= t0 )
+        continue;
+
+      double tm = 0.5 * ( t0 + t1 );
+      int xx = (int) std::floor( ax + tm * dx );
+      int yy = (int) std::floor( ay + tm * dy );
+
+      if( x0 <= xx and xx < x1 and y0 <= yy and yy < y1 )
+        {
+          samples.push_back( { yy, xx, xx + 1, (float) ( density * length * ( t1 - t0 ) ) } );
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn disc_strip
+* \description The area of the unit disc below the line at height u, less
+*     the area below the line at -1.
+---------------------------------------------------------------------------- */
+static float disc_strip( float uu )
+{
+  return uu * std::sqrt( std::max( 0.f, 1.f - uu * uu ) ) + std::asin( std::clamp( uu, -1.f, 1.f ) );
+}
+/** ---------------------------------------------------------------------------
+* \fn needle_oval
+* \description Draw an oval that is thinner than a pixel as a few lines
+*     along its long axis.  The oval is cut into strips that are parallel to
+*     the axis, and each strip becomes the line through its middle with the
+*     exact area of the strip spread evenly along it, so only the pixels that
+*     the lines cross are touched and the cost goes with the length of the
+*     oval rather than the area of its bounds.  The strips don't overlap, so
+*     their coverage is added within the oval.
+* \param cuts, pixels Space for walk_segment and for the pixels of the oval
+* \param samples The list where one single pixel run is added per pixel
+---------------------------------------------------------------------------- */
+static const int needle_strips = 4;
+
+template< class pixelList >
+static void needle_oval( const ovalRecord& oval, int x0, int y0, int x1, int y1,
+                         std::pmr::vector< double >& cuts, std::pmr::vector< pixelRun >& pixels,
+                         pixelList& samples )
+{
+  float sinT = std::sin( oval.angle );
+  float cosT = std::cos( oval.angle );
+
+  float major = oval.radiusx;
+  float minor = oval.radiusy;
+  float axisx = cosT;
+  float axisy = sinT;
+
+  if( oval.radiusx < oval.radiusy )   // the long axis is the y axis of the oval
+    {
+      std::swap( major, minor );
+      axisx = -sinT;
+      axisy = cosT;
+    }
+
+  pixels.clear();
+
+  for( int kk = 0; kk < needle_strips; kk += 1 )
+    {
+      float u0 = -1.f + 2.f * kk / needle_strips;
+      float u1 = -1.f + 2.f * ( kk + 1 ) / needle_strips;
+      float um = 0.5f * ( u0 + u1 );
+
+      float area = major * minor * ( disc_strip( u1 ) - disc_strip( u0 ) );
+      float half = major * std::sqrt( 1.f - um * um );
+
+      if( not ( 0.f < half and 0.f < area ) )
+        continue;
+
+      // The middle of the strip, across the axis from the center
+
+      double cx = oval.centerx - (double) axisy * um * minor;
+      double cy = oval.centery + (double) axisx * um * minor;
+
+      walk_segment( cx - (double) axisx * half, cy - (double) axisy * half,
+                    cx + (double) axisx * half, cy + (double) axisy * half,
+                    area / ( 2.f * half ), x0, y0, x1, y1, cuts, pixels );
+    }
+
+  std::sort( pixels.begin(), pixels.end(), []( const pixelRun& one, const pixelRun& two ) {
+    return one.lineY < two.lineY or ( one.lineY == two.lineY and one.startX < two.startX );
+  } );
+
+  for( size_t ii = 0; ii < pixels.size(); )
+    {
+      pixelRun px = pixels[ ii ];
+
+      for( ii += 1; ii < pixels.size() and pixels[ ii ].lineY == px.lineY and pixels[ ii ].startX == px.startX; ii += 1 )
+        {
+          px.value += pixels[ ii ].value;
+        }
+
+      px.value = std::min( 1.f, px.value );
+      samples.push_back( px );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn merge_pixels_into_runs
+* \description Combine a list of single pixel runs with the runs produced by
+*     the sweep.  Pixels that land on the same place are combined with
+*     uniteCoverage, or added when accumulating, both with each other and
+*     with the runs.
+* \param runs The runs from the sweep, sorted by scanline and then by x
+* \param pixels The single pixel runs in any order, this list is sorted
+* \returns The combined list of runs, sorted by scanline and then by x, with
+*     the allocator of `runs`
+---------------------------------------------------------------------------- */
+template< class runList, class pixelList >
+static runList merge_pixels_into_runs( const runList& runs, pixelList& pixels, bool accumulate )
+{
+  std::sort( pixels.begin(), pixels.end(), []( const pixelRun& one, const pixelRun& two ) {
+    return one.lineY < two.lineY or ( one.lineY == two.lineY and one.startX < two.startX );
+  } );
+
+  runList rr( runs.get_allocator() );
+  rr.reserve( runs.size() + pixels.size() );
+
+  size_t ri = 0;
+  size_t pi = 0;
+  pixelRun current = { 0, 0, 0, 0.f };   // the part of runs[ ri ] that hasn't been used
+  bool has_current = false;
+
+  while( has_current or ri < runs.size() or pi < pixels.size() )
+    {
+      if( not has_current and ri < runs.size() )
+        {
+          current = runs[ ri ];
+          has_current = true;
+          ri += 1;
+        }
+
+      // Gather all the pixels at the next position into one
+
+      bool has_pixel = pi < pixels.size();
+      pixelRun px;
+
+      if( has_pixel )
+        {
+          px = pixels[ pi ];
+          pi += 1;
+
+          while( pi < pixels.size() and pixels[ pi ].lineY == px.lineY and pixels[ pi ].startX == px.startX )
+            {
+              px.value = combine_coverage( px.value, pixels[ pi ].value, accumulate );
+              pi += 1;
+            }
+        }
+
+      // Emit the runs that are before the pixel
+
+      while( has_current and ( not has_pixel or current.lineY < px.lineY or
+                               ( current.lineY == px.lineY and current.endX <= px.startX ) ) )
+        {
+          push_or_merge_run( rr, current );
+
+          has_current = ri < runs.size();
+
+          if( has_current )
+            {
+              current = runs[ ri ];
+              ri += 1;
+            }
+        }
+
+      if( has_pixel )
+        {
+          if( has_current and current.lineY == px.lineY and current.startX <= px.startX )
+            {
+              // The pixel lands on the current run, split the run around it
+
+              if( current.startX < px.startX )
+                {
+                  push_or_merge_run( rr, { current.lineY, current.startX, px.startX, current.value } );
+                }
+
+              px.value = combine_coverage( px.value, current.value, accumulate );
+              current.startX = px.endX;
+              has_current = current.startX < current.endX;
+            }
+
+          push_or_merge_run( rr, px );
+        }
+    }
+
+  return rr;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalListToRaster
+---------------------------------------------------------------------------- */
+std::vector<pixelRun> ovalListToRaster( const std::vector<ovalRecord>& ol, int width, int height )
+{
+  return ovalListToRaster( ol.data(), ol.size(), width, height );
+}
+
+std::vector<pixelRun> ovalListToRaster( const ovalRecord *ol, size_t count, int width, int height )
+{
+  return ovalListToRaster( ol, count, 0, 0, width, height );
+}
+
+std::vector<pixelRun> ovalListToRaster( const std::vector<ovalRecord>& ol, int x0, int y0, int x1, int y1 )
+{
+  return ovalListToRaster( ol.data(), ol.size(), x0, y0, x1, y1 );
+}
+
+std::vector<pixelRun> ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1 )
+{
+  return ovalListToRaster( ol, count, x0, y0, x1, y1, rasterOptions() );
+}
+
+std::vector<pixelRun> ovalListToRaster( const std::vector<ovalRecord>& ol, int x0, int y0, int x1, int y1,
+                                        const rasterOptions& options )
+{
+  return ovalListToRaster( ol.data(), ol.size(), x0, y0, x1, y1, options );
+}
+
+/** ---------------------------------------------------------------------------
+* \fn rasterize_into
+* \description The body of ovalListToRaster, for a list of runs of either
+*     kind.  The temporaries are allocated from `options.memory`.
+---------------------------------------------------------------------------- */
+template< class runList >
+static void rasterize_into( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1,
+                            const rasterOptions& options, runList& rr )
+{
+  bool accumulate = options.coverage == coverageMode::accumulate;
+  std::pmr::memory_resource *memory = options.memory ? options.memory : std::pmr::get_default_resource();
+
+  auto start = std::chrono::steady_clock::now();
+
+  OVAL_TRACE_SPAN( prepare_span, "prepare", "raster" );
+  OVAL_TRACE_ARG( prepare_span, "ovals", count );
+
+  if( options.stats )
+    {
+      *options.stats = rasterStats();
+    }
+
+  if( options.rows )
+    {
+      options.rows->firstY = y0;
+      options.rows->rowStart.clear();
+    }
+
+  // Drop the ovals that can not touch the clip rectangle, so that they don't
+  // take part in the scan of every scanline, splat the ovals that are too
+  // small to be worth sweeping and draw the ones that are too thin as lines.
+  // The list is only copied if something was taken out of it.
+
+  std::pmr::vector< floatBounds > all( count, memory );
+  std::pmr::vector< floatBounds > blist( memory );
+  std::pmr::vector< ovalRecord > clipped( memory );
+  std::pmr::vector< pixelRun > splats( memory );
+  std::pmr::vector< pixelRun > needle( memory );
+  std::pmr::vector< double > cuts( memory );
+  bool dropped = false;
+
+  batchBounds( ol, count, all.data() );
+
+  blist.reserve( count );
+
+  for( size_t ii = 0; ii < count; ii += 1 )
+    {
+      const floatBounds& one = all[ ii ];
+      bool inside = x0 <= one.right and one.left <= x1 and y0 <= one.bottom and one.top <= y1;
+      bool splat = ol[ ii ].radiusx < options.splatRadius and ol[ ii ].radiusy < options.splatRadius;
+      bool thin = std::min( ol[ ii ].radiusx, ol[ ii ].radiusy ) < options.needleRadius;
+
+      if( inside and not splat and not thin )
+        {
+          if( dropped )
+            {
+              clipped.push_back( ol[ ii ] );
+            }
+
+          blist.push_back( one );
+        }
+      else
+        {
+          if( not dropped )   // all the ovals before the first one dropped are kept
+            {
+              clipped.assign( ol, ol + ii );
+              dropped = true;
+            }
+
+          if( inside and splat )
+            {
+              splat_oval( ol[ ii ], one, x0, y0, x1, y1, splats );
+
+              if( options.stats )
+                {
+                  options.stats->splatCount += 1;
+                }
+            }
+          else if( inside )
+            {
+              needle_oval( ol[ ii ], x0, y0, x1, y1, cuts, needle, splats );
+
+              if( options.stats )
+                {
+                  options.stats->needleCount += 1;
+                }
+            }
+        }
+    }
+
+  auto prepared = std::chrono::steady_clock::now();
+
+  OVAL_TRACE_ARG( prepare_span, "swept", blist.size() );
+  OVAL_TRACE_ARG( prepare_span, "splatted", splats.size() );
+  OVAL_TRACE_END( prepare_span );
+
+  if( not blist.empty() and x0 < x1 and y0 < y1 )
+    {
+      OVAL_TRACE_SCOPE( "sweep", "raster" );
+
+      const ovalRecord *kept = dropped ? clipped.data() : ol;
+
+      floatBounds bounds = blist[ 0 ];
+
+      for( size_t ii = 1; ii < blist.size(); ii += 1 )
+        {
+          bounds.add( blist[ ii ] );
+        }
+
+      int topY = (int)std::max( (float) y0, std::floor( bounds.top ) );
+      int endY = (int)std::min( (float) y1, std::ceil( bounds.bottom ) );
+      int right_edge = (int)std::min( (float) x1, std::ceil( bounds.right ) );
+
+      rasterizeRows( kept, blist, bounds, topY, endY, x0, right_edge, options, rr );
+    }
+
+  auto swept = std::chrono::steady_clock::now();
+
+  OVAL_TRACE_SPAN( output_span, "output", "raster" );
+
+  if( not splats.empty() )
+    {
+      rr = merge_pixels_into_runs( rr, splats, accumulate );
+
+      if( options.rows )    // the merge moved the runs
+        {
+          indexRows( rr.data(), rr.size(), y0, y1, *options.rows );
+        }
+    }
+  else if( options.rows )
+    {
+      options.rows->rowStart.resize( std::max( y0, y1 ) - y0 + 1, rr.size() );
+    }
+
+  if( options.stats )
+    {
+      std::chrono::duration< double > prepare = prepared - start;
+      std::chrono::duration< double > sweep = swept - prepared;
+      std::chrono::duration< double > total = std::chrono::steady_clock::now() - start;
+
+      options.stats->prepareSeconds = prepare.count();
+      options.stats->sweepSeconds = sweep.count();
+      options.stats->mergeSeconds = total.count() - prepare.count() - sweep.count();
+      options.stats->totalSeconds = total.count();
+      options.stats->ovalCount = blist.size();
+      options.stats->runCount = rr.size();
+    }
+
+  OVAL_TRACE_ARG( output_span, "runs", rr.size() );
+}
+
+std::vector<pixelRun> ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1,
+                                        const rasterOptions& options )
+{
+  std::vector<pixelRun> rr;
+
+  rasterize_into( ol, count, x0, y0, x1, y1, options, rr );
+
+  return rr;
+}
+
+void ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1,
+                       const rasterOptions& options, std::pmr::vector< pixelRun >& runs )
+{
+  runs.clear();
+
+  rasterize_into( ol, count, x0, y0, x1, y1, options, runs );
+}
+/** ---------------------------------------------------------------------------
+* \fn indexRows
+---------------------------------------------------------------------------- */
+void indexRows( const std::vector< pixelRun >& runs, int y0, int y1, rowIndex& rows )
+{
+  indexRows( runs.data(), runs.size(), y0, y1, rows );
+}
+
+void indexRows( const pixelRun *runs, size_t count, int y0, int y1, rowIndex& rows )
+{
+  rows.firstY = y0;
+  rows.rowStart.assign( std::max( y0, y1 ) - y0 + 1, 0 );
+
+  size_t ii = 0;
+
+  for( size_t row = 0; row < rows.rowStart.size(); row += 1 )
+    {
+      while( ii < count and runs[ ii ].lineY < y0 + (int) row )
+        {
+          ii += 1;
+        }
+
+      rows.rowStart[ row ] = ii;
+    }
+
+  rows.rowStart.back() = count;
+}
+/** ---------------------------------------------------------------------------
+* \fn splitRuns
+* \description Cut at the first line that starts at or after each multiple
+*     of total / chunks.  A line with more runs than a chunk makes fewer,
+*     larger chunks, since a line is never split.
+---------------------------------------------------------------------------- */
+std::vector< runChunk > splitRuns( const rowIndex& rows, size_t chunks )
+{
+  std::vector< runChunk > rc;
+
+  if( rows.rowStart.empty() or chunks == 0 )
+    return rc;
+
+  const std::vector< size_t >& rs = rows.rowStart;
+  size_t total = rs.back();
+  size_t line = 0;
+
+  for( size_t kk = 1; kk <= chunks and line + 1 < rs.size(); kk += 1 )
+    {
+      size_t cut = rs.size() - 1;
+
+      if( kk < chunks )
+        {
+          size_t target = total * kk / chunks;
+
+          cut = std::lower_bound( rs.begin() + line, rs.end(), target ) - rs.begin();
+        }
+
+      if( rs[ line ] < rs[ cut ] )
+        {
+          rc.push_back( { rs[ line ], rs[ cut ], rows.firstY + (int) line, rows.firstY + (int) cut } );
+          line = cut;
+        }
+    }
+
+  return rc;
+}
+/** ---------------------------------------------------------------------------
+* \fn runsToRects
+* \description The rectangles that reach the previous line are kept in order
+*     of x, so each line is matched against them in a single pass.
+---------------------------------------------------------------------------- */
+std::vector< pixelRect > runsToRects( const std::vector< pixelRun >& runs )
+{
+  std::vector< pixelRect > rr;
+  std::vector< size_t > open;     // the rectangles that end on the previous line
+  std::vector< size_t > next;
+
+  size_t ii = 0;
+
+  while( ii < runs.size() )
+    {
+      int lineY = runs[ ii ].lineY;
+
+      if( not open.empty() and rr[ open[ 0 ] ].endY != lineY )  // a gap between the lines
+        {
+          open.clear();
+        }
+
+      size_t kk = 0;
+      next.clear();
+
+      for( ; ii < runs.size() and runs[ ii ].lineY == lineY; ii += 1 )
+        {
+          const pixelRun& one = runs[ ii ];
+
+          while( kk < open.size() and rr[ open[ kk ] ].startX < one.startX )
+            {
+              kk += 1;
+            }
+
+          if( kk < open.size() and rr[ open[ kk ] ].startX == one.startX and
+              rr[ open[ kk ] ].endX == one.endX and rr[ open[ kk ] ].value == one.value )
+            {
+              rr[ open[ kk ] ].endY = lineY + 1;
+              next.push_back( open[ kk ] );
+              kk += 1;
+            }
+          else
+            {
+              rr.push_back( { lineY, lineY + 1, one.startX, one.endX, one.value } );
+              next.push_back( rr.size() - 1 );
+            }
+        }
+
+      open.swap( next );
+    }
+
+  return rr;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalListToRects
+---------------------------------------------------------------------------- */
+std::vector< pixelRect > ovalListToRects( const std::vector< ovalRecord >& ol, int x0, int y0, int x1, int y1,
+                                          const rasterOptions& options )
+{
+  return runsToRects( ovalListToRaster( ol, x0, y0, x1, y1, options ) );
+}
+/** ---------------------------------------------------------------------------
+* \fn push_or_merge_large_run
+* \description Same as push_or_merge_run, used to join the runs of
+*     neighbouring tiles.
+---------------------------------------------------------------------------- */
+static void push_or_merge_large_run( std::vector< largePixelRun >& rr, const largePixelRun& pr )
+{
+  if( rr.empty() or
+      rr.back().value != pr.value or
+      rr.back().lineY != pr.lineY or
+      rr.back().endX != pr.startX )
+    {
+      rr.push_back( pr );
+    }
+  else
+    {
+      rr.back().endX = pr.endX;
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn largeOvalListToRaster
+* \description The canvas is split into square tiles.  Each oval is added to
+*     every tile that its bounds touch, with its center made relative to the
+*     origin of the tile, so that all the math in the sweep is done in float
+*     with small coordinates.  The tiles are rasterized a band of tiles at a
+*     time and the runs of the tiles in a band are then interleaved by
+*     scanline, joining runs that continue across the edge of a tile.
+---------------------------------------------------------------------------- */
+std::vector< largePixelRun > largeOvalListToRaster( const std::vector< largeOvalRecord >& ol,
+                                                    int64_t width, int64_t height, int tileSize )
 {
-  float topY = scanY;
-  float bottomY = topY + 1.f;
-  float nextBottomY = bottomY + 1.f;
+  if( tileSize <= 0 )
+    {
+      throw std::invalid_argument( "the tile size must be positive" );
+    }
 
-  float nextY = bounds.bottom;
+  std::vector< largePixelRun > rr;
 
-  for( int ii = 0; ii < blist.size(); ii += 1 )
+  // Find the tiles that each oval touches.  Only the tiles that are touched
+  // are ever created, so the size of the canvas doesn't matter.
+
+  int64_t num_cols = ( width + tileSize - 1 ) / tileSize;
+  int64_t num_rows = ( height + tileSize - 1 ) / tileSize;
+
+  std::map< std::pair< int64_t, int64_t >, std::vector< int > > tiles;   // sorted by row, then column
+
+  for( int ii = 0; ii < ol.size(); ii += 1 )
     {
-      if( intervals_intersect( blist[ ii ].top, blist[ ii ].bottom, topY, bottomY ) )
-        {
-          float topx[ 2 ];
-          float botx[ 2 ];
+      floatBounds bb = computeBounds( { 0.f, 0.f, ol[ ii ].radiusx, ol[ ii ].radiusy, ol[ ii ].angle } );
 
-          int num_top = compute_oval_roots( topx, topY, ol[ ii ] );
-          int num_bottom = compute_oval_roots( botx, bottomY, ol[ ii ] );
+      int64_t col0 = std::max< int64_t >( 0, (int64_t) std::floor( ( ol[ ii ].centerx + bb.left ) / tileSize ) );
+      int64_t col1 = std::min< int64_t >( num_cols - 1, (int64_t) std::floor( ( ol[ ii ].centerx + bb.right ) / tileSize ) );
+      int64_t row0 = std::max< int64_t >( 0, (int64_t) std::floor( ( ol[ ii ].centery + bb.top ) / tileSize ) );
+      int64_t row1 = std::min< int64_t >( num_rows - 1, (int64_t) std::floor( ( ol[ ii ].centery + bb.bottom ) / tileSize ) );
 
-          if( num_top == 2 and num_bottom == 2 )   // the most common case
+      for( int64_t row = row0; row <= row1; row += 1 )
+        {
+          for( int64_t col = col0; col <= col1; col += 1 )
             {
-              edgeRecord er1, er2;
+              tiles[ { row, col } ].push_back( ii );
+            }
+        }
+    }
 
-              er1.set_span( topx[ 0 ], botx[ 0 ] );
-              er2.set_span( topx[ 1 ], botx[ 1 ] );
+  std::vector< ovalRecord > local;
+  std::vector< std::vector< pixelRun > > band;
+  std::vector< int64_t > band_cols;
 
-              er1.edgeType = edgeRecord::leading;
-              er2.edgeType = edgeRecord::trailing;
-              er1.oval = & ol[ ii ];
-              er2.oval = & ol[ ii ];
+  auto tile = tiles.begin();
 
-              edgeList->push_back( er1 );
-              edgeList->push_back( er2 );
-            }
-          else if( num_top == 2 )   // num_bottom is either zero or one
-            {
-              float lowx;
+  while( tile != tiles.end() )
+    {
+      int64_t row = tile->first.first;
+      int64_t originY = row * tileSize;
+      int tile_height = (int) std::min< int64_t >( tileSize, height - originY );
 
-              if( num_bottom == 1 )
-                lowx = botx[ 0 ];
-              else
-                lowx = 0.5f * ( topx[ 0 ] + topx[ 1 ] );
+      band.clear();
+      band_cols.clear();
 
-              edgeList->push_back( {
-                (int) std::floor( topx[ 0 ] ),
-                (int) std::ceil( lowx ),
-                edgeRecord::leading,
-                & ol[ ii ]
-              });
+      // Rasterize all the tiles in this band
 
-              edgeList->push_back( {
-                (int) std::floor( lowx ),
-                (int) std::ceil( topx[ 1 ] ),
-                edgeRecord::trailing,
-                & ol[ ii ]
-              });
-            }
-          else if( num_bottom == 2 )   // then num_top is either zero or one
+      for( ; tile != tiles.end() and tile->first.first == row; ++tile )
+        {
+          int64_t originX = tile->first.second * tileSize;
+          int tile_width = (int) std::min< int64_t >( tileSize, width - originX );
+
+          local.clear();
+
+          for( int index : tile->second )
             {
-              float hix;
+              const largeOvalRecord& one = ol[ index ];
+
+              local.push_back( {
+                  (float)( one.centerx - (double) originX ),
+                  (float)( one.centery - (double) originY ),
+                  one.radiusx,
+                  one.radiusy,
+                  one.angle
+                } );
+            }
 
-              if( num_top == 1 )
-                hix = topx[ 0 ];
-              else
-                hix = 0.5f * ( botx[ 0 ] + botx[ 1 ] );
+          band.push_back( ovalListToRaster( local, tile_width, tile_height ) );
+          band_cols.push_back( originX );
+        }
 
-              edgeList->push_back( {
-                (int) std::floor( botx[ 0 ] ),
-                (int) std::ceil( hix ),
-                edgeRecord::leading,
-                & ol[ ii ]
-              });
+      // Interleave the runs of the tiles by scanline
 
-              edgeList->push_back( {
-                (int) std::floor( hix ),
-                (int) std::ceil( botx[ 1 ] ),
-                edgeRecord::trailing,
-                & ol[ ii ]
-              });
-            }
-          else  // The remaining cases are all pathological - we use the bounds
+      std::vector< size_t > next( band.size(), 0 );
+
+      for( int yy = 0; yy < tile_height; yy += 1 )
+        {
+          for( int tt = 0; tt < band.size(); tt += 1 )
             {
-              if( topY < blist[ ii ].bottom and blist[ ii ].top < bottomY )
-                {
-                  float midx;
-
-                  if( num_top == 1 )
-                    midx = topx[ 0 ];
-                  else
-                    midx = 0.5f * (blist[ ii ].left + blist[ ii ].right);
-
-                  edgeList->push_back( {
-                      (int) std::floor( blist[ ii ].left ),
-                      (int) std::ceil( midx ),
-                      edgeRecord::leading,
-                      &ol[ ii ]
-                    } );
+              const std::vector< pixelRun >& runs = band[ tt ];
 
-                  if( num_bottom == 1 )
-                    midx = botx[ 0 ];
-                  else
-                    midx = 0.5f * (blist[ ii ].left + blist[ ii ].right);
+              for( ; next[ tt ] < runs.size() and runs[ next[ tt ] ].lineY == yy; next[ tt ] += 1 )
+                {
+                  const pixelRun& one = runs[ next[ tt ] ];
 
-                  edgeList->push_back( {
-                      (int) std::floor( midx ),
-                      (int) std::ceil( blist[ ii ].right ),
-                      edgeRecord::trailing,
-                      &ol[ ii ]
+                  push_or_merge_large_run( rr, {
+                      originY + one.lineY,
+                      band_cols[ tt ] + one.startX,
+                      band_cols[ tt ] + one.endX,
+                      one.value
                     } );
                 }
-              else
-                {
-                  nextY = bottomY;
-                }
-            }
-        }
-      else  // this interval does not intersect the current line
-        {
-          if( topY <= blist[ ii ].top and blist[ ii ].top < nextY )
-            {
-              nextY = blist[ ii ].top;
             }
         }
     }
 
-  int next_scanY;
+  return rr;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalStreamRasterizer::ovalStreamRasterizer
+---------------------------------------------------------------------------- */
+ovalStreamRasterizer::ovalStreamRasterizer( int width, int height ) :
+width_( width ), height_( height ), nextY_( 0 ), lastTop_( -INFINITY )
+{
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalStreamRasterizer::addOval
+---------------------------------------------------------------------------- */
+void ovalStreamRasterizer::addOval( const ovalRecord& oval )
+{
+  floatBounds one = computeBounds( oval );
 
-  if( not edgeList->empty() )
+  if( one.top < lastTop_ )
     {
-      next_scanY = scanY + 1;
+      throw std::invalid_argument( "ovals must be added in order of their top bound" );
     }
-  else  // the edgelist is empty, nothing intersected our span
+
+  lastTop_ = one.top;
+
+  // A scanline is finished once no oval that is still to come can touch it.
+  // Every oval that follows has a top at or below this one, so all the
+  // scanlines that end above it are done.
+
+  int finishedY = (int) std::ceil( one.top - 1.f );
+
+  if( nextY_ < finishedY )
     {
-      next_scanY = std::max( (int) std::floor( nextY ), scanY + 1 );;
+      emitRows( finishedY );
     }
 
-  return next_scanY;
+  if( nextY_ <= one.bottom and one.top < height_ )
+    {
+      active_.push_back( oval );
+      blist_.push_back( one );
+    }
 }
-/** ---------------------------------------------------------------------------
-* \fn extend_or_push
+/** ----------------------------------------------------------------------------
+  \fn ovalStreamRasterizer::finish
 ---------------------------------------------------------------------------- */
-static void push_or_merge_run( std::vector< pixelRun >& rr, const pixelRun& pr )
+void ovalStreamRasterizer::finish()
 {
-  if( 0.f < pr.value )
-    {
-      if( rr.empty() or
-          rr.back().value != pr.value or
-          rr.back().lineY != pr.lineY or
-          rr.back().endX != pr.startX )
-        {
-          rr.push_back( pr );
-        }
-      else
-        {
-          rr.back().endX = pr.endX;
-        }
-    }
+  emitRows( height_ );
+
+  active_.clear();
+  blist_.clear();
 }
-/** ---------------------------------------------------------------------------
-* \fn ovalListToRaster
+/** ----------------------------------------------------------------------------
+  \fn ovalStreamRasterizer::takeRuns
 ---------------------------------------------------------------------------- */
-std::vector<pixelRun> ovalListToRaster( const std::vector<ovalRecord>& ol, int width, int height )
+void ovalStreamRasterizer::takeRuns( std::vector< pixelRun > *runs )
 {
-  std::vector<pixelRun> rr;
+  runs->clear();
+  runs->swap( runs_ );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalStreamRasterizer::emitRows
+  \description Rasterize all the scanlines up to endY and then drop the ovals
+      that can not touch any of the scanlines that remain.
+---------------------------------------------------------------------------- */
+void ovalStreamRasterizer::emitRows( int endY )
+{
+  endY = std::min( endY, height_ );
 
-  if( not ol.empty() )
+  if( nextY_ < endY and not active_.empty() )
     {
-      std::vector< floatBounds > blist;
+      floatBounds bounds = blist_[ 0 ];
 
-      floatBounds bounds = computeBounds( ol[ 0 ] );
-      blist.push_back( bounds );
-
-      for( int ii = 1; ii < ol.size(); ii += 1 )
+      for( size_t ii = 1; ii < blist_.size(); ii += 1 )
         {
-          floatBounds one = computeBounds( ol[ ii ] );
-          bounds.add( one );
-          blist.push_back( one );
+          bounds.add( blist_[ ii ] );
         }
 
-      int topY = (int)std::max( 0.f, bounds.top );
-      int endY = (int)std::min( (float)height, std::ceil( bounds.bottom ) );
-      int right_edge = (int)std::min((float) width, std::ceil( bounds.right ) );
-
-      int scanY = topY;
-      pixelRun pr;
-
-      std::vector<edgeRecord> edgeList;
-
-      if( scanY < endY )
-        {
-          for(;;)
-            {
-              pr.lineY = scanY;
-
-              // For the given scanline find all the edges that are relevant
-              int nextY = computeEdgeList( scanY, ol, blist, bounds, &edgeList );
-
-              if( not edgeList.empty() )
-                {
-                  std::sort( edgeList.begin(), edgeList.end() );
-                  std::set< const ovalRecord *> aalist;    // for anti-aliased pixels
-                  std::set< const ovalRecord *> xxlist;    // to track inside/outside
-
-                  pr.startX = std::max( 0, edgeList[ 0 ].startx );
-
-                  if( pr.startX < right_edge )
-                    {
-                      do
-                        {
-                          pr.endX = right_edge;  // assume that we're going to the edge
-
-                          // For each value of x, we need to go through the list of edges
-                          // and collect the oval edges that would need to be evaluated there
-
-                          for( const auto& edge : edgeList )
-                            {
-                              if( edge.startx <= pr.startX ) // the edge is to left or at us
-                                {
-                                  if( edge.edgeType == edgeRecord::leading )
-                                    {
-                                      if( pr.startX < edge.endx ) // we're inside the edge
-                                        {
-                                          aalist.insert( edge.oval );
-                                        }
-                                      else  // we're completely to the right of this edge
-                                        {
-                                          xxlist.insert( edge.oval );
-                                        }
-                                    }
-                                  else //  edge.Type == edgeRecord::trailing
-                                    {
-                                      xxlist.erase( edge.oval );    // this ends the solid run
-
-                                      if( pr.startX < edge.endx )   // we're in the active section
-                                        {
-                                          aalist.insert( edge.oval );
-                                        }
-                                    }
-                                }
-                              else  // this edge starts is beyond our current scan point - done with this run
-                                {
-                                  // signal for the next run to begin at the start of the next edge
-
-                                  pr.endX = std::min( edge.startx, right_edge );
-                                  break;
-                                }
-                            }
-
-                          if( aalist.empty() )
-                            {
-                              if( not xxlist.empty() )
-                                {
-                                  pr.value = 1.f;   // a solid run
-                                  push_or_merge_run( rr, pr );
-                                }
-                            }
-                          else // we might need to anti-alias an edge
-                            {
-                              pr.endX = pr.startX + 1;    // when we have active edges, go one pixel at the time
+      int topY = std::max( nextY_, (int) std::max( 0.f, bounds.top ) );
+      int lastY = std::min( endY, (int) std::ceil( bounds.bottom ) );
+      int right_edge = (int) std::min( (float) width_, std::ceil( bounds.right ) );
 
-                              if( xxlist.empty() )
-                                {
-                                  pr.value = compute_aa_pixel( aalist, pr.startX, pr.lineY );
-                                }
-                              else  // we're a partial edge that is completely inside of another oval
-                                {
-                                  pr.value = 1.f;
-                                }
+      rasterizeRows( active_.data(), blist_, bounds, topY, lastY, 0, right_edge, rasterOptions(), runs_ );
+    }
 
-                              push_or_merge_run( rr, pr );
-                              aalist.clear();
-                            }
+  nextY_ = std::max( nextY_, endY );
 
-                          xxlist.clear();
-                          pr.startX = pr.endX;
+  // Retire the ovals that end above the next scanline
 
-                        }  while( pr.startX < right_edge );
-                    }
-                }
+  size_t kept = 0;
 
-              if( nextY < endY )
-                {
-                  scanY = nextY;
-                  edgeList.resize( 0 );
-                }
-              else break;
-            }
+  for( size_t ii = 0; ii < active_.size(); ii += 1 )
+    {
+      if( nextY_ <= blist_[ ii ].bottom )
+        {
+          active_[ kept ] = active_[ ii ];
+          blist_[ kept ] = blist_[ ii ];
+          kept += 1;
         }
     }
 
-  return rr;
+  active_.resize( kept );
+  blist_.resize( kept );
 }
 /** ---------------------------------------------------------------------------
 * \fn deduplicateOvalList
 ---------------------------------------------------------------------------- */
-int deduplicateOvalList( std::vector< ovalRecord >& ovalList, float cover_limit )
+int deduplicateOvalList( std::vector< ovalRecord >& ovalList, float cover_limit, std::pmr::memory_resource *memory )
 {
   int num_removed = 0;
 
+  if( not memory )
+    {
+      memory = std::pmr::get_default_resource();
+    }
+
   if( 1 < ovalList.size() and 0.f < cover_limit )
     {
-      std::vector< overlapRecord > xlist;
+      OVAL_TRACE_SPAN( sort_span, "dedup sort", "dedup" );
+      OVAL_TRACE_ARG( sort_span, "ovals", ovalList.size() );
+
+      std::pmr::vector< overlapRecord > xlist( memory );
       xlist.reserve( ovalList.size() );
 
       int ii = 0;
@@ -712,7 +1918,11 @@ int deduplicateOvalList( std::vector< ovalRecord >& ovalList, float cover_limit
           xlist.push_back( { ii, computeBounds( ovalList[ ii ] ) } );
         }
       std::sort( xlist.begin(), xlist.end() );
-      std::set< int > skips;
+
+      OVAL_TRACE_END( sort_span );
+      OVAL_TRACE_SPAN( overlap_span, "dedup overlaps", "dedup" );
+
+      std::pmr::set< int > skips( memory );
       for( int jj = 0; jj < xlist.size(); jj += 1 )
         {
           if( skips.count( jj ) == 0 )    // if we haven't deleted this one
@@ -745,9 +1955,14 @@ int deduplicateOvalList( std::vector< ovalRecord >& ovalList, float cover_limit
             }
         }
 
+      OVAL_TRACE_ARG( overlap_span, "removed", skips.size() );
+      OVAL_TRACE_END( overlap_span );
+
       if( not skips.empty() )
         {
-          std::vector< ovalRecord > updatedList;
+          OVAL_TRACE_SCOPE( "dedup compact", "dedup" );
+
+          std::pmr::vector< ovalRecord > updatedList( memory );
 
           for( ii = 0; ii < ovalList.size(); ii += 1 )
             {
@@ -757,7 +1972,7 @@ int deduplicateOvalList( std::vector< ovalRecord >& ovalList, float cover_limit
                 }
             }
 
-          ovalList.swap( updatedList );
+          ovalList.assign( updatedList.begin(), updatedList.end() );   // smaller, so it stays in place
           num_removed = skips.size();
         }
     }
@@ -827,52 +2042,6 @@ TEST_CASE( "Intervals Intersect" )
   CHECK( intervals_intersect( 10.f, 20.f, 0.f, 10.f ) );    // touching on the left
   CHECK( intervals_intersect( 10.f, 20.f, 20.f, 30.f) );    // touching on the right
 }
-TEST_CASE( "Compute Roots" )
-{
-  ovalRecord oval = {
-    .centerx = 10.f,
-    .centery = 5.f,
-    .radiusx = 3.f,
-    .radiusy = 4.f,
-    .angle = M_PI_4
-  };
-
-  float xx[ 2 ];
-
-  int num_roots = compute_oval_roots( xx, 6.f, oval );    // above the center
-  CHECK( num_roots == 2 );
-  CHECK( xx[ 0 ] == doctest::Approx(  6.464482f ) );
-  CHECK( xx[ 1 ] == doctest::Approx( 12.975518f ) );
-
-  float dx_above = xx[ 1 ] - xx[ 0 ];
-
-  num_roots = compute_oval_roots( xx, 4.f, oval );        // below the center
-  CHECK( num_roots == 2 );
-  CHECK( xx[ 0 ] < xx[ 1 ] );
-  CHECK( xx[ 0 ] == doctest::Approx(  7.024482f ) );
-  CHECK( xx[ 1 ] == doctest::Approx( 13.535518f ) );
-
-  float dx_below = xx[ 1 ] - xx[ 0 ];
-
-  // Since we test one line line above and one line below the center of the
-  // oval, we expect the distance between the roots to be the same
-
-  CHECK( ( dx_above - dx_below ) == doctest::Approx( 0.f ) );
-
-  oval.angle = 0.f;   // rest the angle to check for one root
-  num_roots = compute_oval_roots( xx, 1., oval );
-  CHECK( num_roots == 1 );
-  CHECK( xx[ 0 ] < xx[ 1 ] );
-  CHECK( xx[ 0 ] == doctest::Approx( 10.f ) );
-
-  // Test above and below the oval to confirm that no roots can be found there
-
-  num_roots = compute_oval_roots( xx, 0.f, oval );  // below
-  CHECK( num_roots == 0 );
-
-  num_roots = compute_oval_roots( xx, 10.f, oval );   // above
-  CHECK( num_roots == 0 );
-}
 TEST_CASE("edgeRecord_sort")
 {
   std::vector< edgeRecord > edgeList;
@@ -893,6 +2062,13 @@ TEST_CASE("edgeRecord_sort")
 
   CHECK( edgeList[ 0 ] < edgeList[ 1 ] );
   CHECK( edgeList[ 1 ] < edgeList[ 2 ] );
+
+  // A leading edge sorts before a trailing edge that starts at the same place
+
+  edgeRecord four{ .startx = 30, .endx = 32, .edgeType = edgeRecord::leading, .oval = nullptr };
+
+  CHECK( four < three );
+  CHECK( not ( three < four ) );
 }
 TEST_CASE("edgeRecord_set_span")
 {
@@ -917,6 +2093,26 @@ TEST_CASE("compute_sdf")
   CHECK( compute_sdf( & oval, 0.f, 20.f ) == doctest::Approx( 6.f ) );
   CHECK( compute_sdf( & oval, 8.f, 20.f ) == doctest::Approx( -2.f ) );
 }
+TEST_CASE("ovalContainsPoint")
+{
+  ovalRecord oval{ 10.f, 20.f, 3.f, 4.f, M_PI_2 };
+
+  CHECK( ovalContainsPoint( oval, 10.f, 20.f ) );
+  CHECK( ovalContainsPoint( oval, 13.9f, 20.f ) );      // the long axis is along x after rotation
+  CHECK( not ovalContainsPoint( oval, 10.f, 23.1f ) );
+  CHECK( ovalContainsPoint( oval, 10.f, 22.9f ) );
+  CHECK( not ovalContainsPoint( oval, 13.f, 22.f ) );
+
+  for( float yy = 10.f; yy < 30.f; yy += 0.37f )   // agrees with the sign of compute_sdf
+    {
+      for( float xx = 0.f; xx < 20.f; xx += 0.41f )
+        {
+          CHECK( ovalContainsPoint( oval, xx, yy ) == ( compute_sdf( & oval, xx, yy ) <= 0.f ) );
+        }
+    }
+
+  CHECK( not ovalContainsPoint( { 10.f, 10.f, 5.f, 0.f, 0.f }, 10.f, 10.f ) );   // flat ovals are empty
+}
 TEST_CASE("AA_Case_Tests")
 {
   CHECK( aa_case_1( -1.f, 0.f, 0.f ) == doctest::Approx( .5f ) );
@@ -991,12 +2187,16 @@ TEST_CASE("Compute Edge List Case 2-{2,1}" )
   ovalList.push_back( { 16.5f, 11.5f, 1.0f, 1.5f, 0.f } );
 
   floatBounds bounds = computeBounds( ovalList[ 0 ] );
-  std::vector< floatBounds > blist;
+  std::pmr::vector< floatBounds > blist;
   blist.push_back( bounds );
 
+  ovalArrays oa;
+  oa.assign( ovalList.data(), ovalList.size() );
+  rootScratch scratch;
+
   // CASE 1-2
-  std::vector< edgeRecord > edgeList;
-  int nextY = computeEdgeList( 10, ovalList, blist, bounds, & edgeList );
+  std::pmr::vector< edgeRecord > edgeList;
+  int nextY = computeEdgeList( 10, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 11 );
@@ -1009,7 +2209,7 @@ TEST_CASE("Compute Edge List Case 2-{2,1}" )
 
   // CASE 2-2
   edgeList.clear();
-  nextY = computeEdgeList( 11, ovalList, blist, bounds, & edgeList );
+  nextY = computeEdgeList( 11, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 12 );
@@ -1022,7 +2222,7 @@ TEST_CASE("Compute Edge List Case 2-{2,1}" )
 
   // CASE 2-1
   edgeList.clear();
-  nextY = computeEdgeList( 12, ovalList, blist, bounds, & edgeList );
+  nextY = computeEdgeList( 12, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 13 );
@@ -1039,12 +2239,16 @@ TEST_CASE("Compute Edge List Case 1-{1,0}" )
   ovalList.push_back( { 8.5f, 14.5f, 1.0f, 1.f, 0.f } );
 
   floatBounds bounds = computeBounds( ovalList[ 0 ] );
-  std::vector< floatBounds > blist;
+  std::pmr::vector< floatBounds > blist;
   blist.push_back( bounds );
 
+  ovalArrays oa;
+  oa.assign( ovalList.data(), ovalList.size() );
+  rootScratch scratch;
+
   // CASE 0-2
-  std::vector< edgeRecord > edgeList;
-  int nextY = computeEdgeList( 13, ovalList, blist, bounds, & edgeList );
+  std::pmr::vector< edgeRecord > edgeList;
+  int nextY = computeEdgeList( 13, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 14 );
@@ -1057,7 +2261,7 @@ TEST_CASE("Compute Edge List Case 1-{1,0}" )
 
   // CHECK 2-0
   edgeList.clear();
-  nextY = computeEdgeList( 15, ovalList, blist, bounds, & edgeList );
+  nextY = computeEdgeList( 15, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 16 );
@@ -1074,12 +2278,16 @@ TEST_CASE("Compute Edge List Case 1-1" )
   ovalList.push_back( { 8.5f, 16.5f, 0.5f, 0.5f, 0.f } );
 
   floatBounds bounds = computeBounds( ovalList[ 0 ] );
-  std::vector< floatBounds > blist;
+  std::pmr::vector< floatBounds > blist;
   blist.push_back( bounds );
 
+  ovalArrays oa;
+  oa.assign( ovalList.data(), ovalList.size() );
+  rootScratch scratch;
+
   // CASE 1-1
-  std::vector< edgeRecord > edgeList;
-  int nextY = computeEdgeList( 16, ovalList, blist, bounds, & edgeList );
+  std::pmr::vector< edgeRecord > edgeList;
+  int nextY = computeEdgeList( 16, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 17 );
@@ -1096,7 +2304,7 @@ TEST_CASE("Compute Edge List Case 0-1 and 1-0" )
   ovalList.push_back( { 8.5f, 17.75f, 0.25f, 0.25f, 0.f } );
   ovalList.push_back( { 8.5f, 18.25f, 0.25f, 0.25f, 0.f } );
 
-  std::vector< floatBounds > blist;
+  std::pmr::vector< floatBounds > blist;
 
   floatBounds b1 = computeBounds( ovalList[ 0 ] );
   floatBounds b2 = computeBounds( ovalList[ 1 ] );
@@ -1108,8 +2316,12 @@ TEST_CASE("Compute Edge List Case 0-1 and 1-0" )
   blist.push_back( b2 );
 
   // CASE 0-1
-  std::vector< edgeRecord > edgeList;
-  int nextY = computeEdgeList( 17, ovalList, blist, bounds, & edgeList );
+  ovalArrays oa;
+  oa.assign( ovalList.data(), ovalList.size() );
+  rootScratch scratch;
+
+  std::pmr::vector< edgeRecord > edgeList;
+  int nextY = computeEdgeList( 17, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
 
   REQUIRE( edgeList.size() == 2 );
   CHECK( nextY == 18 );
@@ -1122,7 +2334,7 @@ TEST_CASE("Compute Edge List Case 0-1 and 1-0" )
 
   // CASE 1-0
   edgeList.clear();
-  nextY = computeEdgeList( 18, ovalList, blist, bounds, & edgeList );
+  nextY = computeEdgeList( 18, ovalList.data(), oa, blist, bounds, scratch, & edgeList );
   CHECK( nextY == 19 );
   CHECK( edgeList[ 0 ].startx == 8 );
   CHECK( edgeList[ 0 ].endx == 9 );
@@ -1131,6 +2343,220 @@ TEST_CASE("Compute Edge List Case 0-1 and 1-0" )
   CHECK( edgeList[ 1 ].endx == 9 );
   CHECK( edgeList[ 1 ].edgeType == edgeRecord::trailing );
 }
+TEST_CASE( "Splat Oval" )
+{
+  std::vector< pixelRun > samples;
+
+  ovalRecord centered{ 3.5f, 3.5f, .25f, .25f, 0.f };   // completely inside of one pixel
+  splat_oval( centered, computeBounds( centered ), 0, 0, 10, 10, samples );
+
+  REQUIRE( samples.size() == 1 );
+  CHECK( samples[ 0 ].lineY == 3 );
+  CHECK( samples[ 0 ].startX == 3 );
+  CHECK( samples[ 0 ].value == doctest::Approx( M_PI * .25f * .25f ) );
+
+  samples.clear();
+
+  ovalRecord corner{ 3.f, 3.f, .25f, .25f, 0.f };   // spread over four pixels
+  splat_oval( corner, computeBounds( corner ), 0, 0, 10, 10, samples );
+
+  REQUIRE( samples.size() == 4 );
+
+  for( const auto& one : samples )
+    {
+      CHECK( one.value == doctest::Approx( 0.25f * M_PI * .25f * .25f ) );
+    }
+
+  samples.clear();
+  splat_oval( corner, computeBounds( corner ), 3, 3, 10, 10, samples );   // clipped to one pixel
+
+  CHECK( samples.size() == 1 );
+}
+TEST_CASE( "Merge Pixels Into Runs" )
+{
+  std::vector< pixelRun > runs;
+
+  runs.push_back( { 1, 10, 20, 1.f } );
+  runs.push_back( { 1, 20, 21, .5f } );
+  runs.push_back( { 3, 0, 5, .25f } );
+
+  std::vector< pixelRun > pixels;
+
+  pixels.push_back( { 3, 2, 3, .5f } );     // splits the last run
+  pixels.push_back( { 1, 15, 16, .5f } );   // inside of a solid run
+  pixels.push_back( { 1, 20, 21, .5f } );   // on top of an aa pixel
+  pixels.push_back( { 1, 20, 21, .5f } );   // twice
+  pixels.push_back( { 0, 0, 1, .5f } );     // on a line of its own
+  pixels.push_back( { 3, 8, 9, .5f } );     // after the last run
+
+  auto rr = merge_pixels_into_runs( runs, pixels, false );
+
+  REQUIRE( rr.size() == 7 );
+
+  CHECK( rr[ 0 ].lineY == 0 );
+  CHECK( rr[ 1 ].lineY == 1 );
+  CHECK( rr[ 1 ].startX == 10 );
+  CHECK( rr[ 1 ].endX == 20 );
+  CHECK( rr[ 1 ].value == 1.f );
+  CHECK( rr[ 2 ].startX == 20 );
+  CHECK( rr[ 2 ].value == doctest::Approx( 0.875f ) );
+  CHECK( rr[ 3 ].startX == 0 );
+  CHECK( rr[ 3 ].endX == 2 );
+  CHECK( rr[ 4 ].startX == 2 );
+  CHECK( rr[ 4 ].value == doctest::Approx( 0.625f ) );
+  CHECK( rr[ 5 ].startX == 3 );
+  CHECK( rr[ 5 ].endX == 5 );
+  CHECK( rr[ 6 ].startX == 8 );
+
+  // When accumulating the values are added instead
+
+  rr = merge_pixels_into_runs( runs, pixels, true );
+
+  REQUIRE( rr.size() == 9 );
+  CHECK( rr[ 2 ].startX == 15 );
+  CHECK( rr[ 2 ].value == 1.5f );
+  CHECK( rr[ 3 ].value == 1.f );
+  CHECK( rr[ 4 ].value == 1.5f );
+  CHECK( rr[ 6 ].value == .75f );
+}
+TEST_CASE( "Runs To Rectangles" )
+{
+  std::vector< pixelRun > runs;
+
+  runs.push_back( { 2, 0, 4, .5f } );
+  runs.push_back( { 2, 4, 10, 1.f } );
+  runs.push_back( { 3, 4, 10, 1.f } );     // joins the one above
+  runs.push_back( { 4, 3, 10, 1.f } );     // a different start
+  runs.push_back( { 5, 3, 10, .5f } );     // a different value
+  runs.push_back( { 7, 3, 10, .5f } );     // a gap in the lines
+
+  auto rr = runsToRects( runs );
+
+  REQUIRE( rr.size() == 5 );
+  CHECK( rr[ 1 ].startY == 2 );
+  CHECK( rr[ 1 ].endY == 4 );
+  CHECK( rr[ 1 ].startX == 4 );
+  CHECK( rr[ 2 ].startY == 4 );
+  CHECK( rr[ 4 ].startY == 7 );
+  CHECK( rr[ 4 ].endY == 8 );
+
+  // Near the sides of a large oval the lines repeat, and the rectangles cover
+  // the same pixels as the runs
+
+  std::vector< ovalRecord > ol = { { 100.f, 80.f, 90.f, 60.f, 0.f }, { 60.f, 60.f, 20.f, 30.f, 0.4f } };
+
+  runs = ovalListToRaster( ol, 200, 160 );
+  rr = ovalListToRects( ol, 0, 0, 200, 160 );
+
+  CHECK( rr.size() < runs.size() );
+
+  std::vector< pixelRun > back;
+
+  for( const auto& one : rr )
+    {
+      for( int yy = one.startY; yy < one.endY; yy += 1 )
+        {
+          back.push_back( { yy, one.startX, one.endX, one.value } );
+        }
+    }
+
+  std::sort( back.begin(), back.end(), []( const pixelRun& one, const pixelRun& two )
+    {
+      return one.lineY < two.lineY or ( one.lineY == two.lineY and one.startX < two.startX );
+    } );
+
+  REQUIRE( back.size() == runs.size() );
+
+  bool same = true;
+
+  for( size_t ii = 0; ii < runs.size(); ii += 1 )
+    {
+      same = same and back[ ii ].lineY == runs[ ii ].lineY and back[ ii ].startX == runs[ ii ].startX and
+             back[ ii ].endX == runs[ ii ].endX and back[ ii ].value == runs[ ii ].value;
+    }
+
+  CHECK( same );
+}
+TEST_CASE( "Row Index And Chunks" )
+{
+  std::vector< ovalRecord > ol;
+
+  for( int ii = 0; ii < 60; ii += 1 )
+    {
+      ol.push_back( { 10.f + ii * 37 % 180, 5.f + ii * 53 % 110, 1.f + ii % 9, 0.5f + ii % 7, 0.1f * ii } );
+    }
+
+  for( float splat : { 0.f, 1.5f } )
+    {
+      rasterOptions options;
+      rowIndex rows;
+
+      options.splatRadius = splat;
+      options.rows = & rows;
+
+      auto runs = ovalListToRaster( ol, 0, -5, 200, 120, options );
+
+      REQUIRE( rows.firstY == -5 );
+      REQUIRE( rows.endY() == 120 );
+
+      // The index recorded by the sweep is the one found from the runs
+
+      rowIndex found;
+      indexRows( runs, -5, 120, found );
+
+      CHECK( rows.rowStart == found.rowStart );
+
+      bool inside = true;
+
+      for( int yy = -5; yy < 120; yy += 1 )
+        {
+          for( size_t ii = rows.begin( yy ); ii < rows.end( yy ); ii += 1 )
+            {
+              inside = inside and runs[ ii ].lineY == yy;
+            }
+        }
+
+      CHECK( inside );
+      CHECK( rows.begin( -100 ) == rows.end( -100 ) );
+      CHECK( rows.begin( 500 ) == runs.size() );
+
+      // The chunks follow each other, cover all the runs and are about the
+      // same size
+
+      auto chunks = splitRuns( rows, 4 );
+      size_t widest = 0;
+
+      for( int yy = -5; yy < 120; yy += 1 )
+        {
+          widest = std::max( widest, rows.end( yy ) - rows.begin( yy ) );
+        }
+
+      REQUIRE( chunks.size() == 4 );
+      CHECK( chunks.front().begin == 0 );
+      CHECK( chunks.back().end == runs.size() );
+
+      for( size_t kk = 0; kk < chunks.size(); kk += 1 )
+        {
+          CHECK( chunks[ kk ].begin == rows.begin( chunks[ kk ].startY ) );
+          CHECK( chunks[ kk ].end == rows.begin( chunks[ kk ].endY ) );
+          CHECK( chunks[ kk ].end - chunks[ kk ].begin <= runs.size() / 4 + widest );
+
+          if( 0 < kk )
+            {
+              CHECK( chunks[ kk ].begin == chunks[ kk - 1 ].end );
+              CHECK( chunks[ kk ].startY == chunks[ kk - 1 ].endY );
+            }
+        }
+    }
+
+  // Nothing to split
+
+  rowIndex rows;
+  indexRows( std::vector< pixelRun >(), 0, 10, rows );
+
+  CHECK( rows.rowStart.size() == 11 );
+  CHECK( splitRuns( rows, 4 ).empty() );
+}
 TEST_SUITE_END();
 #endif
 
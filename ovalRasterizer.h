@@ -8,6 +8,11 @@
 #ifndef OVALRASTERIZER_H
 #define OVALRASTERIZER_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
 
 struct ovalRecord
@@ -19,6 +24,22 @@ struct ovalRecord
   float angle;     /// The counter-clockwise angle of rotation in radians.
  };
 
+struct floatBounds
+ {
+  float left;
+  float top;
+  float right;
+  float bottom;
+
+  void add( const floatBounds& other )
+  {
+    left = std::min( left, other.left );
+    top = std::min( top, other.top );
+    right = std::max( right, other.right );
+    bottom = std::max( bottom, other.bottom );
+  }
+ };
+
 struct pixelRun
  {
   int lineY;
@@ -27,6 +48,145 @@ struct pixelRun
   float value;
  };
 
+/// The same run repeated on the lines from startY up to (but not including)
+/// endY.  Large ovals give many lines with the same solid run, which are
+/// one rectangle.
+
+struct pixelRect
+ {
+  int startY;
+  int endY;
+  int startX;
+  int endX;
+  float value;
+ };
+
+/// How the coverage of ovals that overlap is combined.  With `unite` the
+/// value of a pixel is the area covered by any of the ovals, at most 1.  With
+/// `accumulate` the value is the sum of the area that each oval covers, so a
+/// pixel that is inside of three ovals gets the value 3.
+
+enum class coverageMode { unite, accumulate };
+
+/// \fn uniteCoverage
+/// \description The union of two coverages as if the shapes were placed
+///     independently of each other inside the pixel, 1 - ( 1 - a ) ( 1 - b ),
+///     which is exactly `two` when `one` is zero.  Everything that unites
+///     coverage outside of the sweep, the splats, the mask cache and the
+///     stamps, uses this so that they round the same.
+inline float uniteCoverage( float one, float two )
+{
+  return one + two * ( 1.f - one );
+}
+
+/// What a call to the rasterizer did and where the time went.  The times are
+/// measured inside the rasterizer, so they don't include the copy of the
+/// result or anything else done by the caller.
+
+struct rasterStats
+ {
+  double prepareSeconds = 0.;   /// Computing bounds, clipping and splatting
+  double sweepSeconds = 0.;     /// Building the edge lists and sweeping the scanlines
+  double mergeSeconds = 0.;     /// Merging the splats into the runs
+  double totalSeconds = 0.;
+
+  size_t ovalCount = 0;         /// The ovals that were swept
+  size_t splatCount = 0;        /// The ovals that were splatted
+  size_t needleCount = 0;       /// The ovals that were drawn as lines
+  size_t scanlineCount = 0;     /// The scanlines that had edges on them
+  size_t edgeCount = 0;
+  size_t aaPixelCount = 0;      /// The pixels whose coverage was computed from distances
+  size_t exactOvalCount = 0;    /// The swept ovals whose roots were found in double precision
+  size_t runCount = 0;
+ };
+
+/// Where the runs of each line start in a list of runs, so that one line can
+/// be found without searching and the list can be split between threads.
+/// The runs of line y are [ begin( y ), end( y ) ), which is empty for the
+/// lines that have no runs and for the lines outside of the index.
+
+struct rowIndex
+ {
+  int firstY = 0;
+  std::vector< size_t > rowStart;   /// One per line, and one past the last line
+
+  int endY() const { return firstY + (int) rowStart.size() - 1; }
+
+  size_t begin( int lineY ) const
+  {
+    if( rowStart.empty() )
+      return 0;
+
+    return rowStart[ std::min( std::max( lineY, firstY ), endY() ) - firstY ];
+  }
+
+  size_t end( int lineY ) const { return begin( lineY + 1 ); }
+ };
+
+/// A piece of a list of runs made of whole lines: the runs
+/// [ begin, end ) on the lines [ startY, endY ).
+
+struct runChunk
+ {
+  size_t begin;
+  size_t end;
+  int startY;
+  int endY;
+ };
+
+/// The options that change how the ovals are rasterized.  The defaults give
+/// the same results as the calls that don't take options.
+
+struct rasterOptions
+ {
+  coverageMode coverage = coverageMode::unite;
+
+  /// When false, the pixels on the edges of the ovals are not anti-aliased.
+  /// A pixel is either inside or outside of an oval depending on where its
+  /// center is, which takes one distance per oval instead of four or five.
+  /// This is meant for quick previews.
+  bool antialias = true;
+
+
+  /// Ovals whose radii are both smaller than this are not swept.  Instead,
+  /// their area is spread over the (at most four) pixels under a box of the
+  /// same area.  Where such an oval overlaps anything else the coverage is
+  /// combined as 1 - ( 1 - a ) * ( 1 - b ), as if the shapes were placed
+  /// independently of each other inside the pixel, rather than as an exact
+  /// union.  When accumulating, the coverage is simply added.  Zero disables
+  /// splatting.
+  float splatRadius = 0.f;
+
+  /// Ovals whose smaller radius is less than this, and that aren't
+  /// splatted, are not swept either.  The sweep has no roots for them on
+  /// most lines and computes every pixel of their bounds from distances.
+  /// Instead, they are cut into a few strips along their long axis and
+  /// each strip is drawn as a line that carries the area of the strip, so
+  /// only the pixels within about a pixel of the axis are touched.  They
+  /// are combined with the other ovals the same way as the splats.  Zero
+  /// disables this.
+  float needleRadius = 0.f;
+
+  /// When given, this flag is checked after each scanline, and once it is
+  /// set the rasterizer stops and returns the runs it has so far.  This is
+  /// meant for renders on another thread that have become stale, the runs
+  /// that are returned after a cancel are incomplete.
+  const std::atomic< bool > *cancel = nullptr;
+
+  /// When given, this is filled in with the statistics of the call.
+  rasterStats *stats = nullptr;
+
+  /// When given, this is filled in with where the runs of each line of the
+  /// clip rectangle start.  It is recorded as the lines are swept.  The
+  /// index only allocates when it has less room than there are lines.
+  rowIndex *rows = nullptr;
+
+  /// When given, the temporaries of the call are allocated from this
+  /// resource instead of the heap, such as a `rasterArena` that is reset
+  /// after each frame.
+  std::pmr::memory_resource *memory = nullptr;
+ };
+
 /// \fn ovalListToRaster
 /// \description This routine takes a list of ovals and generates the corresponding list of
 ///     pixels runs that would be required to blit the oval into a frame buffer with the
@@ -34,6 +194,148 @@ struct pixelRun
 /// \returns a list of pixel runs.  The method will throw if there is an error.
 std::vector< pixelRun > ovalListToRaster( const std::vector< ovalRecord >& ol, int width, int height );
 
+/// \fn ovalListToRaster
+/// \description Same as above, but takes the ovals as a plain array so that
+///     ovals that live in a memory-mapped file can be rasterized without
+///     copying them into a vector first.
+std::vector< pixelRun > ovalListToRaster( const ovalRecord *ol, size_t count, int width, int height );
+
+/// \fn ovalListToRaster
+/// \description Rasterize only the part of the ovals that falls inside the
+///     clip rectangle ( x0, y0, x1, y1 ), which can have any origin.  The runs
+///     use the same coordinates as the ovals.  Ovals whose bounds don't touch
+///     the rectangle are dropped before the sweep, so rendering a small window
+///     of a large scene costs about as much as the window's own content.
+std::vector< pixelRun > ovalListToRaster( const std::vector< ovalRecord >& ol, int x0, int y0, int x1, int y1 );
+
+std::vector< pixelRun > ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1 );
+
+/// \fn ovalListToRaster
+/// \description Same as above, with options that change how the ovals are
+///     rasterized.
+std::vector< pixelRun > ovalListToRaster( const std::vector< ovalRecord >& ol, int x0, int y0, int x1, int y1,
+                                          const rasterOptions& options );
+
+std::vector< pixelRun > ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1,
+                                          const rasterOptions& options );
+
+/// \fn ovalListToRaster
+/// \description Same as above, with the runs stored in `runs`, which are
+///     replaced.  The runs are allocated with the allocator of `runs` and
+///     everything else with `options.memory`, so when both are an arena the
+///     call does not allocate from the heap.
+void ovalListToRaster( const ovalRecord *ol, size_t count, int x0, int y0, int x1, int y1,
+                       const rasterOptions& options, std::pmr::vector< pixelRun >& runs );
+
+/// \fn indexRows
+/// \description Find where the runs of each of the lines from y0 up to y1
+///     start, for runs that were not made with `rasterOptions::rows`.
+/// \param runs Runs sorted by line, as returned by `ovalListToRaster`
+void indexRows( const std::vector< pixelRun >& runs, int y0, int y1, rowIndex& rows );
+
+void indexRows( const pixelRun *runs, size_t count, int y0, int y1, rowIndex& rows );
+
+/// \fn splitRuns
+/// \description Split a list of runs into at most `chunks` pieces with about
+///     the same number of runs in each.  The pieces are cut between lines,
+///     so threads that each composite one piece never write the same line.
+/// \returns The pieces in order of their lines, none of them empty
+std::vector< runChunk > splitRuns( const rowIndex& rows, size_t chunks );
+
+/// \fn runsToRects
+/// \description Merge the runs that are the same on consecutive lines into
+///     rectangles.  A run only joins the rectangle right above it when both
+///     of its ends and its value are the same.
+/// \param runs Runs sorted by line and then by x, as returned by
+///     `ovalListToRaster`
+/// \returns The rectangles sorted by their first line and then by x
+std::vector< pixelRect > runsToRects( const std::vector< pixelRun >& runs );
+
+/// \fn ovalListToRects
+/// \description Same as `ovalListToRaster`, with the runs merged into
+///     rectangles for the consumers that can fill them.
+std::vector< pixelRect > ovalListToRects( const std::vector< ovalRecord >& ol, int x0, int y0, int x1, int y1,
+                                          const rasterOptions& options = rasterOptions() );
+
+/// For canvases that are too large for `int` pixel coordinates, or for float
+/// centers to be exact, the center of an oval is a double and the runs use
+/// 64-bit coordinates.
+
+struct largeOvalRecord
+ {
+  double centerx;  /// The x-coordinate for the center position
+  double centery;  /// The y-coordinate for the center position
+  float radiusx;   /// The radius along the x-axis before rotation
+  float radiusy;   /// The radius along the y-axis before rotation
+  float angle;     /// The counter-clockwise angle of rotation in radians.
+ };
+
+struct largePixelRun
+ {
+  int64_t lineY;
+  int64_t startX;
+  int64_t endX;
+  float value;
+ };
+
+/// \fn largeOvalListToRaster
+/// \description Rasterize ovals into a frame buffer with the dimensions
+///     ( 0, 0, width, height ), where the dimensions can be larger than 2^31.
+///     The canvas is rasterized one tile at a time, with the ovals moved to
+///     the origin of each tile, so the sweep stays in single precision.  Only
+///     the tiles that are touched by an oval are visited.
+/// \param tileSize The width and height of the tiles in pixels
+/// \returns a list of pixel runs.  The method will throw if there is an error.
+std::vector< largePixelRun > largeOvalListToRaster( const std::vector< largeOvalRecord >& ol,
+                                                    int64_t width, int64_t height, int tileSize = 1024 );
+
+/// \fn ovalBounds
+/// \description Compute the axis aligned bounding box of a rotated oval.
+floatBounds ovalBounds( const ovalRecord& oval );
+
+/// \fn ovalContainsPoint
+/// \description Exact test of whether a point is inside of an oval.
+bool ovalContainsPoint( const ovalRecord& oval, float xx, float yy );
+
+/** ----------------------------------------------------------------------------
+  \class ovalStreamRasterizer
+  \description Rasterizes ovals that arrive in order of the top of their
+      bounds (see `ovalBounds`).  Scanlines are rasterized as soon as no oval
+      that is still to come can touch them, and the ovals that end above the
+      scanlines that remain are dropped, so the memory used is bounded by the
+      ovals that are active at any one time rather than by the whole scene.
+      The runs are the same as the ones returned by `ovalListToRaster`.
+---------------------------------------------------------------------------- */
+class ovalStreamRasterizer
+  {
+    public:
+      ovalStreamRasterizer( int width, int height );
+
+      /// Add the next oval.  This will throw if the ovals are out of order.
+      void addOval( const ovalRecord& oval );
+
+      /// Rasterize the scanlines that remain once all the ovals are added.
+      void finish();
+
+      /// Move the runs of the finished scanlines into the given list.
+      void takeRuns( std::vector< pixelRun > *runs );
+
+      size_t activeCount() const { return active_.size(); }
+      int finishedY() const { return nextY_; }
+
+    private:
+      void emitRows( int endY );
+
+      int width_;
+      int height_;
+      int nextY_;         /// The first scanline that has not been rasterized
+      float lastTop_;     /// The top of the last oval, to check the order
+
+      std::vector< ovalRecord > active_;
+      std::pmr::vector< floatBounds > blist_;
+      std::vector< pixelRun > runs_;
+  };
+
 /// \fn deduplicateOvalList
 /// \description This routine will remove ovals that ovelap by more than 90%
 ///     when drawn.  When deciding which oval to remove, the routine will
@@ -42,7 +344,10 @@ std::vector< pixelRun > ovalListToRaster( const std::vector< ovalRecord >& ol, i
 ///  \param cover_limit A value between greater than 0 and less than 1. that
 ///      specifies the limit above which an oval should be removed from the
 ///      list.
+///  \param memory Where the temporaries are allocated, the heap when null.
+///      The list itself only gets shorter, so it is not reallocated.
 /// \returns The number of ovals that were removed
-int deduplicateOvalList( std::vector< ovalRecord >& ol, float cover_limit = .95f );
+int deduplicateOvalList( std::vector< ovalRecord >& ol, float cover_limit = .95f,
+                         std::pmr::memory_resource *memory = nullptr );
 
 #endif //OVALRASTERIZER_H
@@ -0,0 +1,290 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalReference.cpp
+* \description This file contains the supersampling rasterizer that is the
+*   reference for the accuracy of the real one.  It is meant to be obviously
+*   right rather than fast.
+---------------------------------------------------------------------------- */
+
+#include "ovalReference.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iso646.h>
+#include <stdexcept>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#endif
+
+/// The terms of the inside test that don't depend on the sample
+struct referenceOval
+ {
+  double centerx;
+  double centery;
+  double cosT;
+  double sinT;
+  double rx2;
+  double ry2;
+  int top;
+  int bottom;
+  int left;
+  int right;
+ };
+
+/** ---------------------------------------------------------------------------
+* \fn sample_inside
+* \description The implicit equation of the ellipse in the frame of the oval,
+*     written like `ovalContainsPoint` so that flat ovals contain nothing.
+---------------------------------------------------------------------------- */
+static bool sample_inside( const referenceOval& oval, double xx, double yy )
+{
+  double dx = xx - oval.centerx;
+  double dy = yy - oval.centery;
+
+  double uu = oval.cosT * dx + oval.sinT * dy;
+  double vv = oval.cosT * dy - oval.sinT * dx;
+
+  return uu * uu * oval.ry2 + vv * vv * oval.rx2 <= oval.rx2 * oval.ry2 and 0. < oval.rx2 * oval.ry2;
+}
+/** ---------------------------------------------------------------------------
+* \fn referenceCoverage
+* \description The ovals are sorted by the top of their bounds and the image
+*   is built one line at a time.  Each line keeps a count of the ovals that
+*   hold each of its samples, and the counts are reduced to a coverage at the
+*   end of the line.
+---------------------------------------------------------------------------- */
+std::vector< float > referenceCoverage( const std::vector< ovalRecord >& ol, int width, int height,
+                                        int samples, coverageMode coverage )
+{
+  if( width < 0 or height < 0 or samples < 1 or 256 < samples )
+    {
+      throw std::invalid_argument( "referenceCoverage: invalid size or sample count" );
+    }
+
+  std::vector< referenceOval > rlist;
+  rlist.reserve( ol.size() );
+
+  for( const auto& one : ol )
+    {
+      floatBounds bb = ovalBounds( one );
+
+      int top = std::max( 0, (int) std::floor( bb.top ) );
+      int bottom = std::min( height, (int) std::floor( bb.bottom ) + 1 );
+      int left = std::max( 0, (int) std::floor( bb.left ) );
+      int right = std::min( width, (int) std::floor( bb.right ) + 1 );
+
+      if( top < bottom and left < right )
+        {
+          rlist.push_back( {
+              one.centerx,
+              one.centery,
+              std::cos( (double) one.angle ),
+              std::sin( (double) one.angle ),
+              (double) one.radiusx * one.radiusx,
+              (double) one.radiusy * one.radiusy,
+              top, bottom, left, right
+            } );
+        }
+    }
+
+  std::sort( rlist.begin(), rlist.end(),
+             []( const referenceOval& a, const referenceOval& b ) { return a.top < b.top; } );
+
+  std::vector< float > img( (size_t) width * height, 0.f );
+  std::vector< uint16_t > hits( (size_t) width * samples * samples );
+  std::vector< const referenceOval* > active;
+
+  double step = 1. / samples;
+  double scale = 1. / ( samples * samples );
+  size_t next = 0;
+
+  for( int yy = 0; yy < height; yy += 1 )
+    {
+      while( next < rlist.size() and rlist[ next ].top <= yy )
+        {
+          active.push_back( & rlist[ next ] );
+          next += 1;
+        }
+
+      active.erase( std::remove_if( active.begin(), active.end(),
+                                    [yy]( const referenceOval *one ) { return one->bottom <= yy; } ),
+                    active.end() );
+
+      if( active.empty() )
+        continue;
+
+      std::fill( hits.begin(), hits.end(), 0 );
+
+      for( const auto *one : active )
+        {
+          for( int xx = one->left; xx < one->right; xx += 1 )
+            {
+              uint16_t *pixel = & hits[ (size_t) xx * samples * samples ];
+
+              for( int sy = 0; sy < samples; sy += 1 )
+                {
+                  for( int sx = 0; sx < samples; sx += 1 )
+                    {
+                      if( sample_inside( *one, xx + ( sx + 0.5 ) * step, yy + ( sy + 0.5 ) * step ) )
+                        pixel[ sy * samples + sx ] += 1;
+                    }
+                }
+            }
+        }
+
+      float *line = & img[ (size_t) yy * width ];
+
+      for( int xx = 0; xx < width; xx += 1 )
+        {
+          const uint16_t *pixel = & hits[ (size_t) xx * samples * samples ];
+          size_t count = 0;
+
+          for( int ss = 0; ss < samples * samples; ss += 1 )
+            {
+              if( coverage == coverageMode::accumulate )
+                count += pixel[ ss ];
+              else if( 0 < pixel[ ss ] )
+                count += 1;
+            }
+
+          line[ xx ] = (float) ( count * scale );
+        }
+    }
+
+  return img;
+}
+/** ---------------------------------------------------------------------------
+* \fn runsToCoverage
+---------------------------------------------------------------------------- */
+std::vector< float > runsToCoverage( const std::vector< pixelRun >& runs, int width, int height )
+{
+  std::vector< float > img( (size_t) std::max( 0, width ) * std::max( 0, height ), 0.f );
+
+  for( const auto& one : runs )
+    {
+      if( 0 <= one.lineY and one.lineY < height )
+        {
+          for( int xx = std::max( one.startX, 0 ); xx < std::min( one.endX, width ); xx += 1 )
+            {
+              img[ (size_t) one.lineY * width + xx ] = one.value;
+            }
+        }
+    }
+
+  return img;
+}
+/** ---------------------------------------------------------------------------
+* \fn compareCoverage
+---------------------------------------------------------------------------- */
+coverageError compareCoverage( const std::vector< float >& image, const std::vector< float >& reference,
+                               float tolerance )
+{
+  if( image.size() != reference.size() )
+    {
+      throw std::invalid_argument( "compareCoverage: the images are not the same size" );
+    }
+
+  coverageError err;
+  double sum = 0.;
+  double mass = 0.;
+  double refmass = 0.;
+
+  for( size_t ii = 0; ii < image.size(); ii += 1 )
+    {
+      mass += image[ ii ];
+      refmass += reference[ ii ];
+
+      if( image[ ii ] != 0.f or reference[ ii ] != 0.f )
+        {
+          float diff = std::fabs( image[ ii ] - reference[ ii ] );
+
+          err.maxError = std::max( err.maxError, diff );
+          err.pixelCount += 1;
+          sum += diff;
+
+          if( tolerance < diff )
+            err.badPixelCount += 1;
+        }
+    }
+
+  if( 0 < err.pixelCount )
+    err.meanError = sum / err.pixelCount;
+
+  if( 0. < refmass )
+    err.massError = ( mass - refmass ) / refmass;
+  else
+    err.massError = mass;
+
+  return err;
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalReference_UnitTests");
+TEST_CASE( "Reference Area" )
+{
+  std::vector< ovalRecord > ol = { { 50.f, 50.f, 30.f, 12.f, 0.6f } };
+
+  auto img = referenceCoverage( ol, 100, 100 );
+
+  double mass = 0.;
+
+  for( float vv : img )
+    {
+      CHECK( 0.f <= vv );
+      CHECK( vv <= 1.f );
+      mass += vv;
+    }
+
+  CHECK( mass == doctest::Approx( M_PI * 30. * 12. ).epsilon( 0.001 ) );
+
+  // Pixels well inside and well outside of the oval
+
+  CHECK( img[ 50 * 100 + 50 ] == 1.f );
+  CHECK( img[ 2 * 100 + 2 ] == 0.f );
+}
+TEST_CASE( "Reference Modes" )
+{
+  std::vector< ovalRecord > ol = {
+      { 10.f, 10.f, 6.f, 6.f, 0.f },
+      { 10.f, 10.f, 6.f, 6.f, 0.f },
+      { 30.f, 10.f, 4.f, 0.f, 0.f },
+    };
+
+  auto unite = referenceCoverage( ol, 40, 20, 8 );
+  auto sum = referenceCoverage( ol, 40, 20, 8, coverageMode::accumulate );
+
+  CHECK( unite[ 10 * 40 + 10 ] == 1.f );
+  CHECK( sum[ 10 * 40 + 10 ] == 2.f );
+
+  // The flat oval is not drawn
+
+  CHECK( unite[ 10 * 40 + 30 ] == 0.f );
+
+  CHECK_THROWS( referenceCoverage( ol, 40, 20, 0 ) );
+}
+TEST_CASE( "Compare Coverage" )
+{
+  std::vector< float > ref = { 0.f, 0.5f, 1.f, 1.f };
+  std::vector< float > img = { 0.f, 0.25f, 1.f, 0.f };
+
+  auto err = compareCoverage( img, ref );
+
+  CHECK( err.maxError == 1.f );
+  CHECK( err.pixelCount == 3 );
+  CHECK( err.badPixelCount == 2 );
+  CHECK( err.meanError == doctest::Approx( 1.25 / 3. ) );
+  CHECK( err.massError == doctest::Approx( -0.5 ) );
+
+  CHECK_THROWS( compareCoverage( img, std::vector< float >( 3 ) ) );
+
+  std::vector< pixelRun > runs = { { 1, -2, 1, 0.5f }, { 5, 0, 2, 1.f } };
+
+  auto cov = runsToCoverage( runs, 2, 2 );
+
+  CHECK( cov == std::vector< float >{ 0.f, 0.f, 0.5f, 0.f } );
+}
+TEST_SUITE_END();
+#endif
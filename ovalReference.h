@@ -0,0 +1,51 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalReference.h
+ * \description This file contains a slow and simple rasterizer that is used
+ *   as the reference when measuring the error of the real one
+---------------------------------------------------------------------------- */
+
+#ifndef OVALREFERENCE_H
+#define OVALREFERENCE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// \fn referenceCoverage
+/// \description Rasterize the ovals into a dense image of ( 0, 0, width, height )
+///     by testing samples x N samples on a regular grid inside each pixel.
+///     Each sample is tested against each oval with the implicit equation
+///     in double precision, so apart from the sampling there is no error.
+///     With `unite` a sample counts if it is inside any oval, with
+///     `accumulate` it counts once for each oval that it is inside.
+/// \returns width x height coverage values, one line after the other.  The
+///     method will throw if the arguments are not valid.
+std::vector< float > referenceCoverage( const std::vector< ovalRecord >& ol, int width, int height,
+                                        int samples = 16, coverageMode coverage = coverageMode::unite );
+
+/// \fn runsToCoverage
+/// \description Paint a list of runs into a dense image of ( 0, 0, width, height )
+///     laid out the same way as `referenceCoverage`.  Runs outside of the
+///     image are cut off.
+std::vector< float > runsToCoverage( const std::vector< pixelRun >& runs, int width, int height );
+
+/// How far one image is from a reference image
+
+struct coverageError
+ {
+  float maxError = 0.f;       /// The largest difference of any pixel
+  double meanError = 0.;      /// The mean absolute difference over the pixels that are not zero in either image
+  double massError = 0.;      /// The difference of the sums, relative to the sum of the reference
+  size_t pixelCount = 0;      /// The pixels that are not zero in either image
+  size_t badPixelCount = 0;   /// The pixels that differ by more than the tolerance
+ };
+
+/// \fn compareCoverage
+/// \description Measure the error of an image against a reference of the same size.
+/// \param tolerance Differences up to this are not counted in `badPixelCount`
+coverageError compareCoverage( const std::vector< float >& image, const std::vector< float >& reference,
+                               float tolerance = 1.f / 64.f );
+
+#endif //OVALREFERENCE_H
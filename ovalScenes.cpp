@@ -0,0 +1,200 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalScenes.cpp
+* \description This file contains the code that generates and animates
+*   random scenes of ovals
+---------------------------------------------------------------------------- */
+
+#include "ovalScenes.h"
+#include <algorithm>
+#include <cmath>
+#include <iso646.h>
+#include <random>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#endif
+
+/// How much the radii of an animated oval grow and shrink
+static const float pulse_amplitude = 0.25f;
+
+/** ---------------------------------------------------------------------------
+* \fn randomOvalScene
+---------------------------------------------------------------------------- */
+std::vector< ovalRecord > randomOvalScene( const sceneOptions& options )
+{
+  std::mt19937 gen( options.seed );
+  std::uniform_real_distribution< float > unit( 0.f, 1.f );
+
+  std::vector< ovalRecord > centers;
+
+  for( int ii = 0; ii < options.clusters; ii += 1 )
+    {
+      centers.push_back( { unit( gen ) * options.width, unit( gen ) * options.height, 0.f, 0.f, 0.f } );
+    }
+
+  std::normal_distribution< float > spread( 0.f, options.clusterSpread );
+
+  float logmin = std::log( std::max( options.minRadius, 1e-3f ) );
+  float logmax = std::log( std::max( options.maxRadius, options.minRadius ) );
+
+  std::vector< ovalRecord > ol;
+  ol.reserve( options.count );
+
+  for( int ii = 0; ii < options.count; ii += 1 )
+    {
+      ovalRecord one;
+
+      if( centers.empty() )
+        {
+          one.centerx = unit( gen ) * options.width;
+          one.centery = unit( gen ) * options.height;
+        }
+      else
+        {
+          const ovalRecord& cc = centers[ gen() % centers.size() ];
+
+          one.centerx = std::min( options.width, std::max( 0.f, cc.centerx + spread( gen ) ) );
+          one.centery = std::min( options.height, std::max( 0.f, cc.centery + spread( gen ) ) );
+        }
+
+      one.radiusx = std::exp( logmin + unit( gen ) * ( logmax - logmin ) );
+      one.radiusy = one.radiusx * ( 1.f - options.eccentricity * unit( gen ) );
+      one.angle = unit( gen ) * (float) M_PI;
+
+      ol.push_back( one );
+    }
+
+  return ol;
+}
+/** ----------------------------------------------------------------------------
+  \fn sceneAnimator::sceneAnimator
+---------------------------------------------------------------------------- */
+sceneAnimator::sceneAnimator( const std::vector< ovalRecord >& ol, const sceneOptions& options ) :
+ovals_( ol ), width_( options.width ), height_( options.height )
+{
+  std::mt19937 gen( options.seed + 1 );
+  std::uniform_real_distribution< float > unit( -1.f, 1.f );
+
+  // Things move about a tenth of the scene per second
+
+  float speed = 0.1f * std::max( options.width, options.height );
+
+  motion_.reserve( ol.size() );
+
+  for( const auto& one : ol )
+    {
+      motion_.push_back( {
+          speed * unit( gen ),
+          speed * unit( gen ),
+          (float) M_PI * unit( gen ),
+          2.f * (float) M_PI * unit( gen ),
+          (float) M_PI * unit( gen ),
+          one.radiusx,
+          one.radiusy
+        } );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn sceneAnimator::step
+---------------------------------------------------------------------------- */
+void sceneAnimator::step( float seconds )
+{
+  for( size_t ii = 0; ii < ovals_.size(); ii += 1 )
+    {
+      ovalRecord& one = ovals_[ ii ];
+      motionRecord& mm = motion_[ ii ];
+
+      one.centerx += mm.velx * seconds;
+      one.centery += mm.vely * seconds;
+
+      if( one.centerx < 0.f or width_ < one.centerx )
+        {
+          mm.velx = -mm.velx;
+          one.centerx = std::min( width_, std::max( 0.f, one.centerx ) );
+        }
+
+      if( one.centery < 0.f or height_ < one.centery )
+        {
+          mm.vely = -mm.vely;
+          one.centery = std::min( height_, std::max( 0.f, one.centery ) );
+        }
+
+      one.angle = std::fmod( one.angle + mm.spin * seconds, 2.f * (float) M_PI );
+
+      mm.phase = std::fmod( mm.phase + mm.pulse * seconds, 2.f * (float) M_PI );
+
+      float scale = 1.f + pulse_amplitude * std::sin( mm.phase );
+
+      one.radiusx = mm.radiusx * scale;
+      one.radiusy = mm.radiusy * scale;
+    }
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalScenes_UnitTests");
+TEST_CASE( "Random Scene" )
+{
+  sceneOptions options;
+  options.count = 500;
+  options.width = 200.f;
+  options.height = 100.f;
+  options.clusters = 3;
+
+  auto one = randomOvalScene( options );
+  auto two = randomOvalScene( options );
+
+  REQUIRE( one.size() == 500 );
+
+  for( int ii = 0; ii < one.size(); ii += 1 )
+    {
+      CHECK( one[ ii ].centerx == two[ ii ].centerx );
+      CHECK( one[ ii ].radiusy == two[ ii ].radiusy );
+
+      CHECK( 0.f <= one[ ii ].centerx );
+      CHECK( one[ ii ].centerx <= 200.f );
+      CHECK( 0.f <= one[ ii ].centery );
+      CHECK( one[ ii ].centery <= 100.f );
+
+      CHECK( options.minRadius * 0.999f <= one[ ii ].radiusx );
+      CHECK( one[ ii ].radiusx <= options.maxRadius * 1.001f );
+      CHECK( one[ ii ].radiusy <= one[ ii ].radiusx );
+      CHECK( ( 1.f - options.eccentricity ) * one[ ii ].radiusx * 0.999f <= one[ ii ].radiusy );
+    }
+
+  options.seed = 2;
+
+  CHECK( randomOvalScene( options )[ 0 ].radiusx != one[ 0 ].radiusx );
+}
+TEST_CASE( "Scene Animator" )
+{
+  sceneOptions options;
+  options.count = 100;
+  options.width = 100.f;
+  options.height = 100.f;
+
+  auto ol = randomOvalScene( options );
+
+  sceneAnimator anim( ol, options );
+
+  for( int ii = 0; ii < 100; ii += 1 )
+    {
+      anim.step( 1.f / 30.f );
+    }
+
+  REQUIRE( anim.ovals().size() == ol.size() );
+
+  for( int ii = 0; ii < ol.size(); ii += 1 )
+    {
+      const ovalRecord& one = anim.ovals()[ ii ];
+
+      CHECK( 0.f <= one.centerx );
+      CHECK( one.centerx <= 100.f );
+      CHECK( one.radiusx <= ol[ ii ].radiusx * ( 1.f + pulse_amplitude ) * 1.001f );
+      CHECK( ol[ ii ].radiusx * ( 1.f - pulse_amplitude ) * 0.999f <= one.radiusx );
+    }
+}
+TEST_SUITE_END();
+#endif
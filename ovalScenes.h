@@ -0,0 +1,80 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalScenes.h
+ * \description This file contains the code that generates and animates
+ *   random scenes of ovals, for stress tests and benchmarks
+---------------------------------------------------------------------------- */
+
+#ifndef OVALSCENES_H
+#define OVALSCENES_H
+
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// The distributions that a random scene is drawn from.  The same options
+/// and seed always give the same scene.
+
+struct sceneOptions
+ {
+  int count = 1000;
+  unsigned seed = 1;
+
+  float width = 1024.f;       /// The ovals are centered inside ( 0, 0, width, height )
+  float height = 1024.f;
+
+  float minRadius = 2.f;      /// The larger radius is drawn log-uniformly from this range
+  float maxRadius = 40.f;
+
+  /// The smaller radius is the larger one times a ratio drawn uniformly from
+  /// ( 1 - eccentricity, 1 ), so zero gives circles and values close to 1
+  /// give needles.
+  float eccentricity = 0.5f;
+
+  /// With no clusters the centers are uniform over the scene.  Otherwise they
+  /// are spread around this many random points with the given standard
+  /// deviation, which controls how much the ovals overlap.
+  int clusters = 0;
+  float clusterSpread = 50.f;
+ };
+
+/// \fn randomOvalScene
+/// \description Generate a scene of random ovals.
+std::vector< ovalRecord > randomOvalScene( const sceneOptions& options );
+
+/** ----------------------------------------------------------------------------
+  \class sceneAnimator
+  \description Moves, rotates and scales the ovals of a scene over time.  Each
+      oval gets a random velocity, spin and pulse when the animator is made.
+      The ovals bounce off the sides of the scene.
+---------------------------------------------------------------------------- */
+class sceneAnimator
+  {
+    public:
+      sceneAnimator( const std::vector< ovalRecord >& ol, const sceneOptions& options );
+
+      /// Advance the animation by the given number of seconds
+      void step( float seconds );
+
+      const std::vector< ovalRecord >& ovals() const { return ovals_; }
+
+    private:
+      struct motionRecord
+        {
+          float velx;
+          float vely;
+          float spin;       /// Radians per second
+          float pulse;      /// Radians per second of the phase of the scale
+          float phase;
+          float radiusx;    /// The radii at a scale of 1
+          float radiusy;
+        };
+
+      std::vector< ovalRecord > ovals_;
+      std::vector< motionRecord > motion_;
+
+      float width_;
+      float height_;
+  };
+
+#endif //OVALSCENES_H
@@ -0,0 +1,417 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalStamp.cpp
+* \description This file contains the code that rasterizes many copies of
+*   the same oval, such as the markers of a scatter plot
+---------------------------------------------------------------------------- */
+
+#include "ovalStamp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iso646.h>
+#include <unordered_map>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include "ovalReference.h"
+#endif
+
+/// The shape rasterized at one phase, with its runs relative to the whole
+/// pixel of the center and indexed by row
+struct stampMask
+ {
+  int top = 0;                      /// The first row
+  std::vector< size_t > rowStart;   /// Where the runs of each row start, and one past the last row
+  std::vector< pixelRun > runs;
+ };
+
+/// One copy of the shape, placed
+struct stampPlace
+ {
+  int ix;      /// The whole pixel of the center
+  int iy;
+  int top;     /// The first and one past the last line that it covers
+  int bottom;
+  const stampMask *mask;
+ };
+
+/** ---------------------------------------------------------------------------
+* \fn roundToPhase
+---------------------------------------------------------------------------- */
+stampPhase roundToPhase( float centerx, float centery, int phases )
+{
+  float fx = std::floor( centerx );
+  float fy = std::floor( centery );
+
+  stampPhase sp;
+  sp.ix = (int) fx;
+  sp.iy = (int) fy;
+  sp.phasex = (int) std::lround( ( centerx - fx ) * phases );
+  sp.phasey = (int) std::lround( ( centery - fy ) * phases );
+
+  if( sp.phasex == phases )
+    {
+      sp.phasex = 0;
+      sp.ix += 1;
+    }
+
+  if( sp.phasey == phases )
+    {
+      sp.phasey = 0;
+      sp.iy += 1;
+    }
+
+  return sp;
+}
+/** ---------------------------------------------------------------------------
+* \fn rasterizeAtPhase
+---------------------------------------------------------------------------- */
+std::vector< pixelRun > rasterizeAtPhase( const ovalRecord& shape, int phasex, int phasey, int phases,
+                                          int *top, int *bottom )
+{
+  ovalRecord local = shape;
+  local.centerx = (float) phasex / phases;
+  local.centery = (float) phasey / phases;
+
+  floatBounds bb = ovalBounds( local );
+
+  int y0 = (int) std::floor( bb.top );
+  int y1 = (int) std::ceil( bb.bottom ) + 1;
+
+  if( top )
+    *top = y0;
+
+  if( bottom )
+    *bottom = y1;
+
+  return ovalListToRaster( & local, 1, (int) std::floor( bb.left ), y0, (int) std::ceil( bb.right ) + 1, y1 );
+}
+/** ---------------------------------------------------------------------------
+* \fn make_mask
+* \description Rasterize the shape at one phase and index its runs by row.
+---------------------------------------------------------------------------- */
+static void make_mask( const ovalRecord& shape, int phasex, int phasey, int phases, stampMask& mask )
+{
+  int top;
+  int bottom;
+
+  mask.runs = rasterizeAtPhase( shape, phasex, phasey, phases, & top, & bottom );
+  mask.top = top;
+
+  mask.rowStart.assign( bottom - top + 1, 0 );
+
+  size_t ii = 0;
+
+  for( int row = 0; row <= bottom - top; row += 1 )
+    {
+      while( ii < mask.runs.size() and mask.runs[ ii ].lineY < top + row )
+        {
+          ii += 1;
+        }
+
+      mask.rowStart[ row ] = ii;
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn flush_line
+* \description Turn the coverage of one line into runs and clear it for the
+*     next line.
+---------------------------------------------------------------------------- */
+static void flush_line( std::vector< float >& line, int lo, int hi, int x0, int yy, std::vector< pixelRun >& rr )
+{
+  pixelRun pr;
+  pr.lineY = yy;
+
+  for( int xx = lo; xx < hi; )
+    {
+      float value = line[ xx ];
+      int end = xx + 1;
+
+      while( end < hi and line[ end ] == value )
+        {
+          end += 1;
+        }
+
+      if( 0.f < value )
+        {
+          pr.startX = xx + x0;
+          pr.endX = end + x0;
+          pr.value = value;
+
+          rr.push_back( pr );
+        }
+
+      std::fill( line.begin() + xx, line.begin() + end, 0.f );
+      xx = end;
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalStampToRaster
+* \description Round each center to a phase and find its mask, making the
+*     masks as they are needed.  The masks are kept by phase in a map, since
+*     only the phases that are used are made and there can be far fewer of
+*     them than phases squared.  Then go down the lines keeping the copies
+*     that cover the current line, add the runs of their masks into one
+*     line of coverage and turn the line into runs.
+---------------------------------------------------------------------------- */
+std::vector< pixelRun > ovalStampToRaster( const ovalRecord& shape, const stampCenter *centers, size_t count,
+                                           int x0, int y0, int x1, int y1, const stampOptions& options )
+{
+  std::vector< pixelRun > rr;
+
+  if( x1 <= x0 or y1 <= y0 or count == 0 )
+    {
+      if( options.maskCount )
+        *options.maskCount = 0;
+
+      return rr;
+    }
+
+  int phases = std::max( 1, options.phases );
+  bool accumulate = options.coverage == coverageMode::accumulate;
+
+  ovalRecord origin = shape;
+  origin.centerx = 0.f;
+  origin.centery = 0.f;
+
+  floatBounds extent = ovalBounds( origin );
+
+  std::unordered_map< int64_t, stampMask > masks;
+  std::vector< stampPlace > places;
+
+  places.reserve( count );
+
+  for( size_t ii = 0; ii < count; ii += 1 )
+    {
+      float cx = centers[ ii ].centerx;
+      float cy = centers[ ii ].centery;
+
+      if( cx + extent.right < x0 or x1 < cx + extent.left or cy + extent.bottom < y0 or y1 < cy + extent.top )
+        continue;
+
+      stampPhase sp = roundToPhase( cx, cy, phases );
+
+      stampPlace place;
+      place.ix = sp.ix;
+      place.iy = sp.iy;
+
+      auto found = masks.try_emplace( (int64_t) sp.phasey * phases + sp.phasex );
+      stampMask& mask = found.first->second;
+
+      if( found.second )
+        {
+          make_mask( shape, sp.phasex, sp.phasey, phases, mask );
+        }
+
+      place.mask = & mask;
+
+      place.top = std::max( y0, place.iy + mask.top );
+      place.bottom = std::min( y1, place.iy + mask.top + (int) mask.rowStart.size() - 1 );
+
+      if( place.top < place.bottom )
+        {
+          places.push_back( place );
+        }
+    }
+
+  if( options.maskCount )
+    {
+      *options.maskCount = masks.size();
+    }
+
+  std::sort( places.begin(), places.end(), []( const stampPlace& one, const stampPlace& two )
+    {
+      return one.top < two.top;
+    } );
+
+  std::vector< float > line( x1 - x0, 0.f );
+  std::vector< size_t > active;
+  size_t next = 0;
+
+  for( int yy = y0; yy < y1; yy += 1 )
+    {
+      if( active.empty() )
+        {
+          if( next == places.size() )
+            break;
+
+          yy = std::max( yy, places[ next ].top );
+        }
+
+      while( next < places.size() and places[ next ].top <= yy )
+        {
+          active.push_back( next );
+          next += 1;
+        }
+
+      int lo = x1 - x0;
+      int hi = 0;
+      size_t kept = 0;
+
+      for( size_t aa = 0; aa < active.size(); aa += 1 )
+        {
+          const stampPlace& place = places[ active[ aa ] ];
+
+          if( place.bottom <= yy )
+            continue;
+
+          active[ kept ] = active[ aa ];
+          kept += 1;
+
+          const stampMask& mask = *place.mask;
+          int row = yy - place.iy - mask.top;
+
+          for( size_t rn = mask.rowStart[ row ]; rn < mask.rowStart[ row + 1 ]; rn += 1 )
+            {
+              const pixelRun& pr = mask.runs[ rn ];
+
+              int start = std::max( pr.startX + place.ix, x0 ) - x0;
+              int end = std::min( pr.endX + place.ix, x1 ) - x0;
+
+              if( end <= start )
+                continue;
+
+              lo = std::min( lo, start );
+              hi = std::max( hi, end );
+
+              float value = pr.value;
+              float *px = line.data() + start;
+              float *stop = line.data() + end;
+
+              if( accumulate )
+                {
+                  for( ; px < stop; px += 1 )
+                    *px += value;
+                }
+              else if( 1.f <= value )
+                {
+                  std::fill( px, stop, 1.f );
+                }
+              else
+                {
+                  for( ; px < stop; px += 1 )
+                    *px = uniteCoverage( *px, value );
+                }
+            }
+        }
+
+      active.resize( kept );
+
+      flush_line( line, lo, hi, x0, yy, rr );
+    }
+
+  return rr;
+}
+/** ---------------------------------------------------------------------------
+* \fn ovalStampToRaster
+---------------------------------------------------------------------------- */
+std::vector< pixelRun > ovalStampToRaster( const ovalRecord& shape, const std::vector< stampCenter >& centers,
+                                           int x0, int y0, int x1, int y1, const stampOptions& options )
+{
+  return ovalStampToRaster( shape, centers.data(), centers.size(), x0, y0, x1, y1, options );
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalStamp_UnitTests");
+TEST_CASE( "Stamp One Copy" )
+{
+  ovalRecord shape = { 0.f, 0.f, 6.5f, 3.f, 0.7f };
+
+  // A center on a phase gives the same runs as rasterizing the oval
+
+  for( stampCenter center : { stampCenter{ 20.f, 15.f }, stampCenter{ 31.25f, 7.5f }, stampCenter{ 2.f, 38.0625f } } )
+    {
+      ovalRecord oval = shape;
+      oval.centerx = center.centerx;
+      oval.centery = center.centery;
+
+      auto expected = ovalListToRaster( { oval }, 40, 40 );
+      auto stamped = ovalStampToRaster( shape, { center }, 0, 0, 40, 40 );
+
+      REQUIRE( stamped.size() == expected.size() );
+
+      for( size_t ii = 0; ii < stamped.size(); ii += 1 )
+        {
+          CHECK( stamped[ ii ].lineY == expected[ ii ].lineY );
+          CHECK( stamped[ ii ].startX == expected[ ii ].startX );
+          CHECK( stamped[ ii ].endX == expected[ ii ].endX );
+          CHECK( stamped[ ii ].value == expected[ ii ].value );
+        }
+    }
+}
+TEST_CASE( "Stamp Many Copies" )
+{
+  ovalRecord shape = { 0.f, 0.f, 3.f, 2.f, 0.3f };
+
+  std::vector< stampCenter > centers;
+  std::vector< ovalRecord > ol;
+
+  for( int ii = 0; ii < 200; ii += 1 )
+    {
+      stampCenter center = { 4.f + ( ii * 37 % 113 ) * 0.5f, 4.f + ( ii * 53 % 97 ) * 0.5f };
+
+      centers.push_back( center );
+      ol.push_back( { center.centerx, center.centery, shape.radiusx, shape.radiusy, shape.angle } );
+    }
+
+  size_t masks = 0;
+  stampOptions options;
+  options.maskCount = & masks;
+
+  auto unite = ovalStampToRaster( shape, centers, 0, 0, 64, 64, options );
+
+  CHECK( masks == 4 );    // the centers are on whole and half pixels
+
+  for( size_t ii = 1; ii < unite.size(); ii += 1 )
+    {
+      CHECK( unite[ ii ].value <= 1.f );
+      CHECK( ( unite[ ii - 1 ].lineY < unite[ ii ].lineY or unite[ ii - 1 ].endX <= unite[ ii ].startX ) );
+    }
+
+  auto err = compareCoverage( runsToCoverage( unite, 64, 64 ), referenceCoverage( ol, 64, 64, 8 ) );
+
+  // The copies overlap a lot, and where the edges of two copies share a
+  // pixel the product of their coverage is only an estimate of the union
+
+  CHECK( err.meanError < 0.02 );
+  CHECK( std::fabs( err.massError ) < 0.02 );
+
+  options.coverage = coverageMode::accumulate;
+
+  rasterOptions ro;
+  ro.coverage = coverageMode::accumulate;
+
+  auto sum = ovalStampToRaster( shape, centers, 0, 0, 64, 64, options );
+  auto expected = ovalListToRaster( ol, 0, 0, 64, 64, ro );
+
+  err = compareCoverage( runsToCoverage( sum, 64, 64 ), runsToCoverage( expected, 64, 64 ) );
+
+  CHECK( err.maxError < 1e-4f );
+
+  // Only the phases that are used are made, however fine they are
+
+  options.coverage = coverageMode::unite;
+  options.phases = 1 << 20;
+
+  auto fine = ovalStampToRaster( shape, centers, 0, 0, 64, 64, options );
+
+  CHECK( masks == 4 );
+  CHECK( runsToCoverage( fine, 64, 64 ) == runsToCoverage( unite, 64, 64 ) );
+
+  // Clipped to the rectangle
+
+  for( const auto& one : ovalStampToRaster( shape, centers, 10, 20, 30, 25 ) )
+    {
+      CHECK( 10 <= one.startX );
+      CHECK( one.endX <= 30 );
+      CHECK( 20 <= one.lineY );
+      CHECK( one.lineY < 25 );
+    }
+
+  CHECK( ovalStampToRaster( shape, centers, 0, 0, 0, 64 ).empty() );
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,78 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalStamp.h
+ * \description This file contains the code that rasterizes many copies of
+ *   the same oval, such as the markers of a scatter plot
+---------------------------------------------------------------------------- */
+
+#ifndef OVALSTAMP_H
+#define OVALSTAMP_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// Where one copy of the shape goes
+struct stampCenter
+ {
+  float centerx;
+  float centery;
+ };
+
+/// A center rounded to a phase: the whole pixel that the shape is placed at
+/// and the fraction of a pixel of its center, in 1 / phases
+struct stampPhase
+ {
+  int ix;
+  int iy;
+  int phasex;
+  int phasey;
+ };
+
+/// \fn roundToPhase
+/// \description Round the center to 1 / `phases` of a pixel.  A fraction
+///     that rounds up to a whole pixel is phase 0 of the next pixel.
+stampPhase roundToPhase( float centerx, float centery, int phases );
+
+/// \fn rasterizeAtPhase
+/// \description Rasterize the shape with its center at ( phasex, phasey ) /
+///     `phases` within the pixel at the origin, so that the runs are relative
+///     to the whole pixel of a center with that phase.  The center of
+///     `shape` is ignored.  When given, `top` and `bottom` are set to the
+///     first and one past the last line that the runs can be on.
+std::vector< pixelRun > rasterizeAtPhase( const ovalRecord& shape, int phasex, int phasey, int phases,
+                                          int *top = nullptr, int *bottom = nullptr );
+
+/// How to stamp the shape
+struct stampOptions
+ {
+  /// How overlapping copies are combined.  With `unite` the coverage is
+  /// 1 - ( 1 - a ) * ( 1 - b ), with `accumulate` it is a + b.
+  coverageMode coverage = coverageMode::unite;
+
+  /// The centers are rounded to 1 / `phases` of a pixel and the shape is
+  /// rasterized once for each rounded fraction that is used, so a copy is
+  /// off by at most half of 1 / `phases` of a pixel.
+  int phases = 16;
+
+  /// When this is not null, the number of shapes that were rasterized is
+  /// stored in it.
+  size_t *maskCount = nullptr;
+ };
+
+/// \fn ovalStampToRaster
+/// \description Rasterize a copy of `shape` at each of the centers into the
+///     rectangle ( x0, y0, x1, y1 ).  The center of `shape` is ignored.
+///     The shape is rasterized only once per phase and then copied, so the
+///     time goes into writing the pixels rather than into finding edges.
+/// \returns The runs in order of their lines and then of their starts
+std::vector< pixelRun > ovalStampToRaster( const ovalRecord& shape, const stampCenter *centers, size_t count,
+                                           int x0, int y0, int x1, int y1,
+                                           const stampOptions& options = stampOptions() );
+
+std::vector< pixelRun > ovalStampToRaster( const ovalRecord& shape, const std::vector< stampCenter >& centers,
+                                           int x0, int y0, int x1, int y1,
+                                           const stampOptions& options = stampOptions() );
+
+#endif //OVALSTAMP_H
@@ -0,0 +1,337 @@
+/** ---------------------------------------------------------------------------
+*
+* \file ovalTrace.cpp
+* \description This file contains a recorder of timed spans that is written
+*   as Chrome trace-event JSON
+---------------------------------------------------------------------------- */
+
+#include "ovalTrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <iso646.h>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include <thread>
+#endif
+
+std::atomic< bool > traceRecording( false );
+
+/// One span as it was recorded
+struct traceEvent
+ {
+  const char *name;
+  const char *category;
+  int thread;
+  traceClock::time_point begin;
+  traceClock::time_point end;
+  int count;
+  traceArg args[ traceSpan::maxArgs ];
+ };
+
+/// Everything that is shared between the threads that record spans
+struct traceLog
+ {
+  std::mutex mutex;
+  std::vector< traceEvent > events;
+  std::map< int, std::string > threadNames;
+  size_t maxEvents = 0;
+  size_t dropped = 0;
+  int threads = 0;
+  traceClock::time_point origin = traceClock::now();
+ };
+
+static traceLog& trace_log()
+{
+  static traceLog log;
+  return log;
+}
+/** ---------------------------------------------------------------------------
+* \fn trace_thread
+* \description A small number for the calling thread, given out the first
+*     time that the thread records something.  Must be called with the lock.
+---------------------------------------------------------------------------- */
+static int trace_thread( traceLog& log )
+{
+  thread_local int thread = 0;
+
+  if( thread == 0 )
+    {
+      log.threads += 1;
+      thread = log.threads;
+    }
+
+  return thread;
+}
+/** ---------------------------------------------------------------------------
+* \fn traceStart
+---------------------------------------------------------------------------- */
+void traceStart( size_t maxEvents )
+{
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  log.events.clear();
+  log.maxEvents = maxEvents;
+  log.dropped = 0;
+  log.origin = traceClock::now();
+
+  traceRecording.store( true );
+}
+/** ---------------------------------------------------------------------------
+* \fn traceStop
+---------------------------------------------------------------------------- */
+void traceStop()
+{
+  traceRecording.store( false );
+}
+/** ---------------------------------------------------------------------------
+* \fn traceEventCount
+---------------------------------------------------------------------------- */
+size_t traceEventCount()
+{
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  return log.events.size();
+}
+/** ---------------------------------------------------------------------------
+* \fn traceDroppedCount
+---------------------------------------------------------------------------- */
+size_t traceDroppedCount()
+{
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  return log.dropped;
+}
+/** ---------------------------------------------------------------------------
+* \fn traceComplete
+* \description The spans are short and few, one per stage or band of
+*     scanlines, so one lock for all the threads is enough.
+---------------------------------------------------------------------------- */
+void traceComplete( const char *name, const char *category,
+                    traceClock::time_point begin, traceClock::time_point end,
+                    const traceArg *args, int count )
+{
+  if( not traceEnabled() )
+    return;
+
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  if( log.maxEvents <= log.events.size() )
+    {
+      log.dropped += 1;
+      return;
+    }
+
+  traceEvent ev;
+  ev.name = name;
+  ev.category = category;
+  ev.thread = trace_thread( log );
+  ev.begin = begin;
+  ev.end = end;
+  ev.count = std::min( std::max( count, 0 ), (int) traceSpan::maxArgs );
+
+  for( int ii = 0; ii < ev.count; ii += 1 )
+    {
+      ev.args[ ii ] = args[ ii ];
+    }
+
+  log.events.push_back( ev );
+}
+/** ---------------------------------------------------------------------------
+* \fn traceThreadName
+---------------------------------------------------------------------------- */
+void traceThreadName( const char *name )
+{
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  log.threadNames[ trace_thread( log ) ] = name;
+}
+/** ---------------------------------------------------------------------------
+* \fn append_string
+* \description Append a JSON string, escaping what needs to be escaped.
+---------------------------------------------------------------------------- */
+static void append_string( std::string& json, const char *text )
+{
+  json += '"';
+
+  for( const char *cc = text; *cc; cc += 1 )
+    {
+      if( *cc == '"' or *cc == '\\' )
+        {
+          json += '\\';
+          json += *cc;
+        }
+      else if( (unsigned char) *cc < 0x20 )
+        {
+          char code[ 8 ];
+          snprintf( code, sizeof( code ), "\\u%04x", (unsigned char) *cc );
+          json += code;
+        }
+      else
+        {
+          json += *cc;
+        }
+    }
+
+  json += '"';
+}
+/** ---------------------------------------------------------------------------
+* \fn traceJson
+* \description Each span is a complete ("X") event with its start and length
+*     in microseconds from `traceStart`, and each named thread gets a
+*     "thread_name" metadata event.
+---------------------------------------------------------------------------- */
+std::string traceJson()
+{
+  traceLog& log = trace_log();
+  std::lock_guard< std::mutex > lock( log.mutex );
+
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  char number[ 64 ];
+  bool first = true;
+
+  for( const auto& one : log.threadNames )
+    {
+      json += first ? "\n" : ",\n";
+      first = false;
+
+      snprintf( number, sizeof( number ), "%d", one.first );
+      json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+      json += number;
+      json += ",\"args\":{\"name\":";
+      append_string( json, one.second.c_str() );
+      json += "}}";
+    }
+
+  for( const auto& ev : log.events )
+    {
+      std::chrono::duration< double, std::micro > ts = ev.begin - log.origin;
+      std::chrono::duration< double, std::micro > dur = ev.end - ev.begin;
+
+      json += first ? "\n" : ",\n";
+      first = false;
+
+      json += "{\"name\":";
+      append_string( json, ev.name );
+      json += ",\"cat\":";
+      append_string( json, ev.category );
+
+      snprintf( number, sizeof( number ), ",\"ph\":\"X\",\"pid\":1,\"tid\":%d", ev.thread );
+      json += number;
+      snprintf( number, sizeof( number ), ",\"ts\":%.3f,\"dur\":%.3f", ts.count(), dur.count() );
+      json += number;
+
+      if( 0 < ev.count )
+        {
+          json += ",\"args\":{";
+
+          for( int ii = 0; ii < ev.count; ii += 1 )
+            {
+              if( 0 < ii )
+                json += ',';
+
+              append_string( json, ev.args[ ii ].key );
+              snprintf( number, sizeof( number ), ":%.9g", ev.args[ ii ].value );
+              json += number;
+            }
+
+          json += '}';
+        }
+
+      json += '}';
+    }
+
+  json += "\n]}\n";
+
+  return json;
+}
+/** ---------------------------------------------------------------------------
+* \fn writeTrace
+---------------------------------------------------------------------------- */
+void writeTrace( const char *path )
+{
+  std::string json = traceJson();
+
+  FILE *fp = fopen( path, "w" );
+
+  if( not fp )
+    {
+      throw std::runtime_error( std::string( "unable to create file: " ) + path );
+    }
+
+  size_t written = fwrite( json.data(), 1, json.size(), fp );
+
+  if( fclose( fp ) != 0 or written != json.size() )
+    {
+      throw std::runtime_error( std::string( "unable to write file: " ) + path );
+    }
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "OvalTrace_UnitTests");
+TEST_CASE( "Trace Spans" )
+{
+  traceStop();
+
+  {
+    traceSpan off( "off", "test" );   // not recording, so nothing is kept
+  }
+
+  traceStart( 4 );
+
+  CHECK( traceEventCount() == 0 );
+
+  {
+    traceSpan span( "one", "test" );
+    span.arg( "lines", 32 );
+    span.arg( "quote\"d", 0.5 );
+  }
+
+  std::thread other( [] {
+    traceThreadName( "other" );
+    traceSpan span( "two", "test" );
+  } );
+
+  other.join();
+
+  CHECK( traceEventCount() == 2 );
+
+  for( int ii = 0; ii < 4; ii += 1 )
+    {
+      traceSpan span( "more", "test" );
+    }
+
+  CHECK( traceEventCount() == 4 );
+  CHECK( traceDroppedCount() == 2 );
+
+  traceStop();
+
+  {
+    traceSpan late( "late", "test" );
+  }
+
+  std::string json = traceJson();
+
+  CHECK( traceEventCount() == 4 );
+  CHECK( json.find( "\"traceEvents\":[" ) != std::string::npos );
+  CHECK( json.find( "{\"name\":\"one\",\"cat\":\"test\",\"ph\":\"X\",\"pid\":1,\"tid\":" ) != std::string::npos );
+  CHECK( json.find( "\"args\":{\"lines\":32,\"quote\\\"d\":0.5}" ) != std::string::npos );
+  CHECK( json.find( "\"ph\":\"M\"" ) != std::string::npos );
+  CHECK( json.find( "\"name\":\"other\"" ) != std::string::npos );
+  CHECK( json.find( "late" ) == std::string::npos );
+
+  CHECK_THROWS( writeTrace( "/nonexistent/directory/trace.json" ) );
+}
+TEST_SUITE_END();
+#endif
@@ -0,0 +1,138 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file ovalTrace.h
+ * \description This file contains a recorder of timed spans that is written
+ *   as Chrome trace-event JSON, which can be opened in Perfetto or in
+ *   chrome://tracing to see where the time of a slow frame went
+---------------------------------------------------------------------------- */
+
+#ifndef OVALTRACE_H
+#define OVALTRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/// The rasterizer only records spans when it is built with OVAL_TRACE
+/// defined, and then only between `traceStart` and `traceStop`.  Without
+/// the macro the spans are compiled out, and with it a span that is not
+/// recording costs one relaxed load.
+
+#ifdef OVAL_TRACE
+#define OVAL_TRACE_CONCAT2( one, two ) one##two
+#define OVAL_TRACE_CONCAT( one, two ) OVAL_TRACE_CONCAT2( one, two )
+#define OVAL_TRACE_SCOPE( name, category ) traceSpan OVAL_TRACE_CONCAT( trace_span_, __LINE__ )( name, category )
+#define OVAL_TRACE_SPAN( var, name, category ) traceSpan var( name, category )
+#define OVAL_TRACE_ARG( var, key, value ) var.arg( key, value )
+#define OVAL_TRACE_END( var ) var.end()
+#define OVAL_TRACE_THREAD( name ) traceThreadName( name )
+#else
+#define OVAL_TRACE_SCOPE( name, category )
+#define OVAL_TRACE_SPAN( var, name, category )
+#define OVAL_TRACE_ARG( var, key, value )
+#define OVAL_TRACE_END( var )
+#define OVAL_TRACE_THREAD( name )
+#endif
+
+typedef std::chrono::steady_clock traceClock;
+
+/// One named number that is shown with a span
+struct traceArg
+ {
+  const char *key;
+  double value;
+ };
+
+extern std::atomic< bool > traceRecording;
+
+/// \fn traceStart
+/// \description Throw away the spans recorded so far and start recording.
+///     At most `maxEvents` spans are kept, the ones after that are counted
+///     in `traceDroppedCount` so that a long run can't take all the memory.
+void traceStart( size_t maxEvents = 1 << 20 );
+
+/// \fn traceStop
+/// \description Stop recording, the spans are kept until the next start.
+void traceStop();
+
+/// \fn traceEnabled
+inline bool traceEnabled()
+{
+  return traceRecording.load( std::memory_order_relaxed );
+}
+
+size_t traceEventCount();
+size_t traceDroppedCount();
+
+/// \fn traceComplete
+/// \description Record a span that was timed by the caller.  The name,
+///     category and keys are not copied, so they must be string literals.
+void traceComplete( const char *name, const char *category,
+                    traceClock::time_point begin, traceClock::time_point end,
+                    const traceArg *args = nullptr, int count = 0 );
+
+/// \fn traceThreadName
+/// \description Name the calling thread in the trace.
+void traceThreadName( const char *name );
+
+/// \fn traceJson
+/// \returns The recorded spans as a Chrome trace-event JSON object
+std::string traceJson();
+
+/// \fn writeTrace
+/// \description Write the recorded spans to a file as JSON.  This will throw
+///     if the file can not be written.
+void writeTrace( const char *path );
+
+/** ----------------------------------------------------------------------------
+  \class traceSpan
+  \description Times the scope that it is made in, from the constructor to
+      `end` or to the destructor, when recording is on.  Up to `maxArgs`
+      numbers can be added to it.
+---------------------------------------------------------------------------- */
+class traceSpan
+  {
+    public:
+      static const int maxArgs = 8;
+
+      traceSpan( const char *name, const char *category ) :
+      name_( name ), category_( category ), recording_( traceEnabled() ), count_( 0 ), begin_(), args_()
+      {
+        if( recording_ )
+          begin_ = traceClock::now();
+      }
+
+      ~traceSpan() { end(); }
+
+      traceSpan( const traceSpan& ) = delete;
+      traceSpan& operator=( const traceSpan& ) = delete;
+
+      void arg( const char *key, double value )
+      {
+        if( recording_ and count_ < maxArgs )
+          {
+            args_[ count_ ] = { key, value };
+            count_ += 1;
+          }
+      }
+
+      void end()
+      {
+        if( recording_ )
+          {
+            traceComplete( name_, category_, begin_, traceClock::now(), args_, count_ );
+            recording_ = false;
+          }
+      }
+
+    private:
+      const char *name_;
+      const char *category_;
+      bool recording_;
+      int count_;
+      traceClock::time_point begin_;
+      traceArg args_[ maxArgs ];
+  };
+
+#endif //OVALTRACE_H
@@ -3,48 +3,32 @@
 //
 
 #include <QAction>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QMetaObject>
 #include <QMouseEvent>
 #include <QPainter>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 
 #include "ovalViewer.h"
+#include "runCompositor.h"
 
-/** ---------------------------------------------------------------------------
-* \fn compute_sdf
-* \description compute the signed distance to an oval.  The distance is positive
-*     if outside, negative if inside -- lifted from ovalRasterizer.cpp
----------------------------------------------------------------------------- */
-static float compute_sdf( const ovalRecord *oval, float xx, float yy )
-{
-  float dx = xx - oval->centerx;
-  float dy = yy - oval->centery;
-
-  float rr;
-
-  if( dx != 0.f or dy != 0.f )
-    {
-      float angle = oval->angle - atan2( dy, dx );
-
-      float sinT = sin( angle );
-      float cosT = cos( angle );
-      float a2 = oval->radiusx * oval->radiusx;
-      float b2 = oval->radiusy * oval->radiusy;
+/// The number of frames that the HUD keeps statistics for
+static const size_t frame_history = 120;
 
-      float r2 = ( a2 * b2 ) / ( a2 * sinT * sinT + b2 * cosT * cosT );
+/// How long the stress mode waits for a frame before it moves the scene anyway
+static const qint64 stress_fallback_ms = 1000;
 
-      rr = hypot( dx, dy ) - sqrt( r2 );
-    }
-  else  // the point is in the center
-    {
-      rr = -std::min( oval->radiusx, oval->radiusy );
-    }
-
-  return rr;
-}
 /** ----------------------------------------------------------------------------
   \fn ovalViewer::ovalViewer
 ---------------------------------------------------------------------------- */
-ovalViewer::ovalViewer( QWidget *parent ) : QWidget( parent ), cmd_( nullptr ), scale_( 10 )
+ovalViewer::ovalViewer( QWidget *parent ) : QWidget( parent ), cmd_( nullptr ), scale_( 10 ),
+stress_( nullptr ), stressLast_( 0 ), stressSeen_( 0 ), savedScale_( 10 ),
+cancel_( false ), pendingDraft_( false ), hasPending_( false ), quit_( false ), hud_( false ), recordAll_( false )
 {
   setFocusPolicy( Qt::StrongFocus );
 
@@ -61,32 +45,291 @@ ovalViewer::ovalViewer( QWidget *parent ) : QWidget( parent ), cmd_( nullptr ),
   writeOvalsXn->setShortcut( QString( "Ctrl+s" ) );
   connect( writeOvalsXn, SIGNAL( triggered(bool) ), this, SLOT( writeOvals() ) );
 
+  QAction *hudXn = new QAction( QString( "Show Frame Times" ), this );
+  hudXn->setShortcut( QString( "Ctrl+i" ) );
+  connect( hudXn, SIGNAL( triggered(bool) ), this, SLOT( toggleHud() ) );
+
+  QAction *stressXn = new QAction( QString( "Stress Test" ), this );
+  stressXn->setShortcut( QString( "Ctrl+t" ) );
+  connect( stressXn, SIGNAL( triggered(bool) ), this, SLOT( toggleStress() ) );
+
+  QAction *dumpStressXn = new QAction( QString( "Save Stress Results" ), this );
+  dumpStressXn->setShortcut( QString( "Ctrl+e" ) );
+  connect( dumpStressXn, SIGNAL( triggered(bool) ), this, SLOT( dumpStress() ) );
+
   addAction( dumpRenderXn );
   addAction( clearOvalsXn );
   addAction( writeOvalsXn );
+  addAction( hudXn );
+  addAction( stressXn );
+  addAction( dumpStressXn );
+
+  // Render the full image once the mouse has been still for a moment
+
+  refine_ = new QTimer( this );
+  refine_->setSingleShot( true );
+  refine_->setInterval( 150 );
+  connect( refine_, SIGNAL( timeout() ), this, SLOT( requestRender() ) );
+
+  stressTimer_ = new QTimer( this );
+  stressTimer_->setTimerType( Qt::PreciseTimer );    // a coarse timer can fire before the second is up
+  connect( stressTimer_, SIGNAL( timeout() ), this, SLOT( stressTick() ) );
+
+  worker_ = std::thread( &ovalViewer::renderLoop, this );
 }
 /** ----------------------------------------------------------------------------
-  \fn ovalViewer::renderOnePixel
+  \fn ovalViewer::~ovalViewer
 ---------------------------------------------------------------------------- */
-void ovalViewer::renderOnePixel( const QPoint& where )
+ovalViewer::~ovalViewer()
+{
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+
+    quit_ = true;
+    cancel_ = true;
+  }
+
+  wake_.notify_one();
+  worker_.join();
+
+  delete stress_;
+}
+/** ----------------------------------------------------------------------------
+  \fn paint_runs
+  \description Draw the runs into the image in blue, with the coverage as the
+      alpha.
+---------------------------------------------------------------------------- */
+static void paint_runs( QImage *img, const std::vector< pixelRun >& rr )
+{
+  runCompositor comp( img->bits(), img->width(), img->height(), img->bytesPerLine(), pixelFormat::argb32 );
+
+  comp.setColor( 0x00, 0x00, 0xFF );
+  comp.setTruncateAlpha( true );
+  comp.apply( rr );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::requestRender
+  \description Render the whole image at full quality.
+---------------------------------------------------------------------------- */
+void ovalViewer::requestRender()
+{
+  refine_->stop();
+
+  queueRender( QRect( 0, 0, width() / scale_, height() / scale_ ), false );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::requestDraft
+  \description Render only the area that changed and without anti-aliasing,
+      so that the cost depends on the ovals near the change rather than on
+      the whole scene.  The full image follows once the drafts stop.
+---------------------------------------------------------------------------- */
+void ovalViewer::requestDraft( const QRect& dirty )
+{
+  refine_->start();
+
+  queueRender( dirty, true );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::queueRender
+  \description Hand a copy of the ovals to the worker thread.  If a render is
+      in flight it is cancelled, and if an earlier request hasn't started it
+      is replaced, so the worker only ever works on the latest state.  The
+      dirty areas of the requests that are replaced are kept.
+---------------------------------------------------------------------------- */
+void ovalViewer::queueRender( const QRect& dirty, bool draft )
+{
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+
+    if( not hasPending_ )
+      {
+        pendingTime_ = std::chrono::steady_clock::now();
+      }
+
+    pending_ = ovalList_;
+    pendingSize_ = QSize( width() / scale_, height() / scale_ );
+    pendingDirty_ = pendingDirty_.united( dirty );
+    pendingDraft_ = draft;
+    hasPending_ = true;
+    cancel_ = true;
+  }
+
+  wake_.notify_one();
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::renderLoop
+  \description The worker thread.  It rasterizes the latest request into the
+      back image and, unless the request was superseded in the meantime,
+      swaps it with the front image and asks the widget to repaint.  When
+      only part of the image changed, the back image starts as a copy of the
+      front one and only the dirty area is rasterized, with the clip
+      rectangle overload.
+---------------------------------------------------------------------------- */
+void ovalViewer::renderLoop()
 {
-  float xpos = floor( where.x() / scale_ );
-  float ypos = floor( where.y() / scale_ );
+  std::vector< ovalRecord > ovals;
 
-  std::vector< ovalRecord > shifted;
-  for( const auto& one : ovalList_ )
+  for(;;)
     {
-      shifted.push_back( { one.centerx - xpos, one.centery - ypos, one.radiusx, one.radiusy, one.angle } );
+      QSize size;
+      QRect dirty;
+      bool draft;
+      frameRecord frame;
+      std::chrono::steady_clock::time_point requested;
+
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+
+        wake_.wait( lock, [this] { return hasPending_ or quit_; } );
+
+        if( quit_ )
+          break;
+
+        ovals.swap( pending_ );
+        size = pendingSize_;
+        dirty = pendingDirty_;
+        draft = pendingDraft_;
+        requested = pendingTime_;
+        pendingDirty_ = QRect();
+        hasPending_ = false;
+        cancel_ = false;
+      }
+
+      // Only the worker writes to the front image, so it can read it here
+      // without holding the lock
+
+      QRect whole( 0, 0, size.width(), size.height() );
+
+      if( front_.size() != size or dirty.contains( whole ) )
+        {
+          dirty = whole;
+        }
+      else
+        {
+          dirty = dirty.intersected( whole );
+        }
+
+      if( back_.size() != size )
+        {
+          back_ = QImage( size, QImage::Format_ARGB32 );
+        }
+
+      if( dirty == whole )
+        {
+          back_.fill( 0x00ffffff );   // full white
+        }
+      else
+        {
+          for( int yy = 0; yy < size.height(); yy += 1 )
+            {
+              memcpy( back_.scanLine( yy ), front_.constScanLine( yy ), 4 * size.width() );
+            }
+
+          for( int yy = dirty.top(); yy <= dirty.bottom(); yy += 1 )
+            {
+              unsigned int *scan = (unsigned int *) back_.scanLine( yy );
+
+              std::fill( scan + dirty.left(), scan + dirty.right() + 1, 0x00ffffffu );
+            }
+        }
+
+      rasterOptions options;
+      options.antialias = not draft;
+      options.cancel = & cancel_;
+      options.stats = & frame.stats;
+
+      auto rr = ovalListToRaster( ovals, dirty.left(), dirty.top(), dirty.right() + 1, dirty.bottom() + 1, options );
+
+      if( not cancel_ )
+        {
+          auto start = std::chrono::steady_clock::now();
+
+          paint_runs( & back_, rr );
+
+          frame.finished = std::chrono::steady_clock::now();
+          frame.blitSeconds = std::chrono::duration< double >( frame.finished - start ).count();
+          frame.latencySeconds = std::chrono::duration< double >( frame.finished - requested ).count();
+          frame.draft = draft;
+        }
+
+      bool swapped = false;
+      bool recorded = false;
+
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+
+        if( cancel_ )   // the next request still has to redraw what this one would have
+          {
+            pendingDirty_ = pendingDirty_.united( dirty );
+          }
+        else
+          {
+            std::swap( front_, back_ );
+            swapped = true;
+
+            if( frame_history <= frames_.size() )
+              {
+                frames_.erase( frames_.begin() );
+              }
+
+            frames_.push_back( frame );
+
+            if( recordAll_ )
+              {
+                allFrames_.push_back( frame );
+                recorded = true;
+              }
+          }
+      }
+
+      if( swapped )
+        {
+          QMetaObject::invokeMethod( this, "update", Qt::QueuedConnection );
+        }
+
+      if( recorded )    // the stress mode moves the scene as soon as a frame is done
+        {
+          QMetaObject::invokeMethod( this, "stressTick", Qt::QueuedConnection );
+        }
     }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::ovalChanged
+  \description Called by the mouse commands after they change an oval, so
+      that the hit index follows it.
+---------------------------------------------------------------------------- */
+void ovalViewer::ovalChanged( const ovalRecord *oval )
+{
+  int index = (int)( oval - ovalList_.data() );
+
+  // Both where the oval was and where it is now need to be redrawn
+
+  floatBounds bb = hits_.bounds( index );
+
+  hits_.update( index, *oval );
+  bb.add( hits_.bounds( index ) );
 
-  auto rr = ovalListToRaster( shifted, 1, 1 );
+  int left = (int) std::floor( bb.left );
+  int top = (int) std::floor( bb.top );
+
+  requestDraft( QRect( left, top, (int) std::ceil( bb.right ) - left + 1, (int) std::ceil( bb.bottom ) - top + 1 ) );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::renderOnePixel
+---------------------------------------------------------------------------- */
+void ovalViewer::renderOnePixel( const QPoint& where )
+{
+  int xpos = where.x() / scale_;
+  int ypos = where.y() / scale_;
+
+  auto rr = ovalListToRaster( ovalList_, xpos, ypos, xpos + 1, ypos + 1 );
 
   if( rr.size() == 1 )
     {
       msg_ = QString( "ypos: %1, startx: %2, endx: %3, value: %4" )
-          .arg( ypos + rr[ 0 ].lineY )
-          .arg( xpos + rr[ 0 ].startX )
-          .arg( xpos + rr[ 0 ].endX )
+          .arg( rr[ 0 ].lineY )
+          .arg( rr[ 0 ].startX )
+          .arg( rr[ 0 ].endX )
           .arg( rr[ 0 ].value );
     }
   else
@@ -144,8 +387,9 @@ void ovalViewer::writeOvals()
 void ovalViewer::clearOvals()
 {
   ovalList_.clear();
+  hits_.clear();
   msg_.clear();
-  update();
+  requestRender();
 }
 /** ----------------------------------------------------------------------------
   \fn ovalViewer::paintEvent
@@ -156,54 +400,333 @@ void ovalViewer::paintEvent( QPaintEvent *event )
 
   if( not ovalList_.empty() )
     {
-      int ww = width() / scale_;
-      int hh = height() / scale_;
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
 
-      QImage img( ww, hh, QImage::Format_ARGB32 );
+        if( not front_.isNull() )
+          {
+            paint.drawImage( QRect( 0, 0, front_.width() * scale_, front_.height() * scale_ ), front_ );
+          }
+      }
 
-      img.fill( 0x00ffffff );   // full white
-
-      auto rr = ovalListToRaster( ovalList_, ww, hh );
+      if( not msg_.isEmpty() )
+        {
+          paint.drawText( QPoint( 15, 40 ), msg_ );
+        }
 
-      for( const auto& one : rr )
+      if( hud_ )
         {
-          unsigned char *scan = img.scanLine( one.lineY );
+          paintHud( paint );
+        }
+    }
+  else
+    {
+      paint.drawText( QPoint( 15, 40 ), QString( "Click and drag to add an oval" ) );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::toggleHud
+---------------------------------------------------------------------------- */
+void ovalViewer::toggleHud()
+{
+  hud_ = not hud_;
+  update();
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::paintHud
+  \description Draw the statistics of the last frame, the frame rate and a
+      histogram of the latency of the recent frames in the top right corner.
+      The drafts are shown in a lighter color.
+---------------------------------------------------------------------------- */
+void ovalViewer::paintHud( QPainter& paint )
+{
+  std::vector< frameRecord > frames;
 
-          Q_ASSERT( 0 <= one.startX );
-          Q_ASSERT( one.startX < ww );
-          Q_ASSERT( 0 < one.endX );
-          Q_ASSERT( one.endX <= ww );
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    frames = frames_;
+  }
 
-          int pp = (int)( 255.f * one.value );
+  if( frames.empty() )
+    return;
 
-          for( int ii = one.startX; ii < one.endX; ii += 1 )
-            {
-              int pi = 4 * ii;
+  const frameRecord& last = frames.back();
 
-              scan[ pi ] = 0xFF;
-              scan[ pi + 1 ] = 0x00;
-              scan[ pi + 2 ] = 0x00;
-              scan[ pi + 3 ] = pp;
-            }
-        }
+  double fps = 0.;
 
-      paint.drawImage( QRect( 0, 0, ww * scale_, hh * scale_ ), img );
+  if( 1 < frames.size() )
+    {
+      double span = std::chrono::duration< double >( last.finished - frames.front().finished ).count();
 
-      if( not msg_.isEmpty() )
+      fps = 0. < span ? ( frames.size() - 1 ) / span : 0.;
+    }
+
+  std::vector< double > latency;
+
+  for( const auto& one : frames )
+    {
+      latency.push_back( 1e3 * one.latencySeconds );
+    }
+
+  std::sort( latency.begin(), latency.end() );
+
+  int left = std::max( 15, width() - 15 - (int) frame_history * 2 );
+  int top = 20;
+
+  paint.fillRect( QRect( left - 5, top - 15, width() - left, 125 ), QColor( 255, 255, 255, 200 ) );
+  paint.setPen( QColor( 0, 0, 0 ) );
+
+  paint.drawText( QPoint( left, top ), QString( "rasterize: %1 ms (sweep %2 ms)  blit: %3 ms" )
+      .arg( 1e3 * last.stats.totalSeconds, 0, 'f', 2 )
+      .arg( 1e3 * last.stats.sweepSeconds, 0, 'f', 2 )
+      .arg( 1e3 * last.blitSeconds, 0, 'f', 2 ) );
+
+  paint.drawText( QPoint( left, top + 15 ), QString( "ovals: %1  runs: %2  aa pixels: %3%4" )
+      .arg( (qulonglong) ovalList_.size() )
+      .arg( (qulonglong) last.stats.runCount )
+      .arg( (qulonglong) last.stats.aaPixelCount )
+      .arg( last.draft ? "  (draft)" : "" ) );
+
+  paint.drawText( QPoint( left, top + 30 ), QString( "fps: %1  latency: %2 ms median, %3 ms max" )
+      .arg( fps, 0, 'f', 1 )
+      .arg( latency[ latency.size() / 2 ], 0, 'f', 1 )
+      .arg( latency.back(), 0, 'f', 1 ) );
+
+  // One bar per frame, one pixel per millisecond up to 60 ms
+
+  int base = top + 100;
+
+  for( size_t ii = 0; ii < frames.size(); ii += 1 )
+    {
+      int hh = std::min( 60, (int) std::ceil( 1e3 * frames[ ii ].latencySeconds ) );
+      QColor color = frames[ ii ].draft ? QColor( 120, 160, 255 ) : QColor( 0, 0, 200 );
+
+      paint.fillRect( QRect( left + 2 * (int) ii, base - hh, 2, hh ), color );
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::toggleStress
+  \description Start or stop the stress mode.  The scene fills the window at
+      a scale of one, and it is moved once for every frame that is finished,
+      so the frame rate is as high as the rasterizer and the blit allow.  The
+      size, shape and clustering of the ovals are asked for, the seed is
+      always the same so that runs can be compared.
+---------------------------------------------------------------------------- */
+void ovalViewer::toggleStress()
+{
+  if( not stress_ )
+    {
+      sceneOptions options;
+      bool ok = false;
+
+      options.count = QInputDialog::getInt( this, QString( "Stress Test" ), QString( "Number of ovals" ),
+                                            10000, 1, 10000000, 1000, & ok );
+
+      if( ok )
+        options.maxRadius = QInputDialog::getInt( this, QString( "Stress Test" ), QString( "Largest radius" ),
+                                                  (int) options.maxRadius, 1, 10000, 1, & ok );
+
+      if( ok )
+        options.eccentricity = 0.01f * QInputDialog::getInt( this, QString( "Stress Test" ),
+                                                             QString( "Eccentricity (percent)" ),
+                                                             50, 0, 99, 1, & ok );
+
+      if( ok )
+        options.clusters = QInputDialog::getInt( this, QString( "Stress Test" ),
+                                                 QString( "Number of clusters (0 for uniform)" ),
+                                                 0, 0, 10000, 1, & ok );
+
+      if( ok )
         {
-          paint.drawText( QPoint( 15, 40 ), msg_ );
+          delete cmd_;
+          cmd_ = nullptr;
+
+          savedScale_ = scale_;
+          scale_ = 1;
+
+          options.minRadius = std::min( options.minRadius, options.maxRadius );
+          options.width = width();
+          options.height = height();
+
+          ovalList_ = randomOvalScene( options );
+          hits_.clear();    // the mouse is ignored until the stress mode ends
+          stress_ = new sceneAnimator( ovalList_, options );
+
+          {
+            std::lock_guard< std::mutex > lock( mutex_ );
+
+            allFrames_.clear();
+            recordAll_ = true;
+          }
+
+          stressClock_.start();
+          stressLast_ = 0;
+          stressSeen_ = 0;
+          stressTimer_->start( stress_fallback_ms );
+
+          requestRender();
         }
     }
   else
     {
-      paint.drawText( QPoint( 15, 40 ), QString( "Click and drag to add an oval" ) );
+      stressTimer_->stop();
+
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        recordAll_ = false;
+      }
+
+      delete stress_;
+      stress_ = nullptr;
+
+      // The moved scene is thrown away, which also resets the hit index
+      // that was left empty while the scene moved
+
+      scale_ = savedScale_;
+      clearOvals();
     }
 }
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::stressTick
+  \description Move the scene once the frame for the last move is finished.
+      The render thread calls this when it records a frame.  If that frame
+      never comes, for example because it was cancelled by a resize, the
+      timer calls it and the scene is moved anyway after a second.
+---------------------------------------------------------------------------- */
+void ovalViewer::stressTick()
+{
+  if( not stress_ )   // a frame that was finished after the stress mode ended
+    return;
+
+  // The mouse is ignored in stress mode, but a command would point into the
+  // list that is about to be replaced
+
+  delete cmd_;
+  cmd_ = nullptr;
+
+  size_t finished;
+
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    finished = allFrames_.size();
+  }
+
+  qint64 now = stressClock_.elapsed();
+
+  if( stressSeen_ < finished or stress_fallback_ms <= now - stressLast_ )
+    {
+      stress_->step( ( now - stressLast_ ) / 1000.f );
+
+      stressLast_ = now;
+      stressSeen_ = finished;
+
+      ovalList_ = stress_->ovals();
+
+      stressTimer_->start( stress_fallback_ms );    // counted from this move
+      requestRender();
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn percentile
+---------------------------------------------------------------------------- */
+static double percentile( std::vector< double > values, double pp )
+{
+  double rr = 0.;
+
+  if( not values.empty() )
+    {
+      std::sort( values.begin(), values.end() );
+
+      rr = values[ std::min( values.size() - 1, (size_t)( pp * values.size() ) ) ];
+    }
+
+  return rr;
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::dumpStress
+  \description Write a summary of the frames recorded in stress mode and
+      then the statistics of every frame, one per line.
+---------------------------------------------------------------------------- */
+void ovalViewer::dumpStress()
+{
+  std::vector< frameRecord > frames;
+
+  {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    frames = allFrames_;
+  }
+
+  if( frames.empty() )
+    return;
+
+  QString path = QFileDialog::getSaveFileName( this, QString( "Save Stress Results" ), QString( "stress.txt" ) );
+
+  if( path.isEmpty() )
+    return;
+
+  FILE *fp = fopen( path.toLocal8Bit().constData(), "w" );
+
+  if( not fp )
+    {
+      msg_ = QString( "Unable to write %1" ).arg( path );
+      update();
+      return;
+    }
+
+  std::vector< double > latency;
+  std::vector< double > raster;
+  std::vector< double > blit;
+
+  for( const auto& one : frames )
+    {
+      latency.push_back( 1e3 * one.latencySeconds );
+      raster.push_back( 1e3 * one.stats.totalSeconds );
+      blit.push_back( 1e3 * one.blitSeconds );
+    }
+
+  double span = std::chrono::duration< double >( frames.back().finished - frames.front().finished ).count();
+
+  fprintf( fp, "# ovals: %zu\n", ovalList_.size() );
+  fprintf( fp, "# frames: %zu in %.3f s, %.2f fps\n", frames.size(), span,
+           0. < span ? ( frames.size() - 1 ) / span : 0. );
+
+  const struct { const char *name; const std::vector< double > *values; } columns[] = {
+      { "latency", & latency }, { "rasterize", & raster }, { "blit", & blit }
+    };
+
+  for( const auto& col : columns )
+    {
+      fprintf( fp, "# %s ms: p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n", col.name,
+               percentile( *col.values, .5 ), percentile( *col.values, .9 ),
+               percentile( *col.values, .99 ), percentile( *col.values, 1. ) );
+    }
+
+  fprintf( fp, "# frame latency_ms rasterize_ms sweep_ms blit_ms runs aa_pixels\n" );
+
+  for( size_t ii = 0; ii < frames.size(); ii += 1 )
+    {
+      fprintf( fp, "%zu %.3f %.3f %.3f %.3f %zu %zu\n", ii, latency[ ii ], raster[ ii ],
+               1e3 * frames[ ii ].stats.sweepSeconds, blit[ ii ],
+               frames[ ii ].stats.runCount, frames[ ii ].stats.aaPixelCount );
+    }
+
+  fclose( fp );
+}
+/** ----------------------------------------------------------------------------
+  \fn ovalViewer::resizeEvent
+---------------------------------------------------------------------------- */
+void ovalViewer::resizeEvent( QResizeEvent *event )
+{
+  requestRender();
+}
 /** ----------------------------------------------------------------------------
   \fn ovalViewer::mousePressEvent
 ---------------------------------------------------------------------------- */
 void ovalViewer::mousePressEvent( QMouseEvent *event )
 {
+  if( stress_ )   // the scene is replaced on every frame
+    return;
+
   if( event->buttons() == Qt::LeftButton )
     {
       if( not cmd_ )
@@ -219,13 +742,11 @@ void ovalViewer::mousePressEvent( QMouseEvent *event )
             }
           else  // see if we clicked on an oval
             {
-              for( auto& one : ovalList_ )
+              int index = hits_.topmost( xx, yy );
+
+              if( 0 <= index )
                 {
-                  if( compute_sdf( & one, xx, yy ) <= 0.f )
-                    {
-                      oval = & one;
-                      break;
-                    }
+                  oval = & ovalList_[ index ];
                 }
 
               if( oval )
@@ -246,6 +767,7 @@ void ovalViewer::mousePressEvent( QMouseEvent *event )
                   oval.angle = 0;
 
                   ovalList_.push_back( oval );
+                  hits_.add( oval );
 
                   cmd_ = new new_oval_cmd( this, & ovalList_[ ovalList_.size() - 1 ], event->pos() );
                 }
@@ -263,7 +785,7 @@ void ovalViewer::mousePressEvent( QMouseEvent *event )
 ---------------------------------------------------------------------------- */
 void ovalViewer::mouseMoveEvent( QMouseEvent *event )
 {
-  if( cmd_ )
+  if( cmd_ and not stress_ )
     {
       cmd_->update( event->pos() );
     }
@@ -273,8 +795,13 @@ void ovalViewer::mouseMoveEvent( QMouseEvent *event )
 ---------------------------------------------------------------------------- */
 void ovalViewer::mouseReleaseEvent( QMouseEvent *event )
 {
-  delete cmd_;
-  cmd_ = nullptr;
+  if( cmd_ and not stress_ )
+    {
+      delete cmd_;
+      cmd_ = nullptr;
+
+      requestRender();    // replace the drafts with the full image
+    }
 }
 /** ----------------------------------------------------------------------------
   \fn move_oval_cmd::move_oval_cmd
@@ -294,7 +821,7 @@ void move_oval_cmd::update( const QPoint& where )
   oval_->centerx = centerx_ + dx;
   oval_->centery = centery_ + dy;
 
-  view_->update();
+  view_->ovalChanged( oval_ );
 }
 /** ----------------------------------------------------------------------------
   \fn rotate_oval_cmd::rotate_oval_cmd
@@ -316,7 +843,7 @@ void rotate_oval_cmd::update( const QPoint& pos )
 
   oval_->angle = angle_ + angle2 - angle1;
 
-  view_->update();
+  view_->ovalChanged( oval_ );
 }
 /** ----------------------------------------------------------------------------
   \fn new_oval_cmd::new_oval_cmd
@@ -335,6 +862,6 @@ void new_oval_cmd::update( const QPoint& pos )
   oval_->radiusx = 0.5f * fabs( ( pos.x() - start_.x() ) / (float) view_->scale() );
   oval_->radiusy = 0.5f * fabs( ( pos.y() - start_.y() ) / (float) view_->scale() );
 
-  view_->update();
+  view_->ovalChanged( oval_ );
 }
 
@@ -5,11 +5,24 @@
 #ifndef OVALVIEWER_H
 #define OVALVIEWER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRect>
+#include <QTimer>
 #include <QWidget>
 
+#include "ovalHitIndex.h"
 #include "ovalRasterizer.h"
+#include "ovalScenes.h"
+
+class QPainter;
 
 /** ----------------------------------------------------------------------------
   \class mouse_cmd
@@ -21,8 +34,27 @@ class mouse_cmd
 
     virtual void update( const QPoint& pos ) = 0;
   };
+/// The statistics of one frame rendered by the viewer, for the HUD
+
+struct frameRecord
+ {
+  rasterStats stats;        /// As measured by the rasterizer
+  double blitSeconds;       /// Drawing the runs into the image
+  double latencySeconds;    /// From the first request to the finished image
+  std::chrono::steady_clock::time_point finished;
+  bool draft;
+ };
+
 /** ----------------------------------------------------------------------------
   \class ovalViewer
+  \description The ovals are rasterized on a worker thread from a copy of the
+      list, so that the mouse stays responsive however many ovals there are.
+      A newer request cancels the one in flight, and the painting only shows
+      the last image that was finished.  While an oval is being dragged, only
+      the area that it changed is rendered, without anti-aliasing, and the
+      full image is rendered again once the mouse is released or stops.  In
+      stress mode a random scene is animated and every frame is recorded, so
+      that the viewer can be used to measure the rasterizer.
 ---------------------------------------------------------------------------- */
 class ovalViewer : public QWidget
   {
@@ -30,29 +62,78 @@ class ovalViewer : public QWidget
 
     public:
       ovalViewer( QWidget *parent = nullptr );
+      ~ovalViewer() override;
 
       int scale() const { return scale_; }
 
+      void ovalChanged( const ovalRecord *oval );
+
     public slots:
       void dumpOvalRender();
       void clearOvals();
       void writeOvals();
+      void toggleHud();
+      void toggleStress();
+      void dumpStress();
 
     protected:
       void paintEvent( QPaintEvent *event ) override;
+      void resizeEvent( QResizeEvent *event ) override;
 
       void mousePressEvent( QMouseEvent *event ) override;
       void mouseMoveEvent( QMouseEvent *event ) override;
       void mouseReleaseEvent( QMouseEvent *event ) override;
 
+    private slots:
+      void requestRender();
+      void stressTick();
+
     private:
       void renderOnePixel( const QPoint& where );
+      void requestDraft( const QRect& dirty );
+      void queueRender( const QRect& dirty, bool draft );
+      void renderLoop();
+      void paintHud( QPainter& paint );
 
       std::vector<ovalRecord> ovalList_;
+      ovalHitIndex hits_;
       mouse_cmd *cmd_;
 
       int scale_;
       QString msg_;
+
+      QTimer *refine_;    /// Renders the full image once the drafts stop
+
+      sceneAnimator *stress_;     /// Not null while the stress mode is on
+      QTimer *stressTimer_;
+      QElapsedTimer stressClock_;
+      qint64 stressLast_;         /// When the scene was last moved, in ms
+      size_t stressSeen_;         /// The number of frames when the scene was last moved
+      int savedScale_;
+
+      // The state shared with the worker thread is guarded by mutex_
+
+      std::thread worker_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      std::atomic< bool > cancel_;    /// Set when the render in flight is stale
+
+      std::vector<ovalRecord> pending_;   /// The snapshot to render next
+      QSize pendingSize_;
+      QRect pendingDirty_;    /// The area that changed since the last finished image
+      std::chrono::steady_clock::time_point pendingTime_;   /// When the first waiting request was made
+      bool pendingDraft_;
+      bool hasPending_;
+      bool quit_;
+
+      QImage front_;    /// The last finished image, the one that is painted
+      QImage back_;     /// The image that the worker is rendering into
+
+      bool hud_;
+      std::vector< frameRecord > frames_;   /// The last frames, oldest first
+
+      bool recordAll_;
+      std::vector< frameRecord > allFrames_;  /// Every frame while recording
   };
 /** ----------------------------------------------------------------------------
   \class move_oval_cmd
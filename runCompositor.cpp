@@ -0,0 +1,586 @@
+/** ---------------------------------------------------------------------------
+*
+* \file runCompositor.cpp
+* \description This file contains the code that applies pixel runs to a
+*   frame buffer that belongs to the caller
+---------------------------------------------------------------------------- */
+
+#include "runCompositor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iso646.h>
+
+#if defined( __SSE2__ ) or defined( _M_X64 )
+#define COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef TESTING
+#include <doctest/doctest.h>
+#include <thread>
+#endif
+
+/** ---------------------------------------------------------------------------
+* \fn mul255
+* \description Multiply two 8-bit values and divide by 255, rounded.  This is
+*     the same arithmetic as the SSE2 code, so the results match.
+---------------------------------------------------------------------------- */
+static inline uint8_t mul255( unsigned one, unsigned two )
+{
+  unsigned tt = one * two + 128;
+
+  return (uint8_t)( ( tt + ( tt >> 8 ) ) >> 8 );
+}
+/** ---------------------------------------------------------------------------
+* \fn argb_alpha_index
+* \description Where the alpha byte of a 0xAARRGGBB word is in memory, which
+*     is 3 on little endian machines and 0 on big endian ones.
+---------------------------------------------------------------------------- */
+static int argb_alpha_index()
+{
+  uint32_t word = 0xFF000000u;
+  uint8_t bytes[ 4 ];
+
+  memcpy( bytes, & word, 4 );
+
+  return bytes[ 0 ] == 0xFF ? 0 : 3;
+}
+/** ---------------------------------------------------------------------------
+* \fn fill_bytes
+* \description Fill a span with a pattern of four bytes (or one byte repeated
+*     four times).  The span is a whole number of pixels.
+---------------------------------------------------------------------------- */
+static void fill_bytes( uint8_t *dst, size_t nbytes, const uint8_t pat[ 4 ] )
+{
+  size_t ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  uint32_t word;
+  memcpy( & word, pat, 4 );
+
+  __m128i pp = _mm_set1_epi32( (int) word );
+
+  for( ; ii + 16 <= nbytes; ii += 16 )
+    {
+      _mm_storeu_si128( (__m128i *)( dst + ii ), pp );
+    }
+#endif
+
+  for( ; ii < nbytes; ii += 1 )
+    {
+      dst[ ii ] = pat[ ii & 3 ];
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn max_bytes
+---------------------------------------------------------------------------- */
+static void max_bytes( uint8_t *dst, size_t nbytes, const uint8_t pat[ 4 ] )
+{
+  size_t ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  uint32_t word;
+  memcpy( & word, pat, 4 );
+
+  __m128i pp = _mm_set1_epi32( (int) word );
+
+  for( ; ii + 16 <= nbytes; ii += 16 )
+    {
+      __m128i dd = _mm_loadu_si128( (const __m128i *)( dst + ii ) );
+      _mm_storeu_si128( (__m128i *)( dst + ii ), _mm_max_epu8( dd, pp ) );
+    }
+#endif
+
+  for( ; ii < nbytes; ii += 1 )
+    {
+      dst[ ii ] = std::max( dst[ ii ], pat[ ii & 3 ] );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn srcover_bytes
+* \description Draw premultiplied bytes over the span, which is
+*     d = s + d * ( 255 - alpha ) / 255 for every byte.
+---------------------------------------------------------------------------- */
+static void srcover_bytes( uint8_t *dst, size_t nbytes, const uint8_t pat[ 4 ], uint8_t alpha )
+{
+  unsigned inv = 255 - alpha;
+  size_t ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  uint32_t word;
+  memcpy( & word, pat, 4 );
+
+  __m128i pp = _mm_set1_epi32( (int) word );
+  __m128i ia = _mm_set1_epi16( (short) inv );
+  __m128i half = _mm_set1_epi16( 128 );
+  __m128i zero = _mm_setzero_si128();
+
+  for( ; ii + 16 <= nbytes; ii += 16 )
+    {
+      __m128i dd = _mm_loadu_si128( (const __m128i *)( dst + ii ) );
+
+      __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( dd, zero ), ia ), half );
+      __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( dd, zero ), ia ), half );
+
+      lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+      hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+
+      _mm_storeu_si128( (__m128i *)( dst + ii ), _mm_add_epi8( _mm_packus_epi16( lo, hi ), pp ) );
+    }
+#endif
+
+  for( ; ii < nbytes; ii += 1 )
+    {
+      dst[ ii ] = (uint8_t)( pat[ ii & 3 ] + mul255( dst[ ii ], inv ) );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn srcover_straight
+* \description Draw a color over pixels with straight alpha.  This needs a
+*     divide per pixel, so there is no wide version.
+* \param pat The color with straight alpha, in the byte order of the buffer
+* \param ai The position of the alpha byte in the pixel
+---------------------------------------------------------------------------- */
+static void srcover_straight( uint8_t *dst, int count, const uint8_t pat[ 4 ], int ai )
+{
+  unsigned sa = pat[ ai ];
+  unsigned inv = 255 - sa;
+
+  for( int ii = 0; ii < count; ii += 1, dst += 4 )
+    {
+      unsigned da = dst[ ai ];
+      unsigned aa = sa * 255 + da * inv;    // the resulting alpha, times 255
+
+      for( int cc = 0; cc < 4; cc += 1 )
+        {
+          if( cc != ai )
+            {
+              dst[ cc ] = aa ? (uint8_t)( ( pat[ cc ] * sa * 255 + dst[ cc ] * da * inv + aa / 2 ) / aa ) : 0;
+            }
+        }
+
+      dst[ ai ] = (uint8_t)( ( aa + 127 ) / 255 );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn fill_floats
+---------------------------------------------------------------------------- */
+static void fill_floats( float *dst, int count, float value )
+{
+  int ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  __m128 vv = _mm_set1_ps( value );
+
+  for( ; ii + 4 <= count; ii += 4 )
+    {
+      _mm_storeu_ps( dst + ii, vv );
+    }
+#endif
+
+  for( ; ii < count; ii += 1 )
+    {
+      dst[ ii ] = value;
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn max_floats
+---------------------------------------------------------------------------- */
+static void max_floats( float *dst, int count, float value )
+{
+  int ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  __m128 vv = _mm_set1_ps( value );
+
+  for( ; ii + 4 <= count; ii += 4 )
+    {
+      _mm_storeu_ps( dst + ii, _mm_max_ps( _mm_loadu_ps( dst + ii ), vv ) );
+    }
+#endif
+
+  for( ; ii < count; ii += 1 )
+    {
+      dst[ ii ] = std::max( dst[ ii ], value );
+    }
+}
+/** ---------------------------------------------------------------------------
+* \fn srcover_floats
+* \description d = s + d * ( 1 - s )
+---------------------------------------------------------------------------- */
+static void srcover_floats( float *dst, int count, float value )
+{
+  float inv = 1.f - value;
+  int ii = 0;
+
+#ifdef COMPOSITOR_SSE2
+  __m128 vv = _mm_set1_ps( value );
+  __m128 iv = _mm_set1_ps( inv );
+
+  for( ; ii + 4 <= count; ii += 4 )
+    {
+      _mm_storeu_ps( dst + ii, _mm_add_ps( vv, _mm_mul_ps( _mm_loadu_ps( dst + ii ), iv ) ) );
+    }
+#endif
+
+  for( ; ii < count; ii += 1 )
+    {
+      dst[ ii ] = value + dst[ ii ] * inv;
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn runCompositor::runCompositor
+---------------------------------------------------------------------------- */
+runCompositor::runCompositor( void *pixels, int width, int height, ptrdiff_t stride, pixelFormat format ) :
+pixels_( (uint8_t *) pixels ), width_( width ), height_( height ), stride_( stride ), format_( format ),
+mode_( blendMode::replace ), truncate_( false ), red_( 0 ), green_( 0 ), blue_( 0 ), alpha_( 255 ), pixelCount_( 0 )
+{
+}
+/** ----------------------------------------------------------------------------
+  \fn runCompositor::setColor
+---------------------------------------------------------------------------- */
+void runCompositor::setColor( uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha )
+{
+  red_ = red;
+  green_ = green;
+  blue_ = blue;
+  alpha_ = alpha;
+}
+/** ----------------------------------------------------------------------------
+  \fn runCompositor::apply
+---------------------------------------------------------------------------- */
+void runCompositor::apply( const std::vector< pixelRun >& runs )
+{
+  apply( runs.data(), runs.size() );
+}
+
+void runCompositor::apply( const pixelRun *runs, size_t count )
+{
+  for( size_t ii = 0; ii < count; ii += 1 )
+    {
+      const pixelRun& one = runs[ ii ];
+
+      if( 0 <= one.lineY and one.lineY < height_ )
+        {
+          int startX = std::max( 0, one.startX );
+          int endX = std::min( width_, one.endX );
+
+          if( startX < endX )
+            {
+              apply_run( pixels_ + one.lineY * stride_, startX, endX - startX, 1, one.value );
+              pixelCount_ += endX - startX;
+            }
+        }
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn runCompositor::apply
+---------------------------------------------------------------------------- */
+void runCompositor::apply( const std::vector< pixelRect >& rects )
+{
+  apply( rects.data(), rects.size() );
+}
+
+void runCompositor::apply( const pixelRect *rects, size_t count )
+{
+  for( size_t ii = 0; ii < count; ii += 1 )
+    {
+      const pixelRect& one = rects[ ii ];
+
+      int startY = std::max( 0, one.startY );
+      int endY = std::min( height_, one.endY );
+      int startX = std::max( 0, one.startX );
+      int endX = std::min( width_, one.endX );
+
+      if( startY < endY and startX < endX )
+        {
+          apply_run( pixels_ + startY * stride_, startX, endX - startX, endY - startY, one.value );
+          pixelCount_ += (uint64_t)( endX - startX ) * ( endY - startY );
+        }
+    }
+}
+/** ----------------------------------------------------------------------------
+  \fn runCompositor::apply_run
+  \description The color is the same along a run, so it is worked out once
+      and then the whole span is filled or blended with it, on each of the
+      `lines` lines from `line` down.
+---------------------------------------------------------------------------- */
+void runCompositor::apply_run( uint8_t *line, int startX, int count, int lines, float value )
+{
+  if( format_ == pixelFormat::float32 )
+    {
+      float ss = value * ( alpha_ / 255.f );
+
+      for( int row = 0; row < lines; row += 1, line += stride_ )
+        {
+          float *dst = (float *) line + startX;
+
+          switch( mode_ )
+            {
+              case blendMode::replace:  fill_floats( dst, count, ss );  break;
+              case blendMode::max:      max_floats( dst, count, ss );  break;
+              case blendMode::srcOver:  srcover_floats( dst, count, std::min( 1.f, ss ) );  break;
+            }
+        }
+    }
+  else
+    {
+      float cover = std::min( 1.f, std::max( 0.f, value ) );
+      uint8_t sa = (uint8_t)( alpha_ * cover + ( truncate_ ? 0.f : 0.5f ) );
+
+      uint8_t pat[ 4 ];
+      int bpp = 4;
+      int ai = 3;     // where the alpha is in the pixel
+      bool premultiplied = false;
+
+      switch( format_ )
+        {
+          case pixelFormat::argb32Premultiplied:
+            premultiplied = true;
+            // fall through
+          case pixelFormat::argb32:
+            {
+              uint8_t rr = premultiplied ? mul255( red_, sa ) : red_;
+              uint8_t gg = premultiplied ? mul255( green_, sa ) : green_;
+              uint8_t bb = premultiplied ? mul255( blue_, sa ) : blue_;
+
+              uint32_t word = (uint32_t) sa << 24 | (uint32_t) rr << 16 | (uint32_t) gg << 8 | bb;
+              memcpy( pat, & word, 4 );
+
+              ai = argb_alpha_index();
+            }
+            break;
+
+          case pixelFormat::rgba8:
+            pat[ 0 ] = red_;
+            pat[ 1 ] = green_;
+            pat[ 2 ] = blue_;
+            pat[ 3 ] = sa;
+            break;
+
+          case pixelFormat::a8:
+            premultiplied = true;
+            bpp = 1;
+            pat[ 0 ] = pat[ 1 ] = pat[ 2 ] = pat[ 3 ] = sa;
+            break;
+
+          case pixelFormat::float32:
+            break;
+        }
+
+      size_t nbytes = (size_t) count * bpp;
+      bool fill = mode_ == blendMode::replace or ( mode_ == blendMode::srcOver and sa == 255 );
+
+      if( not fill and sa == 0 )   // the runs with no coverage leave the pixels alone
+        return;
+
+      for( int row = 0; row < lines; row += 1, line += stride_ )
+        {
+          uint8_t *dst = line + startX * bpp;
+
+          if( fill )
+            {
+              fill_bytes( dst, nbytes, pat );
+            }
+          else if( mode_ == blendMode::max )
+            {
+              max_bytes( dst, nbytes, pat );
+            }
+          else if( premultiplied )
+            {
+              srcover_bytes( dst, nbytes, pat, sa );
+            }
+          else
+            {
+              srcover_straight( dst, count, pat, ai );
+            }
+        }
+    }
+}
+/** ---------------------------------------------------------------------------
+ * ---------------------------TEST CASES --------------------------------------
+---------------------------------------------------------------------------- */
+#ifdef TESTING
+TEST_SUITE_BEGIN( "RunCompositor_UnitTests");
+TEST_CASE( "Mul 255" )
+{
+  for( unsigned aa = 0; aa < 256; aa += 1 )
+    {
+      for( unsigned bb = 0; bb < 256; bb += 1 )
+        {
+          CHECK( mul255( aa, bb ) == (unsigned) std::lround( aa * bb / 255. ) );
+        }
+    }
+}
+TEST_CASE( "Wide And Narrow Spans" )
+{
+  // A long span goes through the wide code, single pixels don't, and both
+  // must give the same pixels
+
+  uint8_t start[ 37 * 4 ];
+
+  for( int ii = 0; ii < 37 * 4; ii += 1 )
+    {
+      start[ ii ] = (uint8_t)( ii * 37 + 11 );
+    }
+
+  uint8_t pat[ 4 ] = { 40, 20, 10, 60 };
+
+  uint8_t wide[ 37 * 4 ];
+  uint8_t narrow[ 37 * 4 ];
+
+  memcpy( wide, start, sizeof( wide ) );
+  memcpy( narrow, start, sizeof( narrow ) );
+
+  srcover_bytes( wide, sizeof( wide ), pat, 60 );
+
+  for( int ii = 0; ii < 37; ii += 1 )
+    {
+      srcover_bytes( narrow + 4 * ii, 4, pat, 60 );
+    }
+
+  CHECK( memcmp( wide, narrow, sizeof( wide ) ) == 0 );
+
+  max_bytes( wide, sizeof( wide ), pat );
+
+  for( int ii = 0; ii < 37; ii += 1 )
+    {
+      max_bytes( narrow + 4 * ii, 4, pat );
+    }
+
+  CHECK( memcmp( wide, narrow, sizeof( wide ) ) == 0 );
+
+  float fwide[ 11 ];
+  float fnarrow[ 11 ];
+
+  for( int ii = 0; ii < 11; ii += 1 )
+    {
+      fwide[ ii ] = fnarrow[ ii ] = ii / 11.f;
+    }
+
+  srcover_floats( fwide, 11, .3f );
+
+  for( int ii = 0; ii < 11; ii += 1 )
+    {
+      srcover_floats( fnarrow + ii, 1, .3f );
+    }
+
+  CHECK( memcmp( fwide, fnarrow, sizeof( fwide ) ) == 0 );
+}
+TEST_CASE( "Straight Source Over" )
+{
+  uint8_t px[ 4 ] = { 0, 0, 255, 255 };     // opaque blue in RGBA order
+  uint8_t pat[ 4 ] = { 255, 0, 0, 128 };    // half transparent red
+
+  srcover_straight( px, 1, pat, 3 );
+
+  CHECK( px[ 0 ] == 128 );
+  CHECK( px[ 1 ] == 0 );
+  CHECK( px[ 2 ] == 127 );
+  CHECK( px[ 3 ] == 255 );
+
+  uint8_t clear[ 4 ] = { 0, 0, 0, 0 };      // over nothing the color is kept
+
+  srcover_straight( clear, 1, pat, 3 );
+
+  CHECK( clear[ 0 ] == 255 );
+  CHECK( clear[ 3 ] == 128 );
+}
+TEST_CASE( "Truncated Alpha" )
+{
+  uint32_t px[ 2 ] = { 0, 0 };
+  pixelRun pr = { 0, 0, 1, 0.999f };
+
+  runCompositor comp( px, 2, 1, sizeof( px ), pixelFormat::argb32 );
+  comp.setColor( 0x00, 0x00, 0xFF );
+  comp.apply( & pr, 1 );
+
+  CHECK( px[ 0 ] == 0xFF0000FFu );    // 254.7 is rounded
+
+  pr.startX = 1;
+  pr.endX = 2;
+
+  comp.setTruncateAlpha( true );
+  comp.apply( & pr, 1 );
+
+  CHECK( px[ 1 ] == ( (uint32_t)(int)( 255.f * 0.999f ) << 24 | 0xFFu ) );   // as the viewer's own blit did
+}
+TEST_CASE( "Rectangles And Runs" )
+{
+  // Rectangles give the same pixels as the runs they came from, with a
+  // stride that is wider than the lines and an oval that is clipped
+
+  const int width = 50;
+  const int height = 40;
+  const ptrdiff_t stride = 4 * width + 8;
+
+  std::vector< ovalRecord > ol = { { 25.f, 20.f, 22.f, 15.f, 0.f }, { 45.f, 5.f, 10.f, 8.f, 0.3f } };
+  auto runs = ovalListToRaster( ol, -5, -5, width + 5, height + 5 );
+  auto rects = runsToRects( runs );
+
+  for( blendMode mode : { blendMode::replace, blendMode::srcOver, blendMode::max } )
+    {
+      std::vector< uint8_t > one( stride * height, 7 );
+      std::vector< uint8_t > two( stride * height, 7 );
+
+      runCompositor byRuns( one.data(), width, height, stride, pixelFormat::argb32Premultiplied );
+      runCompositor byRects( two.data(), width, height, stride, pixelFormat::argb32Premultiplied );
+
+      byRuns.setColor( 200, 100, 50, 180 );
+      byRects.setColor( 200, 100, 50, 180 );
+      byRuns.setBlendMode( mode );
+      byRects.setBlendMode( mode );
+
+      byRuns.apply( runs );
+      byRects.apply( rects );
+
+      CHECK( one == two );
+      CHECK( byRuns.pixelCount() == byRects.pixelCount() );
+    }
+}
+TEST_CASE( "Composite Chunks On Threads" )
+{
+  // Each thread has its own compositor on the same buffer, and the chunks
+  // never share a line
+
+  const int width = 80;
+  const int height = 60;
+
+  std::vector< ovalRecord > ol = { { 40.f, 30.f, 35.f, 25.f, 0.2f }, { 20.f, 20.f, 10.f, 15.f, 1.f } };
+
+  rasterOptions options;
+  rowIndex rows;
+  options.rows = & rows;
+
+  auto runs = ovalListToRaster( ol, 0, 0, width, height, options );
+
+  std::vector< uint8_t > serial( width * height, 0 );
+  std::vector< uint8_t > parallel( width * height, 0 );
+
+  runCompositor one( serial.data(), width, height, width, pixelFormat::a8 );
+  one.setBlendMode( blendMode::srcOver );
+  one.apply( runs );
+
+  std::vector< std::thread > threads;
+
+  for( const runChunk& chunk : splitRuns( rows, 3 ) )
+    {
+      threads.emplace_back( [&, chunk]
+        {
+          runCompositor comp( parallel.data(), width, height, width, pixelFormat::a8 );
+          comp.setBlendMode( blendMode::srcOver );
+          comp.apply( runs.data() + chunk.begin, chunk.end - chunk.begin );
+        } );
+    }
+
+  for( auto& thread : threads )
+    {
+      thread.join();
+    }
+
+  CHECK( threads.size() == 3 );
+  CHECK( serial == parallel );
+}
+TEST_SUITE_END();
+#endif
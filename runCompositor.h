@@ -0,0 +1,97 @@
+/** ---------------------------------------------------------------------------
+ *
+ * \file runCompositor.h
+ * \description This file contains the code that applies pixel runs to a
+ *   frame buffer that belongs to the caller
+---------------------------------------------------------------------------- */
+
+#ifndef RUNCOMPOSITOR_H
+#define RUNCOMPOSITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ovalRasterizer.h"
+
+/// The layouts of frame buffer that the compositor can write to.
+///
+///   argb32          A 32-bit 0xAARRGGBB word per pixel, straight alpha
+///                   (the same as QImage::Format_ARGB32)
+///   argb32Premultiplied  The same, with the colors multiplied by alpha
+///   rgba8           The bytes R, G, B, A in memory order, straight alpha
+///   a8              One byte of coverage per pixel
+///   float32         One float of coverage per pixel, which is not clamped
+///                   to 1 so that accumulated densities can be kept
+
+enum class pixelFormat { argb32, argb32Premultiplied, rgba8, a8, float32 };
+
+/// How a run is combined with the pixels that are already in the buffer.
+///
+///   replace         The pixels are set to the color, with the coverage of
+///                   the run as the alpha
+///   srcOver         The color is drawn over the pixels (Porter-Duff over)
+///   max             Each channel keeps the larger of the pixel and the color
+
+enum class blendMode { replace, srcOver, max };
+
+/** ----------------------------------------------------------------------------
+  \class runCompositor
+  \description Draws pixel runs in one color into a frame buffer.  The color
+      is given with straight alpha and its alpha is multiplied by the value
+      of each run.  Runs that fall outside of the buffer are clipped.  Runs
+      can be applied all at once or in pieces as they come out of a stream.
+      Solid spans are filled and blended several pixels at a time when SSE2
+      is available, with the same results as the scalar code.  The runs of
+      the anti-aliased edges, which are a few pixels long with a value of
+      their own, and source-over into the straight alpha formats are blended
+      one pixel at a time, so a list of mostly edges, from many small ovals,
+      is composited about ten times slower per pixel than solid spans.
+---------------------------------------------------------------------------- */
+class runCompositor
+  {
+    public:
+      /// \param stride The number of bytes from one line to the next
+      runCompositor( void *pixels, int width, int height, ptrdiff_t stride, pixelFormat format );
+
+      void setColor( uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255 );
+      void setBlendMode( blendMode mode ) { mode_ = mode; }
+
+      /// The alpha of an 8-bit pixel is the alpha of the color times the
+      /// coverage, rounded.  With this set it is truncated instead, which is
+      /// up to one step less on the edges and is what the viewer has always
+      /// drawn, so that its images don't change.
+      void setTruncateAlpha( bool truncate ) { truncate_ = truncate; }
+
+      void apply( const std::vector< pixelRun >& runs );
+      void apply( const pixelRun *runs, size_t count );
+
+      /// Rectangles from `runsToRects`, which give the same pixels as the
+      /// runs they were made from with the color worked out once per
+      /// rectangle instead of once per line
+      void apply( const std::vector< pixelRect >& rects );
+      void apply( const pixelRect *rects, size_t count );
+
+      /// The number of pixels written since the compositor was created
+      uint64_t pixelCount() const { return pixelCount_; }
+
+    private:
+      void apply_run( uint8_t *line, int startX, int count, int lines, float value );
+
+      uint8_t *pixels_;
+      int width_;
+      int height_;
+      ptrdiff_t stride_;
+      pixelFormat format_;
+      blendMode mode_;
+      bool truncate_;
+
+      uint8_t red_;
+      uint8_t green_;
+      uint8_t blue_;
+      uint8_t alpha_;
+
+      uint64_t pixelCount_;
+  };
+
+#endif //RUNCOMPOSITOR_H
@@ -6,7 +6,17 @@
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
+#include "ovalArena.h"
+#include "ovalFile.h"
+#include "ovalHitIndex.h"
 #include "ovalRasterizer.h"
+#include "ovalReference.h"
+#include "ovalScenes.h"
+#include "ovalTrace.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
 
 /* ----------------------------------------------------------------------------
  *  TEST CASES
@@ -230,4 +240,781 @@ TEST_CASE("Deduplicate Pivot")
   CHECK( ovalList[ 0 ].radiusx == 40.f );
   CHECK( ovalList[ 0 ].radiusy == 20.f );
 }
-TEST_SUITE_END();
\ No newline at end of file
+TEST_CASE("Oval File Round Trip")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( { 5.5f, 5.5f, 3.f, 3.f, 0.f } );
+  ovalList.push_back( { 12.f, 8.f, 4.f, 2.f, 0.5f } );
+  ovalList.push_back( { 3.f, 14.f, .25f, .25f, 0.f } );
+
+  writeOvalFile( "test_round_trip.oval", ovalList, 20, 20 );
+
+  auto r1 = ovalListToRaster( ovalList, 20, 20 );
+
+    {
+      mappedOvalFile file( "test_round_trip.oval" );
+
+      REQUIRE( file.size() == ovalList.size() );
+      CHECK( file.width() == 20 );
+      CHECK( file.height() == 20 );
+      CHECK( file.ovals()[ 1 ].angle == 0.5f );
+
+      auto r2 = ovalListToRaster( file.ovals(), file.size(), file.width(), file.height() );
+
+      REQUIRE( r1.size() == r2.size() );
+
+      for( int ii = 0; ii < r1.size(); ii += 1 )
+        {
+          CHECK( r1[ ii ].lineY  == r2[ ii ].lineY );
+          CHECK( r1[ ii ].startX == r2[ ii ].startX );
+          CHECK( r1[ ii ].endX   == r2[ ii ].endX );
+          CHECK( r1[ ii ].value  == r2[ ii ].value );
+        }
+    }
+
+  writeRunFile( "test_round_trip.runs", r1, 20, 20 );
+
+  int ww, hh;
+  auto r3 = readRunFile( "test_round_trip.runs", & ww, & hh );
+
+  CHECK( ww == 20 );
+  CHECK( hh == 20 );
+  REQUIRE( r3.size() == r1.size() );
+  CHECK( r3.back().value == r1.back().value );
+
+  CHECK_THROWS( mappedOvalFile( "test_round_trip.runs" ) );   // not an oval file
+
+  std::remove( "test_round_trip.oval" );
+  std::remove( "test_round_trip.runs" );
+}
+TEST_CASE("Streaming Matches Batch")
+{
+  std::mt19937 gen( 27 );
+  std::uniform_real_distribution< float > xpos( -5.f, 105.f );
+  std::uniform_real_distribution< float > ypos( -5.f, 2005.f );
+  std::uniform_real_distribution< float > radius( 0.25f, 8.f );
+  std::uniform_real_distribution< float > angle( 0.f, 3.14f );
+
+  std::vector< ovalRecord > ovalList;
+
+  for( int ii = 0; ii < 2000; ii += 1 )
+    {
+      ovalList.push_back( { xpos( gen ), ypos( gen ), radius( gen ), radius( gen ), angle( gen ) } );
+    }
+
+  std::sort( ovalList.begin(), ovalList.end(), []( const ovalRecord& one, const ovalRecord& two ) {
+    return ovalBounds( one ).top < ovalBounds( two ).top;
+  } );
+
+  auto r1 = ovalListToRaster( ovalList, 100, 2000 );
+
+  ovalStreamRasterizer stream( 100, 2000 );
+  std::vector< pixelRun > r2;
+  std::vector< pixelRun > finished;
+  size_t max_active = 0;
+
+  for( const auto& one : ovalList )
+    {
+      stream.addOval( one );
+      stream.takeRuns( & finished );
+      r2.insert( r2.end(), finished.begin(), finished.end() );
+
+      max_active = std::max( max_active, stream.activeCount() );
+    }
+
+  stream.finish();
+  stream.takeRuns( & finished );
+  r2.insert( r2.end(), finished.begin(), finished.end() );
+
+  CHECK( max_active < 100 );   // only the ovals near the current scanline are kept
+  REQUIRE( r1.size() == r2.size() );
+
+  for( int ii = 0; ii < r1.size(); ii += 1 )
+    {
+      CHECK( r1[ ii ].lineY  == r2[ ii ].lineY );
+      CHECK( r1[ ii ].startX == r2[ ii ].startX );
+      CHECK( r1[ ii ].endX   == r2[ ii ].endX );
+      CHECK( r1[ ii ].value  == r2[ ii ].value );
+    }
+
+  ovalStreamRasterizer bad( 100, 100 );
+  bad.addOval( { 10.f, 50.f, 5.f, 5.f, 0.f } );
+
+  CHECK_THROWS( bad.addOval( { 10.f, 10.f, 5.f, 5.f, 0.f } ) );   // out of order
+}
+TEST_CASE("Large Canvas Tiles")
+{
+  std::vector< ovalRecord > ovalList;
+  std::vector< largeOvalRecord > largeList;
+
+  ovalList.push_back( { 30.3f, 20.7f, 12.f, 5.f, 0.4f } );
+  ovalList.push_back( { 50.f, 40.f, 20.f, 20.f, 0.f } );
+  ovalList.push_back( { 14.5f, 60.2f, .25f, .25f, 0.f } );
+
+  for( const auto& one : ovalList )
+    {
+      largeList.push_back( { one.centerx, one.centery, one.radiusx, one.radiusy, one.angle } );
+    }
+
+  auto r1 = ovalListToRaster( ovalList, 100, 100 );
+  auto r2 = largeOvalListToRaster( largeList, 100, 100, 16 );   // ovals cross many tiles
+
+  REQUIRE( r1.size() == r2.size() );
+
+  for( int ii = 0; ii < r1.size(); ii += 1 )
+    {
+      CHECK( r1[ ii ].lineY  == r2[ ii ].lineY );
+      CHECK( r1[ ii ].startX == r2[ ii ].startX );
+      CHECK( r1[ ii ].endX   == r2[ ii ].endX );
+      CHECK( r1[ ii ].value  == r2[ ii ].value );
+    }
+
+  // The same ovals far beyond the range of int and of exact floats.  The
+  // offsets are multiples of the tile size, so the sweep sees the same ovals.
+
+  const int64_t offsetX = 4882812LL * 1024;
+  const int64_t offsetY = 2929687LL * 1024;
+
+  for( auto& one : largeList )
+    {
+      one.centerx += offsetX;
+      one.centery += offsetY;
+    }
+
+  auto r3 = largeOvalListToRaster( largeList, 10000000000LL, 10000000000LL );
+
+  REQUIRE( r1.size() == r3.size() );
+
+  for( int ii = 0; ii < r1.size(); ii += 1 )
+    {
+      CHECK( r1[ ii ].lineY + offsetY  == r3[ ii ].lineY );
+      CHECK( r1[ ii ].startX + offsetX == r3[ ii ].startX );
+      CHECK( r1[ ii ].endX + offsetX   == r3[ ii ].endX );
+      CHECK( r1[ ii ].value == r3[ ii ].value );
+    }
+}
+TEST_CASE("Clip Rectangle")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( { 30.3f, 20.7f, 12.f, 5.f, 0.4f } );
+  ovalList.push_back( { 50.f, 40.f, 20.f, 20.f, 0.f } );
+  ovalList.push_back( { 14.5f, 60.2f, 3.25f, 1.25f, 1.f } );
+  ovalList.push_back( { -4.f, -3.f, 6.f, 5.f, 0.2f } );
+  ovalList.push_back( { 500.f, 500.f, 6.f, 5.f, 0.2f } );     // far outside of any window
+
+  // The coverage of ( -20, -20, 100, 100 ), moved to the origin
+
+  auto coverage = []( std::vector< pixelRun > runs )
+    {
+      for( auto& one : runs )
+        {
+          one.lineY += 20;
+          one.startX += 20;
+          one.endX += 20;
+        }
+
+      return runsToCoverage( runs, 120, 120 );
+    };
+
+  auto full = ovalListToRaster( ovalList, -20, -20, 100, 100 );
+  auto expected = coverage( full );
+
+  const int windows[][ 4 ] = {
+    { 0, 0, 100, 100 },
+    { 25, 15, 45, 30 },
+    { -10, -10, 5, 5 },
+    { 40, 45, 41, 46 },     // a single pixel
+  };
+
+  for( const auto& ww : windows )
+    {
+      auto rr = ovalListToRaster( ovalList, ww[ 0 ], ww[ 1 ], ww[ 2 ], ww[ 3 ] );
+
+      for( const auto& one : rr )
+        {
+          CHECK( ww[ 0 ] <= one.startX );
+          CHECK( one.endX <= ww[ 2 ] );
+          CHECK( ww[ 1 ] <= one.lineY );
+          CHECK( one.lineY < ww[ 3 ] );
+        }
+
+      auto img = coverage( rr );
+
+      for( int yy = ww[ 1 ]; yy < ww[ 3 ]; yy += 1 )
+        {
+          for( int xx = ww[ 0 ]; xx < ww[ 2 ]; xx += 1 )
+            {
+              int pi = ( yy + 20 ) * 120 + xx + 20;
+
+              CHECK( img[ pi ] == expected[ pi ] );
+            }
+        }
+    }
+
+  CHECK( ovalListToRaster( ovalList, 200, 200, 300, 300 ).empty() );
+}
+TEST_CASE("Splat Tiny Ovals")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( ovalRecord{ 3.f, 3.f, .25f, .25f, 0.f } );
+  ovalList.push_back( ovalRecord{ 4.f, 3.f, .25f, .25f, 0.f } );
+  ovalList.push_back( ovalRecord{ 3.f, 4.f, .25f, .25f, 0.f } );
+  ovalList.push_back( ovalRecord{ 4.f, 4.f, .25f, .25f, 0.f } );
+
+  rasterOptions options;
+  options.splatRadius = 0.5f;
+
+  auto rr = ovalListToRaster( ovalList, 0, 0, 10, 10, options );
+
+  REQUIRE( rr.size() == 9 );
+  CHECK( rr[ 0 ].lineY == 2 );
+  CHECK( rr[ 3 ].lineY == 3 );
+  CHECK( rr[ 6 ].lineY == 4 );
+
+  // The splats keep the area of the ovals, less a little where the splats
+  // share a pixel and are combined as a union
+
+  float mass = 0.f;
+  float area = 4.f * M_PI * .25f * .25f;
+
+  for( const auto& one : rr )
+    {
+      mass += one.value * ( one.endX - one.startX );
+    }
+
+  CHECK( mass <= area );
+  CHECK( 0.95f * area < mass );
+
+  // Splats on top of a solid oval don't change it
+
+  ovalList.push_back( ovalRecord{ 3.5f, 3.5f, 3.f, 3.f, 0.f } );
+
+  auto r1 = ovalListToRaster( std::vector< ovalRecord >( 1, ovalList.back() ), 10, 10 );
+  auto r2 = ovalListToRaster( ovalList, 0, 0, 10, 10, options );
+
+  auto img1 = runsToCoverage( r1, 10, 10 );
+  auto img2 = runsToCoverage( r2, 10, 10 );
+
+  for( int ii = 0; ii < img1.size(); ii += 1 )
+    {
+      CHECK( img1[ ii ] <= img2[ ii ] );
+
+      if( img1[ ii ] == 1.f )
+        {
+          CHECK( img2[ ii ] == 1.f );
+        }
+    }
+}
+TEST_CASE("Needle Ovals")
+{
+  std::mt19937 rng( 7 );
+  std::uniform_real_distribution< float > unit( 0.f, 1.f );
+
+  std::vector< ovalRecord > ovalList;
+
+  for( int ii = 0; ii < 60; ii += 1 )
+    {
+      ovalList.push_back( ovalRecord{ 10.f + 44.f * unit( rng ), 10.f + 44.f * unit( rng ),
+                                      3.f + 8.f * unit( rng ), .05f + .4f * unit( rng ), 6.3f * unit( rng ) } );
+    }
+
+  ovalList[ 1 ].radiusx = ovalList[ 1 ].radiusy;    // a needle along the y axis of the oval
+  ovalList[ 1 ].radiusy = 9.f;
+
+  rasterStats stats;
+  rasterOptions options;
+  options.needleRadius = 0.5f;
+  options.stats = & stats;
+
+  auto rr = ovalListToRaster( ovalList, 0, 0, 64, 64, options );
+
+  CHECK( stats.needleCount == ovalList.size() );
+  CHECK( stats.ovalCount == 0 );
+  CHECK( stats.aaPixelCount == 0 );
+
+  // The lines keep the area of the needles, and are closer to the reference
+  // than the sweep, which has no roots for them on most lines
+
+  auto reference = referenceCoverage( ovalList, 64, 64, 8 );
+  auto err = compareCoverage( runsToCoverage( rr, 64, 64 ), reference );
+  auto swept = compareCoverage( runsToCoverage( ovalListToRaster( ovalList, 64, 64 ), 64, 64 ), reference );
+
+  CHECK( err.meanError < 0.05 );
+  CHECK( std::fabs( err.massError ) < 0.01 );
+  CHECK( err.meanError < swept.meanError );
+
+  // Only the pixels close to the axis of one needle are touched
+
+  ovalRecord one = ovalList[ 1 ];
+  auto single = ovalListToRaster( & one, 1, 0, 0, 64, 64, options );
+
+  REQUIRE( not single.empty() );
+
+  for( const auto& pr : single )
+    {
+      CHECK( pr.value <= 1.f );
+
+      for( int xx = pr.startX; xx < pr.endX; xx += 1 )
+        {
+          float dx = xx + 0.5f - one.centerx;
+          float dy = pr.lineY + 0.5f - one.centery;
+
+          CHECK( std::fabs( std::cos( one.angle ) * dx + std::sin( one.angle ) * dy ) < one.radiusx + 1.f );
+        }
+    }
+
+  // Clipped to the rectangle
+
+  for( const auto& pr : ovalListToRaster( ovalList, 20, 30, 40, 35, options ) )
+    {
+      CHECK( 20 <= pr.startX );
+      CHECK( pr.endX <= 40 );
+      CHECK( 30 <= pr.lineY );
+      CHECK( pr.lineY < 35 );
+    }
+
+  // Far from the origin, where a float can't count the pixels one by one,
+  // a needle is drawn the same as near it
+
+  ovalRecord far = { 20000000.f, 50.f, 40.f, 0.3f, 0.2f };
+  ovalRecord near = { 50.f, 50.f, 40.f, 0.3f, 0.2f };
+
+  options.needleRadius = 1.f;
+
+  auto farRuns = ovalListToRaster( & far, 1, 19999950, 0, 20000050, 100, options );
+  auto nearRuns = ovalListToRaster( & near, 1, 0, 0, 100, 100, options );
+
+  REQUIRE( not nearRuns.empty() );
+  REQUIRE( farRuns.size() == nearRuns.size() );
+
+  for( size_t ii = 0; ii < farRuns.size(); ii += 1 )
+    {
+      CHECK( farRuns[ ii ].lineY == nearRuns[ ii ].lineY );
+      CHECK( farRuns[ ii ].startX - 19999950 == nearRuns[ ii ].startX );
+      CHECK( farRuns[ ii ].endX - 19999950 == nearRuns[ ii ].endX );
+      CHECK( farRuns[ ii ].value == doctest::Approx( nearRuns[ ii ].value ).epsilon( 1e-3 ) );
+    }
+
+  // Only the part inside of the clip rectangle is walked
+
+  for( const auto& pr : ovalListToRaster( & far, 1, 19999990, 40, 20000010, 60, options ) )
+    {
+      CHECK( 19999990 <= pr.startX );
+      CHECK( pr.endX <= 20000010 );
+      CHECK( 40 <= pr.lineY );
+      CHECK( pr.lineY < 60 );
+    }
+}
+TEST_CASE("Accumulate Overlaps")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( ovalRecord{ 20.f, 20.f, 12.f, 6.f, 0.3f } );
+  ovalList.push_back( ovalRecord{ 24.5f, 22.f, 9.f, 9.f, 0.f } );
+  ovalList.push_back( ovalRecord{ 18.f, 25.3f, 10.f, 3.5f, -1.1f } );
+  ovalList.push_back( ovalRecord{ 30.f, 30.f, .3f, .2f, 0.f } );     // a candidate for splatting
+
+  rasterOptions options;
+  options.coverage = coverageMode::accumulate;
+
+  // One pass gives the same density as adding up the ovals one at a time
+
+  auto rr = ovalListToRaster( ovalList, 0, 0, 50, 50, options );
+  auto img = runsToCoverage( rr, 50, 50 );
+
+  std::vector< float > sum( img.size(), 0.f );
+
+  for( const auto& one : ovalList )
+    {
+      auto single = runsToCoverage( ovalListToRaster( std::vector< ovalRecord >( 1, one ), 50, 50 ), 50, 50 );
+
+      for( int ii = 0; ii < sum.size(); ii += 1 )
+        {
+          sum[ ii ] += single[ ii ];
+        }
+    }
+
+  for( int ii = 0; ii < img.size(); ii += 1 )
+    {
+      CHECK( img[ ii ] == doctest::Approx( sum[ ii ] ).epsilon( 1e-5 ) );
+    }
+
+  CHECK( img[ 22 * 50 + 20 ] == 3.f );    // inside of the three large ovals
+
+  // Splatted ovals are added as well, so the total is the total area
+
+  options.splatRadius = 0.5f;
+  rr = ovalListToRaster( ovalList, 0, 0, 50, 50, options );
+
+  float mass = 0.f;
+  float area = 0.f;
+
+  for( const auto& one : rr )
+    {
+      mass += one.value * ( one.endX - one.startX );
+    }
+
+  for( const auto& one : ovalList )
+    {
+      area += M_PI * one.radiusx * one.radiusy;
+    }
+
+  CHECK( mass == doctest::Approx( area ).epsilon( 0.01 ) );
+}
+TEST_CASE("Cancel Raster")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( ovalRecord{ 50.f, 50.f, 40.f, 30.f, 0.2f } );
+
+  std::atomic< bool > cancel( false );
+
+  rasterOptions options;
+  options.cancel = & cancel;
+
+  auto full = ovalListToRaster( ovalList, 0, 0, 100, 100, options );
+
+  CHECK( full.size() == ovalListToRaster( ovalList, 100, 100 ).size() );
+
+  // Once cancelled, the rasterizer stops after the first scanline
+
+  cancel = true;
+
+  auto rr = ovalListToRaster( ovalList, 0, 0, 100, 100, options );
+
+  REQUIRE( not rr.empty() );
+  CHECK( rr.back().lineY == rr.front().lineY );
+  CHECK( rr.size() < full.size() );
+}
+TEST_CASE("Binary Coverage")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( ovalRecord{ 20.f, 20.f, 12.f, 6.f, 0.3f } );
+  ovalList.push_back( ovalRecord{ 24.5f, 22.f, 9.f, 9.f, 0.f } );
+
+  rasterOptions options;
+  options.antialias = false;
+
+  auto img = runsToCoverage( ovalListToRaster( ovalList, 0, 0, 50, 50, options ), 50, 50 );
+
+  // A pixel is covered when its center is inside of one of the ovals
+
+  for( int yy = 0; yy < 50; yy += 1 )
+    {
+      for( int xx = 0; xx < 50; xx += 1 )
+        {
+          bool inside = ovalContainsPoint( ovalList[ 0 ], xx + .5f, yy + .5f ) or
+                        ovalContainsPoint( ovalList[ 1 ], xx + .5f, yy + .5f );
+
+          CHECK( img[ yy * 50 + xx ] == ( inside ? 1.f : 0.f ) );
+        }
+    }
+}
+TEST_CASE("Raster Stats")
+{
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( ovalRecord{ 20.f, 20.f, 12.f, 6.f, 0.3f } );
+  ovalList.push_back( ovalRecord{ 24.5f, 22.f, 9.f, 9.f, 0.f } );
+  ovalList.push_back( ovalRecord{ 30.f, 30.f, .3f, .2f, 0.f } );
+  ovalList.push_back( ovalRecord{ 300.f, 30.f, 3.f, 2.f, 0.f } );    // outside of the clip
+
+  rasterStats stats;
+  rasterOptions options;
+  options.splatRadius = 0.5f;
+  options.stats = & stats;
+
+  auto rr = ovalListToRaster( ovalList, 0, 0, 50, 50, options );
+
+  CHECK( stats.ovalCount == 2 );
+  CHECK( stats.splatCount == 1 );
+  CHECK( stats.runCount == rr.size() );
+  CHECK( 0 < stats.scanlineCount );
+  CHECK( 2 * stats.scanlineCount <= stats.edgeCount );
+  CHECK( 0 < stats.aaPixelCount );
+  CHECK( stats.sweepSeconds <= stats.totalSeconds );
+
+  // The number of pixels computed from distances is the same as the number
+  // of single pixel runs that aren't solid, when nothing merges
+
+  size_t partial = 0;
+
+  for( const auto& one : ovalListToRaster( std::vector< ovalRecord >( 1, ovalList[ 1 ] ), 50, 50 ) )
+    {
+      if( one.value < 1.f )
+        {
+          partial += one.endX - one.startX;
+        }
+    }
+
+  ovalListToRaster( std::vector< ovalRecord >( 1, ovalList[ 1 ] ), 0, 0, 50, 50, options );
+
+  CHECK( stats.aaPixelCount == partial );
+
+  // The edge pixels of an oval that is inside of another are solid without
+  // being computed
+
+  std::vector< ovalRecord > nested = { { 25.f, 25.f, 20.f, 15.f, 0.3f }, { 24.f, 26.f, 6.f, 4.f, 1.f } };
+
+  partial = 0;
+
+  for( const auto& one : ovalListToRaster( std::vector< ovalRecord >( 1, nested[ 0 ] ), 50, 50 ) )
+    {
+      if( one.value < 1.f )
+        {
+          partial += one.endX - one.startX;
+        }
+    }
+
+  rasterOptions plain;
+  plain.stats = & stats;
+
+  ovalListToRaster( nested, 0, 0, 50, 50, plain );
+
+  CHECK( stats.aaPixelCount == partial );
+}
+TEST_CASE("Reference Error Budget")
+{
+  // The error of the rasterizer against the supersampled reference.  A
+  // faster kernel may change the values of the runs, but it has to stay
+  // within these budgets.  Use ovalAccuracy for the full report.
+
+  sceneOptions scene;
+  scene.count = 300;
+  scene.width = 200.f;
+  scene.height = 200.f;
+  scene.maxRadius = 12.f;
+
+  auto ol = randomOvalScene( scene );
+
+  auto unite = referenceCoverage( ol, 200, 200, 8 );
+  auto err = compareCoverage( runsToCoverage( ovalListToRaster( ol, 200, 200 ), 200, 200 ), unite );
+
+  CHECK( err.meanError < 0.01 );
+  CHECK( std::fabs( err.massError ) < 0.005 );
+
+  rasterOptions options;
+  options.coverage = coverageMode::accumulate;
+
+  auto accumulate = referenceCoverage( ol, 200, 200, 8, coverageMode::accumulate );
+  err = compareCoverage( runsToCoverage( ovalListToRaster( ol, 0, 0, 200, 200, options ), 200, 200 ), accumulate );
+
+  CHECK( err.meanError < 0.015 );
+  CHECK( std::fabs( err.massError ) < 0.01 );
+
+  options = rasterOptions();
+  options.antialias = false;
+
+  err = compareCoverage( runsToCoverage( ovalListToRaster( ol, 0, 0, 200, 200, options ), 200, 200 ), unite );
+
+  CHECK( err.meanError < 0.08 );
+  CHECK( std::fabs( err.massError ) < 0.005 );
+}
+TEST_CASE("Hit Index")
+{
+  std::mt19937 gen( 31 );
+  std::uniform_real_distribution< float > pos( 0.f, 500.f );
+  std::uniform_real_distribution< float > radius( 0.5f, 20.f );
+  std::uniform_real_distribution< float > angle( 0.f, 3.14f );
+
+  std::vector< ovalRecord > ovalList;
+
+  ovalList.push_back( { 250.f, 250.f, 400.f, 300.f, 0.3f } );    // below all the others
+
+  for( int ii = 0; ii < 2000; ii += 1 )
+    {
+      ovalList.push_back( { pos( gen ), pos( gen ), radius( gen ), radius( gen ), angle( gen ) } );
+    }
+
+  ovalHitIndex index;
+  index.build( ovalList );
+
+  REQUIRE( index.size() == ovalList.size() );
+
+  auto check_queries = [&]() {
+    std::vector< int > found;
+
+    for( int ii = 0; ii < 200; ii += 1 )
+      {
+        float xx = pos( gen );
+        float yy = pos( gen );
+
+        int expected = -1;
+        std::vector< int > near;
+
+        for( int jj = 0; jj < ovalList.size(); jj += 1 )
+          {
+            if( ovalContainsPoint( ovalList[ jj ], xx, yy ) )
+              {
+                expected = jj;
+              }
+
+            floatBounds bb = ovalBounds( ovalList[ jj ] );
+
+            if( bb.left - 5.f <= xx and xx <= bb.right + 5.f and bb.top - 5.f <= yy and yy <= bb.bottom + 5.f )
+              {
+                near.push_back( jj );
+              }
+          }
+
+        CHECK( index.topmost( xx, yy ) == expected );
+
+        // Everything that is found is close, and everything that contains
+        // the point is found
+
+        index.within( xx, yy, 5.f, & found );
+
+        for( int one : found )
+          {
+            CHECK( std::find( near.begin(), near.end(), one ) != near.end() );
+          }
+
+        for( int jj = 0; jj < ovalList.size(); jj += 1 )
+          {
+            if( ovalContainsPoint( ovalList[ jj ], xx, yy ) )
+              {
+                CHECK( std::find( found.begin(), found.end(), jj ) != found.end() );
+              }
+          }
+      }
+  };
+
+  check_queries();
+
+  // Move some of the ovals around, including out of the original grid
+
+  for( int ii = 1; ii < 100; ii += 1 )
+    {
+      ovalList[ ii ].centerx = pos( gen ) * 1.5f - 100.f;
+      ovalList[ ii ].centery = pos( gen ) * 1.5f - 100.f;
+      index.update( ii, ovalList[ ii ] );
+    }
+
+  ovalList.push_back( { 10.f, 10.f, 5.f, 5.f, 0.f } );
+  CHECK( index.add( ovalList.back() ) == ovalList.size() - 1 );
+  CHECK( index.topmost( 10.f, 10.f ) == ovalList.size() - 1 );
+
+  check_queries();
+
+  index.clear();
+  CHECK( index.topmost( 10.f, 10.f ) == -1 );
+}
+TEST_CASE("Arena Raster")
+{
+  sceneOptions scene;
+  scene.count = 300;
+  scene.width = 256.f;
+  scene.height = 256.f;
+
+  std::vector< ovalRecord > ovalList = randomOvalScene( scene );
+
+  rasterArena arena( 4 << 20, true );
+  rowIndex rows;
+  rows.rowStart.reserve( 257 );
+
+  rasterOptions options;
+  options.memory = & arena;
+  options.rows = & rows;
+  options.splatRadius = 3.f;
+
+  auto expected = ovalListToRaster( ovalList, 0, 0, 256, 256, options );
+
+  // Everything comes from the arena, so a default resource that can not
+  // allocate is never used
+
+  std::pmr::memory_resource *was = std::pmr::set_default_resource( std::pmr::null_memory_resource() );
+
+  for( int frame = 0; frame < 3; frame += 1 )
+    {
+      arena.reset();
+
+      std::pmr::vector< pixelRun > runs( & arena );
+
+      CHECK_NOTHROW( ovalListToRaster( ovalList.data(), ovalList.size(), 0, 0, 256, 256, options, runs ) );
+
+      REQUIRE( runs.size() == expected.size() );
+
+      bool same = true;
+
+      for( size_t ii = 0; ii < runs.size(); ii += 1 )
+        {
+          same = same and runs[ ii ].lineY == expected[ ii ].lineY and runs[ ii ].startX == expected[ ii ].startX and
+                 runs[ ii ].endX == expected[ ii ].endX and runs[ ii ].value == expected[ ii ].value;
+        }
+
+      CHECK( same );
+    }
+
+  std::vector< ovalRecord > one( ovalList );
+  int removed = deduplicateOvalList( one, .5f, & arena );
+
+  std::pmr::set_default_resource( was );
+
+  std::vector< ovalRecord > two( ovalList );
+
+  CHECK( arena.overflowCount() == 0 );
+  CHECK( 0 < arena.highWater() );
+  CHECK( removed == deduplicateOvalList( two, .5f ) );
+  CHECK( one.size() == two.size() );
+
+  // A strict arena that is too small says so, one that is not strict goes on
+  // to the heap
+
+  rasterArena small( 1024, true );
+  options.memory = & small;
+
+  CHECK_THROWS_AS( ovalListToRaster( ovalList, 0, 0, 256, 256, options ), arenaExhausted );
+
+  rasterArena spill( 1024 );
+  options.memory = & spill;
+
+  CHECK( ovalListToRaster( ovalList, 0, 0, 256, 256, options ).size() == expected.size() );
+  CHECK( 0 < spill.overflowCount() );
+}
+TEST_CASE("Trace Raster")
+{
+  sceneOptions scene;
+  scene.count = 300;
+  scene.width = 256.f;
+  scene.height = 256.f;
+
+  auto ovalList = randomOvalScene( scene );
+  auto expected = ovalListToRaster( ovalList, 256, 256 );
+
+  traceStart();
+
+  auto runs = ovalListToRaster( ovalList, 256, 256 );
+  deduplicateOvalList( ovalList );
+
+  traceStop();
+
+  std::string json = traceJson();
+
+  // Tracing doesn't change the runs
+
+  REQUIRE( runs.size() == expected.size() );
+
+  for( size_t ii = 0; ii < runs.size(); ii += 1 )
+    {
+      CHECK( runs[ ii ].lineY == expected[ ii ].lineY );
+      CHECK( runs[ ii ].startX == expected[ ii ].startX );
+      CHECK( runs[ ii ].value == expected[ ii ].value );
+    }
+
+#ifdef OVAL_TRACE
+  for( const char *name : { "\"prepare\"", "\"sweep\"", "\"band\"", "\"output\"",
+                            "\"dedup sort\"", "\"dedup overlaps\"", "\"edgeListMs\"", "\"sortMs\"", "\"runsMs\"" } )
+    {
+      CHECK_MESSAGE( json.find( name ) != std::string::npos, name );
+    }
+
+  CHECK( 256 / 64 <= traceEventCount() );
+#else
+  CHECK( traceEventCount() == 0 );    // the spans are compiled out
+#endif
+}
+TEST_SUITE_END();